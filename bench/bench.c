@@ -0,0 +1,310 @@
+#include "pq.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef BENCH_CFLAGS
+#define BENCH_CFLAGS ""
+#endif
+
+#define TARGET_OPS 2000000UL
+#define TOPK_K 100
+#define BURST_LEN 256
+
+typedef struct {
+    uint64_t            key;
+    char                cancelled;
+    char                armed;
+} elem_t;
+
+typedef struct {
+    const char          *name;
+    size_t              (*run)(size_t n);
+} workload_t;
+
+static uint64_t cmp_count;
+static uint64_t skip_count;
+static unsigned pq_flags;
+static uint64_t rng_state = 0x9e3779b97f4a7c15ULL;
+
+static uint64_t rng(void) {
+    uint64_t z = (rng_state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static int elem_cmp(const void *a, const void *b) {
+    uint64_t ka = ((const elem_t *)a)->key, kb = ((const elem_t *)b)->key;
+    cmp_count++;
+    return (ka > kb) - (ka < kb);
+}
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static elem_t *elems_alloc(size_t n) {
+    elem_t *e = calloc(n, sizeof(elem_t));
+    if (!e) {
+        fprintf(stderr, "bench_error: Could not allocate %zu elements\n", n);
+        exit(1);
+    }
+    return e;
+}
+
+/* Insert n random keys, then pop them all. */
+static size_t run_rand(size_t n) {
+    elem_t *e = elems_alloc(n);
+    pq_t *pq = pq_create_ex(n, elem_cmp, pq_flags);
+
+    for (size_t i = 0; i < n; i++) {
+        e[i].key = rng();
+        pq_insert(pq, &e[i]);
+    }
+    while (!pq_is_empty(pq))
+        pq_remove(pq);
+
+    pq_destroy(pq, NULL);
+    free(e);
+    return 2 * n;
+}
+
+/* Classic hold model: pop the minimum and reinsert it further in the future. */
+static size_t run_hold(size_t n) {
+    elem_t *e = elems_alloc(n);
+    pq_t *pq = pq_create_ex(n, elem_cmp, pq_flags);
+    size_t holds = 2 * n;
+
+    for (size_t i = 0; i < n; i++) {
+        e[i].key = rng() % (n * 16);
+        pq_insert(pq, &e[i]);
+    }
+    for (size_t h = 0; h < holds; h++) {
+        elem_t *top = (elem_t *)pq_remove(pq);
+        top->key += 1 + rng() % (n * 16);
+        pq_insert(pq, top);
+    }
+
+    pq_destroy(pq, NULL);
+    free(e);
+    return 2 * holds;
+}
+
+/* Timer wheel replacement: one timer armed per tick, random cancellations
+ * (lazy, skipped when they surface, counted in skip_count) and expiry of
+ * everything due. */
+static size_t run_timer(size_t n) {
+    size_t cap = 4 * n, ops = 0, armed = 0, next = 0;
+    elem_t *e = elems_alloc(cap);
+    pq_t *pq = pq_create_ex(cap, elem_cmp, pq_flags);
+    uint64_t tick = 0, range = 2 * n;
+
+    for (; armed < n; armed++, next++) {
+        e[next].key = 1 + rng() % range;
+        e[next].armed = 1;
+        pq_insert(pq, &e[next]);
+        ops++;
+    }
+    for (size_t step = 0; step < 2 * n; step++) {
+        tick++;
+
+        while (e[next % cap].armed)
+            next++;
+        elem_t *t = &e[next++ % cap];
+        t->key = tick + 1 + rng() % range;
+        t->armed = 1;
+        t->cancelled = 0;
+        pq_insert(pq, t);
+        ops++;
+
+        elem_t *victim = &e[rng() % cap];
+        if (rng() & 1 && victim->armed && !victim->cancelled)
+            victim->cancelled = 1;
+
+        while (!pq_is_empty(pq) && ((const elem_t *)pq_peek(pq))->key <= tick) {
+            elem_t *fired = (elem_t *)pq_remove(pq);
+            fired->armed = 0;
+            ops++;
+
+            /* A cancelled timer is dropped without firing. */
+            if (fired->cancelled)
+                skip_count++;
+        }
+    }
+
+    pq_destroy(pq, NULL);
+    free(e);
+    return ops;
+}
+
+/* Dijkstra-like access: keys popped are non-decreasing and every pop pushes
+ * a few successors slightly larger than itself. */
+static size_t run_mono(size_t n) {
+    elem_t *e = elems_alloc(n);
+    pq_t *pq = pq_create_ex(n, elem_cmp, pq_flags);
+    size_t used = 1, ops = 1;
+
+    e[0].key = 0;
+    pq_insert(pq, &e[0]);
+    while (!pq_is_empty(pq)) {
+        const elem_t *top = pq_remove(pq);
+        ops++;
+        for (int d = 0; d < 3 && used < n; d++, used++, ops++) {
+            e[used].key = top->key + 1 + rng() % 100;
+            pq_insert(pq, &e[used]);
+        }
+    }
+
+    pq_destroy(pq, NULL);
+    free(e);
+    return ops;
+}
+
+/* Bursts of BURST_LEN inserts, each followed by a quarter as many pops, then a drain. */
+static size_t run_burst(size_t n) {
+    elem_t *e = elems_alloc(n);
+    pq_t *pq = pq_create_ex(n, elem_cmp, pq_flags);
+    size_t ops = 0;
+
+    for (size_t i = 0; i < n;) {
+        for (size_t b = 0; b < BURST_LEN && i < n; b++, i++, ops++) {
+            e[i].key = rng();
+            pq_insert(pq, &e[i]);
+        }
+        for (size_t p = 0; p < BURST_LEN / 4 && !pq_is_empty(pq); p++, ops++)
+            pq_remove(pq);
+    }
+    while (!pq_is_empty(pq)) {
+        pq_remove(pq);
+        ops++;
+    }
+
+    pq_destroy(pq, NULL);
+    free(e);
+    return ops;
+}
+
+/* Stream n random keys through a bounded min-heap that keeps the TOPK_K largest. */
+static size_t run_topk(size_t n) {
+    elem_t *e = elems_alloc(n);
+    pq_t *pq = pq_create_ex(TOPK_K, elem_cmp, pq_flags);
+
+    for (size_t i = 0; i < n; i++) {
+        e[i].key = rng();
+        if (pq_len(pq) < TOPK_K) {
+            pq_insert(pq, &e[i]);
+        } else if (e[i].key > ((const elem_t *)pq_peek(pq))->key) {
+            pq_remove(pq);
+            pq_insert(pq, &e[i]);
+        }
+    }
+
+    pq_destroy(pq, NULL);
+    free(e);
+    return n;
+}
+
+static const workload_t WORKLOADS[] = {
+    {"rand", run_rand},
+    {"hold", run_hold},
+    {"timer", run_timer},
+    {"mono", run_mono},
+    {"topk", run_topk},
+    {"burst", run_burst},
+};
+
+/* Whether `name` appears in the comma separated list `only`. */
+static int selected(const char *only, const char *name) {
+    size_t len = strlen(name);
+
+    for (const char *p = only; p; p = strchr(p, ',') ? strchr(p, ',') + 1 : NULL)
+        if (!strncmp(p, name, len) && (p[len] == ',' || !p[len]))
+            return 1;
+
+    return 0;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [-o out.json] [-w workload[,workload...]] [-l] [-b] [-z] [-a] SIZE...\n"
+            "Workloads: rand hold timer mono topk burst (default: all)\n"
+            "-l, -b, -z and -a create every queue with PQ_LARGE, PQ_BHEAP, PQ_LAZY and PQ_ADAPTIVE\n"
+            "Sizes accept scientific notation, e.g. 1e6\n", prog);
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    const char *out_path = NULL, *only = NULL;
+    size_t sizes[64], n_sizes = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-o") && i + 1 < argc)
+            out_path = argv[++i];
+        else if (!strcmp(argv[i], "-w") && i + 1 < argc)
+            only = argv[++i];
+        else if (!strcmp(argv[i], "-l"))
+            pq_flags |= PQ_LARGE;
+        else if (!strcmp(argv[i], "-b"))
+            pq_flags |= PQ_BHEAP;
+        else if (!strcmp(argv[i], "-z"))
+            pq_flags |= PQ_LAZY;
+        else if (!strcmp(argv[i], "-a"))
+            pq_flags |= PQ_ADAPTIVE;
+        else if (argv[i][0] == '-' || n_sizes == 64)
+            usage(argv[0]);
+        else
+            sizes[n_sizes++] = (size_t)strtod(argv[i], NULL);
+    }
+    if (!n_sizes)
+        usage(argv[0]);
+
+    FILE *out = out_path ? fopen(out_path, "w") : NULL;
+    if (out_path && !out) {
+        perror(out_path);
+        return 1;
+    }
+    if (out)
+        fprintf(out, "{\n  \"cc\": \"%s\",\n  \"cflags\": \"%s\",\n  \"flags\": %u,\n  \"results\": [\n",
+                __VERSION__, BENCH_CFLAGS, pq_flags);
+
+    printf("%-8s %12s %14s %12s %12s %12s\n", "workload", "n", "ops", "ns/op", "cmp/op", "skipped");
+
+    int first = 1;
+    for (size_t w = 0; w < sizeof(WORKLOADS) / sizeof(*WORKLOADS); w++) {
+        if (only && !selected(only, WORKLOADS[w].name))
+            continue;
+
+        for (size_t s = 0; s < n_sizes; s++) {
+            size_t n = sizes[s] ? sizes[s] : 1;
+            size_t reps = n < TARGET_OPS ? TARGET_OPS / n : 1, ops = 0;
+
+            cmp_count = skip_count = 0;
+            double t0 = now_ns();
+            for (size_t r = 0; r < reps; r++)
+                ops += WORKLOADS[w].run(n);
+            double ns = now_ns() - t0;
+
+            double ns_op = ns / ops, cmp_op = (double)cmp_count / ops;
+            printf("%-8s %12zu %14zu %12.2f %12.2f %12llu\n", WORKLOADS[w].name, n, ops, ns_op, cmp_op,
+                   (unsigned long long)skip_count);
+            fflush(stdout);
+
+            if (out)
+                fprintf(out, "%s    {\"workload\": \"%s\", \"n\": %zu, \"ops\": %zu, \"ns_per_op\": %.3f, \"cmp_per_op\": %.3f, \"skipped\": %llu}",
+                        first ? "" : ",\n", WORKLOADS[w].name, n, ops, ns_op, cmp_op, (unsigned long long)skip_count);
+            first = 0;
+        }
+    }
+
+    if (out) {
+        fprintf(out, "\n  ]\n}\n");
+        fclose(out);
+    }
+
+    return 0;
+}
@@ -0,0 +1,374 @@
+#include "pq.h"
+#include "spq.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <queue>
+#include <vector>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/*
+ * Runs the same workloads through guilib's pq_t, std::priority_queue and a
+ * plain-array binary heap, for three element kinds:
+ *  - ptr:  pointers to structs holding a 64-bit key (pq_t's native use case)
+ *  - int:  inline 64-bit integers (pq_t has to box them behind a pointer)
+ *  - str:  pointers to 32-byte strings sharing a long prefix (expensive compare)
+ *  - name: pointers to 32-byte strings that differ early (random names)
+ *
+ * String kinds also run through spq_t, which caches 8-byte key prefixes; its
+ * cmp/op counts the comparisons that had to read the strings.
+ *
+ * Every run happens in a forked child so that the peak RSS growth it reports
+ * belongs to that backend alone.
+ */
+
+#define STR_LEN 32
+
+struct elem_t {
+    uint64_t key;
+};
+
+struct str_elem_t {
+    char key[STR_LEN];
+};
+
+struct result_t {
+    double ns;
+    uint64_t ops;
+    uint64_t cmps;
+    long rss_kb;
+};
+
+static uint64_t cmp_count;
+static uint64_t rng_state = 0x2545f4914f6cdd1dULL;
+
+static uint64_t rng() {
+    uint64_t z = (rng_state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static double now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static long peak_rss_kb() {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_maxrss;
+}
+
+/* Keys drift upwards with the index so that the hold workload behaves like a clock. */
+static uint64_t pool_key(size_t i, size_t n) {
+    return i * 16 + rng() % (n * 16);
+}
+
+struct ptr_kind {
+    typedef elem_t *value_type;
+    static const char *name() { return "ptr"; }
+
+    static std::vector<elem_t> storage;
+    static std::vector<value_type> make(size_t total, size_t n) {
+        storage.resize(total);
+        std::vector<value_type> v(total);
+        for (size_t i = 0; i < total; i++) {
+            storage[i].key = pool_key(i, n);
+            v[i] = &storage[i];
+        }
+        return v;
+    }
+    static bool less(value_type a, value_type b) {
+        cmp_count++;
+        return a->key < b->key;
+    }
+    static int c_cmp(const void *a, const void *b) {
+        uint64_t ka = ((const elem_t *)a)->key, kb = ((const elem_t *)b)->key;
+        cmp_count++;
+        return (ka > kb) - (ka < kb);
+    }
+    static void *box(value_type *v) { return *v; }
+};
+std::vector<elem_t> ptr_kind::storage;
+
+struct int_kind {
+    typedef uint64_t value_type;
+    static const char *name() { return "int"; }
+
+    static std::vector<value_type> make(size_t total, size_t n) {
+        std::vector<value_type> v(total);
+        for (size_t i = 0; i < total; i++)
+            v[i] = pool_key(i, n);
+        return v;
+    }
+    static bool less(value_type a, value_type b) {
+        cmp_count++;
+        return a < b;
+    }
+    static int c_cmp(const void *a, const void *b) {
+        uint64_t ka = *(const uint64_t *)a, kb = *(const uint64_t *)b;
+        cmp_count++;
+        return (ka > kb) - (ka < kb);
+    }
+    static void *box(value_type *v) { return v; }
+};
+
+struct str_kind {
+    typedef const str_elem_t *value_type;
+    static const char *name() { return "str"; }
+
+    static std::vector<str_elem_t> storage;
+    static std::vector<value_type> make(size_t total, size_t n) {
+        storage.resize(total);
+        std::vector<value_type> v(total);
+        for (size_t i = 0; i < total; i++) {
+            snprintf(storage[i].key, STR_LEN, "tenant/region/%017llu", (unsigned long long)pool_key(i, n));
+            v[i] = &storage[i];
+        }
+        return v;
+    }
+    static bool less(value_type a, value_type b) {
+        cmp_count++;
+        return strcmp(a->key, b->key) < 0;
+    }
+    static int c_cmp(const void *a, const void *b) {
+        cmp_count++;
+        return strcmp(((const str_elem_t *)a)->key, ((const str_elem_t *)b)->key);
+    }
+    static void *box(value_type *v) { return (void *)*v; }
+    static const char *key(value_type v) { return v->key; }
+};
+std::vector<str_elem_t> str_kind::storage;
+
+struct name_kind : str_kind {
+    static const char *name() { return "name"; }
+
+    static std::vector<value_type> make(size_t total, size_t) {
+        storage.resize(total);
+        std::vector<value_type> v(total);
+        for (size_t i = 0; i < total; i++) {
+            snprintf(storage[i].key, STR_LEN, "%016llx/worker", (unsigned long long)rng());
+            v[i] = &storage[i];
+        }
+        return v;
+    }
+};
+
+template <class K>
+struct guilib_backend {
+    static const char *name() { return "guilib"; }
+
+    pq_t *pq;
+    guilib_backend(size_t n) : pq(pq_create(n, K::c_cmp)) {}
+    ~guilib_backend() { pq_destroy(pq, NULL); }
+    void push(typename K::value_type *v) { pq_insert(pq, K::box(v)); }
+    void pop() { pq_remove(pq); }
+    bool empty() { return pq_is_empty(pq); }
+};
+
+template <class K>
+struct spq_backend {
+    static const char *name() { return "spq"; }
+
+    spq_t *q;
+    spq_backend(size_t n) : q(spq_create(n)) {}
+    ~spq_backend() {
+        cmp_count += spq_fallbacks(q);
+        spq_destroy(q, NULL);
+    }
+    void push(typename K::value_type *v) { spq_insert(q, K::key(*v), K::box(v)); }
+    void pop() { spq_remove(q, NULL); }
+    bool empty() { return spq_is_empty(q); }
+};
+
+template <class K>
+struct std_backend {
+    static const char *name() { return "std"; }
+
+    struct greater {
+        bool operator()(typename K::value_type a, typename K::value_type b) const { return K::less(b, a); }
+    };
+    std::priority_queue<typename K::value_type, std::vector<typename K::value_type>, greater> q;
+    std_backend(size_t) {}
+    void push(typename K::value_type *v) { q.push(*v); }
+    void pop() { q.pop(); }
+    bool empty() { return q.empty(); }
+};
+
+/* Fixed-capacity binary heap over a plain array with hole-based sifting. */
+template <class K>
+struct array_backend {
+    static const char *name() { return "array"; }
+
+    typedef typename K::value_type value_type;
+    value_type *arr;
+    size_t len;
+    array_backend(size_t n) : arr((value_type *)malloc(n * sizeof(value_type))), len(0) {}
+    ~array_backend() { free(arr); }
+
+    void push(value_type *v) {
+        size_t i = len++;
+        while (i > 0 && K::less(*v, arr[(i - 1) >> 1])) {
+            arr[i] = arr[(i - 1) >> 1];
+            i = (i - 1) >> 1;
+        }
+        arr[i] = *v;
+    }
+    void pop() {
+        value_type x = arr[--len];
+        size_t i = 0, c;
+        while ((c = 2 * i + 1) < len) {
+            if (c + 1 < len && K::less(arr[c + 1], arr[c]))
+                c++;
+            if (!K::less(arr[c], x))
+                break;
+            arr[i] = arr[c];
+            i = c;
+        }
+        arr[i] = x;
+    }
+    bool empty() { return !len; }
+};
+
+template <class K, template <class> class B>
+static result_t run(const char *workload, size_t n) {
+    size_t holds = strcmp(workload, "hold") ? 0 : 2 * n;
+    std::vector<typename K::value_type> pool = K::make(n + holds, n);
+    result_t res = {0, 0, 0, 0};
+    long rss0 = peak_rss_kb();
+
+    cmp_count = 0;
+    double t0 = now_ns();
+    {
+        B<K> q(n);
+        for (size_t i = 0; i < n; i++)
+            q.push(&pool[i]);
+        for (size_t h = 0; h < holds; h++) {
+            q.pop();
+            q.push(&pool[n + h]);
+        }
+        while (!q.empty())
+            q.pop();
+        res.rss_kb = peak_rss_kb() - rss0;
+    }
+    res.ns = now_ns() - t0;
+    res.ops = 2 * n + 2 * holds;
+    res.cmps = cmp_count;
+
+    return res;
+}
+
+typedef result_t (*runner_t)(const char *, size_t);
+
+struct entry_t {
+    const char *backend;
+    const char *kind;
+    runner_t run;
+};
+
+#define ENTRIES(K) \
+    {guilib_backend<K>::name(), K::name(), run<K, guilib_backend>}, \
+    {std_backend<K>::name(), K::name(), run<K, std_backend>}, \
+    {array_backend<K>::name(), K::name(), run<K, array_backend>}
+
+static const entry_t ENTRIES_ALL[] = {
+    ENTRIES(ptr_kind),
+    ENTRIES(int_kind),
+    ENTRIES(str_kind),
+    {spq_backend<str_kind>::name(), str_kind::name(), run<str_kind, spq_backend>},
+    ENTRIES(name_kind),
+    {spq_backend<name_kind>::name(), name_kind::name(), run<name_kind, spq_backend>},
+};
+
+static bool run_isolated(const entry_t &e, const char *workload, size_t n, result_t *out) {
+    int fds[2];
+    if (pipe(fds))
+        return false;
+
+    pid_t pid = fork();
+    if (!pid) {
+        close(fds[0]);
+        result_t r = e.run(workload, n);
+        ssize_t w = write(fds[1], &r, sizeof(r));
+        _exit(w == (ssize_t)sizeof(r) ? 0 : 1);
+    }
+
+    close(fds[1]);
+    ssize_t got = read(fds[0], out, sizeof(*out));
+    close(fds[0]);
+
+    int status;
+    waitpid(pid, &status, 0);
+    return got == (ssize_t)sizeof(*out) && WIFEXITED(status) && !WEXITSTATUS(status);
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [-o out.json] SIZE...\n"
+            "Sizes accept scientific notation, e.g. 1e6\n", prog);
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    const char *out_path = NULL;
+    std::vector<size_t> sizes;
+    static const char *const workloads[] = {"rand", "hold"};
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-o") && i + 1 < argc)
+            out_path = argv[++i];
+        else if (argv[i][0] == '-')
+            usage(argv[0]);
+        else
+            sizes.push_back((size_t)strtod(argv[i], NULL));
+    }
+    if (sizes.empty())
+        usage(argv[0]);
+
+    FILE *out = out_path ? fopen(out_path, "w") : NULL;
+    if (out_path && !out) {
+        perror(out_path);
+        return 1;
+    }
+    if (out)
+        fprintf(out, "{\n  \"cc\": \"%s\",\n  \"results\": [\n", __VERSION__);
+
+    printf("%-6s %-5s %-7s %12s %10s %10s %10s %12s\n",
+           "work", "kind", "backend", "n", "ns/op", "Mops/s", "cmp/op", "peak RSS KB");
+
+    bool first = true;
+    for (const char *workload : workloads)
+        for (size_t n : sizes)
+            for (const entry_t &e : ENTRIES_ALL) {
+                result_t r;
+                if (!run_isolated(e, workload, n ? n : 1, &r)) {
+                    fprintf(stderr, "bench_error: %s/%s/%s n=%zu failed\n", workload, e.kind, e.backend, n);
+                    continue;
+                }
+
+                double ns_op = r.ns / r.ops, cmp_op = (double)r.cmps / r.ops;
+                printf("%-6s %-5s %-7s %12zu %10.2f %10.2f %10.2f %12ld\n",
+                       workload, e.kind, e.backend, n, ns_op, 1e3 / ns_op, cmp_op, r.rss_kb);
+                fflush(stdout);
+
+                if (out)
+                    fprintf(out, "%s    {\"workload\": \"%s\", \"kind\": \"%s\", \"backend\": \"%s\", \"n\": %zu, "
+                            "\"ops\": %llu, \"ns_per_op\": %.3f, \"cmp_per_op\": %.3f, \"peak_rss_kb\": %ld}",
+                            first ? "" : ",\n", workload, e.kind, e.backend, n,
+                            (unsigned long long)r.ops, ns_op, cmp_op, r.rss_kb);
+                first = false;
+            }
+
+    if (out) {
+        fprintf(out, "\n  ]\n}\n");
+        fclose(out);
+    }
+
+    return 0;
+}
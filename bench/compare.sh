@@ -0,0 +1,20 @@
+#!/bin/bash
+
+# Compares two bench.json files produced by `make bench` and prints the
+# ns/op and cmp/op ratio (new / old) for every workload and size present in both.
+
+if [ $# -ne 2 ]; then
+    echo "Usage: $0 OLD.json NEW.json" >&2
+    exit 1
+fi
+
+extract() {
+    sed -n 's/.*"workload": "\([^"]*\)", "n": \([0-9]*\), "ops": [0-9]*, "ns_per_op": \([0-9.]*\), "cmp_per_op": \([0-9.]*\).*/\1 \2 \3 \4/p' "$1"
+}
+
+join -j1 <(extract "$1" | awk '{print $1 "/" $2, $3, $4}' | sort) \
+         <(extract "$2" | awk '{print $1 "/" $2, $3, $4}' | sort) |
+    awk 'BEGIN { printf "%-20s %12s %12s %8s %10s\n", "workload/n", "old ns/op", "new ns/op", "ratio", "cmp ratio" }
+         { printf "%-20s %12.2f %12.2f %8.3f %10.3f\n", $1, $2, $4, $4 / $2, ($3 > 0 ? $5 / $3 : 1)
+           if ($2 > 0 && $4 > 0) { log_sum += log($4 / $2); n++ } }
+         END { if (n) printf "%-20s %12s %12s %8.3f\n", "geomean", "", "", exp(log_sum / n) }'
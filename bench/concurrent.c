@@ -0,0 +1,409 @@
+#define _GNU_SOURCE
+#include "pq.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * Concurrent scaling benchmark for front ends that share pq_t between threads:
+ *  - locked: a single pq_t behind a mutex (strict order).
+ *  - multiq: MULTIQ_C queues per thread, each behind its own mutex. Inserts go to a
+ *    random queue, removals pop the better top of two random queues (relaxed order).
+ *
+ * Every run is time-boxed with pinned threads and reports ops/s and Jain's fairness
+ * index over per-thread operation counts. A second, instrumented run stamps every
+ * operation with a global sequence number and replays the log offline to measure
+ * the rank error of each removal (0 for strict front ends). Output is CSV.
+ *
+ * Thread counts double up to the maximum. For each count the benchmark runs mixed
+ * threads (every thread both produces and consumes, reported as t producers and t
+ * consumers) followed by 1:1, 1:3 and 3:1 producer:consumer splits.
+ */
+
+#define MULTIQ_C 2
+#define CACHE_LINE 64
+/* aligned_alloc() wants a size that is a multiple of the alignment. */
+#define LINES(bytes) (((bytes) + CACHE_LINE - 1) & ~(size_t)(CACHE_LINE - 1))
+#define LOG_OPS 200000
+
+typedef struct {
+    pq_t                *pq;
+    pthread_mutex_t     lock;
+    atomic_uint_fast64_t top;
+    char                pad[64];
+} shard_t;
+
+typedef struct {
+    const char          *name;
+    size_t              n_shards_per_thread;
+} frontend_t;
+
+typedef struct {
+    uint64_t            seq;
+    uint64_t            key;
+    uint8_t             op;
+} log_t;
+
+typedef struct {
+    pthread_t           thread;
+    int                 id;
+    int                 role;
+    uint64_t            rng;
+    uint64_t            ops;
+    log_t               *log;
+    size_t              log_len;
+    char                pad[64];
+} worker_t;
+
+enum { ROLE_MIXED, ROLE_PRODUCER, ROLE_CONSUMER };
+
+static const frontend_t FRONTENDS[] = {
+    {"locked", 0},
+    {"multiq", MULTIQ_C},
+};
+
+static shard_t *shards;
+static size_t n_shards;
+static atomic_int stop;
+static atomic_int ready;
+static atomic_int go;
+static atomic_uint_fast64_t seq;
+static int logging;
+static long n_cpus;
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static inline uint64_t rng(uint64_t *s) {
+    uint64_t z = (*s += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/* Keys are stored in the element pointer itself, so no allocation is measured. */
+static int key_cmp(const void *a, const void *b) {
+    uintptr_t ka = (uintptr_t)a, kb = (uintptr_t)b;
+    return (ka > kb) - (ka < kb);
+}
+
+static inline void record(worker_t *w, uint8_t op, uint64_t key) {
+    if (logging && w->log_len < LOG_OPS)
+        w->log[w->log_len++] = (log_t){atomic_fetch_add(&seq, 1), key, op};
+}
+
+/* Publishes the shard minimum so that removals can choose without locking. */
+static inline void publish_top(shard_t *s) {
+    uint64_t top = pq_is_empty(s->pq) ? UINT64_MAX : (uintptr_t)pq_peek(s->pq);
+    atomic_store_explicit(&s->top, top, memory_order_relaxed);
+}
+
+static int do_insert(worker_t *w) {
+    uint64_t key = (rng(&w->rng) >> 2) + 1;
+    shard_t *s = &shards[n_shards > 1 ? rng(&w->rng) % n_shards : 0];
+    int ok = 0;
+
+    pthread_mutex_lock(&s->lock);
+    if (pq_len(s->pq) < pq_size(s->pq)) {
+        pq_insert(s->pq, (void *)(uintptr_t)key);
+        record(w, PQ_TRACE_INSERT, key);
+        if (n_shards > 1)
+            publish_top(s);
+        ok = 1;
+    }
+    pthread_mutex_unlock(&s->lock);
+
+    return ok;
+}
+
+static int do_remove(worker_t *w) {
+    shard_t *s = &shards[0];
+
+    if (n_shards > 1) {
+        shard_t *a = &shards[rng(&w->rng) % n_shards], *b = &shards[rng(&w->rng) % n_shards];
+        uint64_t ta = atomic_load_explicit(&a->top, memory_order_relaxed);
+        uint64_t tb = atomic_load_explicit(&b->top, memory_order_relaxed);
+        s = ta <= tb ? a : b;
+    }
+
+    int ok = 0;
+    pthread_mutex_lock(&s->lock);
+    if (!pq_is_empty(s->pq)) {
+        uint64_t key = (uintptr_t)pq_remove(s->pq);
+        record(w, PQ_TRACE_REMOVE, key);
+        if (n_shards > 1)
+            publish_top(s);
+        ok = 1;
+    }
+    pthread_mutex_unlock(&s->lock);
+
+    return ok;
+}
+
+static void *work(void *arg) {
+    worker_t *w = arg;
+
+    if (n_cpus > 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(w->id % n_cpus, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+
+    atomic_fetch_add(&ready, 1);
+    while (!atomic_load(&go))
+        sched_yield();
+
+    while (!atomic_load_explicit(&stop, memory_order_relaxed)) {
+        int insert = w->role == ROLE_PRODUCER || (w->role == ROLE_MIXED && rng(&w->rng) & 1);
+        w->ops += insert ? do_insert(w) : do_remove(w);
+    }
+
+    return NULL;
+}
+
+static int log_cmp(const void *a, const void *b) {
+    uint64_t sa = ((const log_t *)a)->seq, sb = ((const log_t *)b)->seq;
+    return (sa > sb) - (sa < sb);
+}
+
+static int u64_cmp(const void *a, const void *b) {
+    uint64_t ka = *(const uint64_t *)a, kb = *(const uint64_t *)b;
+    return (ka > kb) - (ka < kb);
+}
+
+static size_t key_rank(const uint64_t *keys, size_t n, uint64_t key) {
+    size_t lo = 0, hi = n;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (keys[mid] < key)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/*
+ * Replays the merged operation log against a Fenwick tree over key ranks: the
+ * rank error of a removal is the number of queued keys smaller than the one removed.
+ * Only the prefix in which every thread still logged is complete, so replay stops there.
+ */
+static void rank_error(worker_t *w, int n_threads, const uint64_t *prefill, size_t n_prefill,
+                       double *mean, uint64_t *max) {
+    size_t total = 0, n_keys = n_prefill;
+    uint64_t horizon = UINT64_MAX;
+
+    for (int t = 0; t < n_threads; t++) {
+        total += w[t].log_len;
+        if (w[t].log_len == LOG_OPS && w[t].log[LOG_OPS - 1].seq < horizon)
+            horizon = w[t].log[LOG_OPS - 1].seq;
+    }
+
+    log_t *all = malloc((total ? total : 1) * sizeof(log_t));
+    uint64_t *keys = malloc((n_prefill + total + 1) * sizeof(uint64_t));
+    total = 0;
+    memcpy(keys, prefill, n_prefill * sizeof(uint64_t));
+    for (int t = 0; t < n_threads; t++)
+        for (size_t i = 0; i < w[t].log_len; i++)
+            if (w[t].log[i].seq <= horizon) {
+                all[total++] = w[t].log[i];
+                if (w[t].log[i].op == PQ_TRACE_INSERT)
+                    keys[n_keys++] = w[t].log[i].key;
+            }
+
+    qsort(all, total, sizeof(log_t), log_cmp);
+    qsort(keys, n_keys, sizeof(uint64_t), u64_cmp);
+
+    int64_t *fen = calloc(n_keys + 1, sizeof(int64_t));
+#define FEN_ADD(i, v) for (size_t _j = (i) + 1; _j <= n_keys; _j += _j & -_j) fen[_j] += (v)
+
+    for (size_t i = 0; i < n_prefill; i++)
+        FEN_ADD(key_rank(keys, n_keys, prefill[i]), 1);
+
+    uint64_t sum = 0, removes = 0;
+    *max = 0;
+    for (size_t i = 0; i < total; i++) {
+        size_t r = key_rank(keys, n_keys, all[i].key);
+        if (all[i].op == PQ_TRACE_INSERT) {
+            FEN_ADD(r, 1);
+            continue;
+        }
+
+        uint64_t smaller = 0;
+        for (size_t j = r; j > 0; j -= j & -j)
+            smaller += fen[j];
+        FEN_ADD(r, -1);
+
+        sum += smaller;
+        removes++;
+        if (smaller > *max)
+            *max = smaller;
+    }
+#undef FEN_ADD
+
+    *mean = removes ? (double)sum / removes : 0;
+    free(fen);
+    free(keys);
+    free(all);
+}
+
+/*
+ * Returns the wall time the workers ran, from releasing them all at once to the last
+ * join, so that start-up and join skew do not inflate ops/s.
+ */
+static double run(const frontend_t *fe, int n_threads, int producers, size_t prefill, double seconds,
+                int with_log, uint64_t *ops, double *fairness, uint64_t *min_ops, uint64_t *max_ops,
+                double *err_mean, uint64_t *err_max) {
+    n_shards = fe->n_shards_per_thread ? fe->n_shards_per_thread * n_threads : 1;
+    shards = aligned_alloc(CACHE_LINE, LINES(n_shards * sizeof(shard_t)));
+
+    size_t cap = (prefill + (1 << 20)) / n_shards + 1;
+    uint64_t fill_rng = 42, *prefill_keys = malloc((prefill ? prefill : 1) * sizeof(uint64_t));
+    for (size_t s = 0; s < n_shards; s++) {
+        shards[s].pq = pq_create(cap, key_cmp);
+        pthread_mutex_init(&shards[s].lock, NULL);
+    }
+    for (size_t i = 0; i < prefill; i++) {
+        prefill_keys[i] = (rng(&fill_rng) >> 2) + 1;
+        pq_insert(shards[i % n_shards].pq, (void *)(uintptr_t)prefill_keys[i]);
+    }
+    for (size_t s = 0; s < n_shards; s++)
+        publish_top(&shards[s]);
+
+    worker_t *w = aligned_alloc(CACHE_LINE, LINES(n_threads * sizeof(worker_t)));
+    atomic_store(&stop, 0);
+    atomic_store(&ready, 0);
+    atomic_store(&go, 0);
+    atomic_store(&seq, 1);
+    logging = with_log;
+
+    for (int t = 0; t < n_threads; t++) {
+        memset(&w[t], 0, sizeof(worker_t));
+        w[t].id = t;
+        w[t].rng = 0x1234567ULL * (t + 1);
+        w[t].role = !producers ? ROLE_MIXED : t < producers ? ROLE_PRODUCER : ROLE_CONSUMER;
+        w[t].log = with_log ? malloc(LOG_OPS * sizeof(log_t)) : NULL;
+        pthread_create(&w[t].thread, NULL, work, &w[t]);
+    }
+
+    while (atomic_load(&ready) < n_threads)
+        sched_yield();
+    double start = now_sec();
+    atomic_store(&go, 1);
+    struct timespec ts = {(time_t)seconds, (long)((seconds - (time_t)seconds) * 1e9)};
+    nanosleep(&ts, NULL);
+    atomic_store(&stop, 1);
+
+    double sum = 0, sum_sq = 0;
+    *ops = 0;
+    *min_ops = UINT64_MAX;
+    *max_ops = 0;
+    for (int t = 0; t < n_threads; t++) {
+        pthread_join(w[t].thread, NULL);
+        *ops += w[t].ops;
+        sum += w[t].ops;
+        sum_sq += (double)w[t].ops * w[t].ops;
+        *min_ops = w[t].ops < *min_ops ? w[t].ops : *min_ops;
+        *max_ops = w[t].ops > *max_ops ? w[t].ops : *max_ops;
+    }
+    double elapsed = now_sec() - start;
+    *fairness = sum_sq > 0 ? sum * sum / (n_threads * sum_sq) : 1;
+
+    if (with_log)
+        rank_error(w, n_threads, prefill_keys, prefill, err_mean, err_max);
+
+    for (int t = 0; t < n_threads; t++)
+        free(w[t].log);
+    for (size_t s = 0; s < n_shards; s++) {
+        pq_destroy(shards[s].pq, NULL);
+        pthread_mutex_destroy(&shards[s].lock);
+    }
+    free(w);
+    free(shards);
+    free(prefill_keys);
+    return elapsed;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [-t max_threads] [-d seconds] [-o out.csv] SIZE...\n"
+            "SIZE is the number of prefilled elements; sizes accept scientific notation, e.g. 1e6\n", prog);
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    const char *out_path = NULL;
+    size_t sizes[64], n_sizes = 0;
+    double seconds = 0.2;
+    int max_threads;
+
+    n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    max_threads = n_cpus > 0 ? (int)n_cpus : 1;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-o") && i + 1 < argc)
+            out_path = argv[++i];
+        else if (!strcmp(argv[i], "-t") && i + 1 < argc)
+            max_threads = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-d") && i + 1 < argc)
+            seconds = atof(argv[++i]);
+        else if (argv[i][0] == '-' || n_sizes == 64)
+            usage(argv[0]);
+        else
+            sizes[n_sizes++] = (size_t)strtod(argv[i], NULL);
+    }
+    if (!n_sizes || max_threads < 1 || seconds <= 0)
+        usage(argv[0]);
+
+    FILE *out = out_path ? fopen(out_path, "w") : stdout;
+    if (!out) {
+        perror(out_path);
+        return 1;
+    }
+
+    fprintf(out, "frontend,threads,producers,consumers,prefill,ops_per_sec,fairness,min_thread_ops,"
+            "max_thread_ops,rank_err_mean,rank_err_max\n");
+
+    for (size_t s = 0; s < n_sizes; s++)
+        for (size_t f = 0; f < sizeof(FRONTENDS) / sizeof(*FRONTENDS); f++)
+            for (int t = 1; t <= max_threads; t = t < max_threads && 2 * t > max_threads ? max_threads : 2 * t) {
+                /* Mixed threads, then 1:1, 1:3 and 3:1 producer:consumer splits. */
+                int splits[][2] = {{0, 0}, {t / 2, t - t / 2}, {t / 4, t - t / 4}, {t - t / 4, t / 4}};
+
+                for (size_t r = 0; r < sizeof(splits) / sizeof(*splits); r++) {
+                    int p = splits[r][0], c = splits[r][1];
+                    if (r && (!p || !c || (r > 1 && t < 4)))
+                        continue;
+
+                    uint64_t ops, min_ops, max_ops, err_max = 0, unused_max;
+                    double fairness, err_mean = 0, unused;
+                    double elapsed = run(&FRONTENDS[f], t, p, sizes[s], seconds, 0, &ops, &fairness, &min_ops, &max_ops,
+                        &unused, &unused_max);
+                    run(&FRONTENDS[f], t, p, sizes[s], seconds / 4, 1, &unused_max, &unused, &unused_max,
+                        &unused_max, &err_mean, &err_max);
+
+                    fprintf(out, "%s,%d,%d,%d,%zu,%.0f,%.4f,%llu,%llu,%.3f,%llu\n", FRONTENDS[f].name, t,
+                            p ? p : t, p ? c : t, sizes[s], ops / elapsed, fairness, (unsigned long long)min_ops,
+                            (unsigned long long)max_ops, err_mean, (unsigned long long)err_max);
+                    fflush(out);
+                }
+
+                if (t == max_threads)
+                    break;
+            }
+
+    if (out != stdout)
+        fclose(out);
+
+    return 0;
+}
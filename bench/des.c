@@ -0,0 +1,183 @@
+#include "des.h"
+#include "pq.h"
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Event list benchmark in the classic hold model: N events are pending, and every
+ * dispatched event schedules one more after a random delay, so the list stays at N
+ * while time moves on. Compares a pq_t of malloc'd events ordered by (time, seq),
+ * the usual hand-rolled event list, against des_t with its heap and calendar queue
+ * backends. Delays are uniform or exponential; both have mean MEAN_DELAY.
+ */
+
+#define MEAN_DELAY 1000
+#define HOLDS_PER_EVENT 8
+#define HOLDS_MIN 1000000
+
+typedef struct {
+    uint64_t            time;
+    uint64_t            seq;
+} event_t;
+
+typedef struct {
+    const char          *name;
+    double              ns;
+    uint64_t            checksum;
+} result_t;
+
+static uint64_t rng_state = 0x2545f4914f6cdd1dULL;
+static int exponential;
+static size_t holds, dispatched;
+static uint64_t checksum;
+
+static uint64_t rng(void) {
+    uint64_t z = (rng_state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static uint64_t delay(void) {
+    if (!exponential)
+        return rng() % (2 * MEAN_DELAY + 1);
+
+    double u = ((rng() >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+    return (uint64_t)(-log(u) * MEAN_DELAY);
+}
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int event_cmp(const void *a, const void *b) {
+    const event_t *x = a, *y = b;
+
+    if (x->time != y->time)
+        return x->time < y->time ? -1 : 1;
+    return (x->seq > y->seq) - (x->seq < y->seq);
+}
+
+static void run_pq(size_t n, result_t *r) {
+    pq_t *pq = pq_create(n + 1, event_cmp);
+    uint64_t seq = 0;
+
+    rng_state = n;
+    for (size_t i = 0; i < n; i++) {
+        event_t *e = malloc(sizeof(event_t));
+        *e = (event_t){delay(), seq++};
+        pq_insert(pq, e);
+    }
+
+    double t0 = now_ns();
+    for (size_t h = 0; h < holds; h++) {
+        event_t *e = (event_t *)pq_remove(pq);
+        uint64_t now = e->time;
+
+        r->checksum += now;
+        free(e);
+
+        e = malloc(sizeof(event_t));
+        *e = (event_t){now + delay(), seq++};
+        pq_insert(pq, e);
+    }
+    r->ns += now_ns() - t0;
+
+    pq_destroy(pq, free);
+}
+
+static void hold(des_t *des, void *arg) {
+    (void)arg;
+
+    if (dispatched++ < holds) {
+        checksum += des_now(des);
+        des_schedule(des, des_now(des) + delay(), hold, NULL);
+    }
+}
+
+static void run_des(size_t n, unsigned flags, result_t *r) {
+    des_t *des = des_create(n, flags);
+
+    rng_state = n;
+    for (size_t i = 0; i < n; i++)
+        des_schedule(des, delay(), hold, NULL);
+
+    double t0 = now_ns();
+    checksum = dispatched = 0;
+    while (dispatched < holds)
+        des_step(des);
+    r->ns += now_ns() - t0;
+    r->checksum += checksum;
+
+    des_destroy(des, NULL);
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [-e] [-o out.json] SIZE...\n"
+            "Holds SIZE pending events, with uniform delays or exponential with -e\n", prog);
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    const char *out_path = NULL;
+    size_t sizes[64], n_sizes = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-o") && i + 1 < argc)
+            out_path = argv[++i];
+        else if (!strcmp(argv[i], "-e"))
+            exponential = 1;
+        else if (argv[i][0] == '-' || n_sizes == 64)
+            usage(argv[0]);
+        else
+            sizes[n_sizes++] = (size_t)strtod(argv[i], NULL);
+    }
+    if (!n_sizes)
+        usage(argv[0]);
+
+    FILE *out = out_path ? fopen(out_path, "w") : NULL;
+    if (out_path && !out) {
+        perror(out_path);
+        return 1;
+    }
+    if (out)
+        fprintf(out, "{\n  \"delays\": \"%s\",\n  \"results\": [\n", exponential ? "exponential" : "uniform");
+
+    printf("%-14s %10s %12s %12s\n", "run", "pending", "holds", "ns/hold");
+
+    for (size_t s = 0; s < n_sizes; s++) {
+        size_t n = sizes[s] ? sizes[s] : 1;
+        holds = n * HOLDS_PER_EVENT < HOLDS_MIN ? HOLDS_MIN : n * HOLDS_PER_EVENT;
+
+        result_t res[3] = {{"pq-malloc"}, {"des-heap"}, {"des-calendar"}};
+        run_pq(n, &res[0]);
+        run_des(n, 0, &res[1]);
+        run_des(n, DES_CALENDAR, &res[2]);
+
+        if (res[1].checksum != res[0].checksum || res[2].checksum != res[0].checksum) {
+            fprintf(stderr, "des: event order differs at %zu pending events\n", n);
+            return 1;
+        }
+
+        for (int r = 0; r < 3; r++) {
+            printf("%-14s %10zu %12zu %12.1f\n", res[r].name, n, holds, res[r].ns / holds);
+            if (out)
+                fprintf(out, "%s    {\"run\": \"%s\", \"pending\": %zu, \"holds\": %zu, \"ns_per_hold\": %.2f}",
+                        s || r ? ",\n" : "", res[r].name, n, holds, res[r].ns / holds);
+        }
+    }
+
+    if (out) {
+        fprintf(out, "\n  ]\n}\n");
+        fclose(out);
+    }
+
+    return 0;
+}
@@ -0,0 +1,325 @@
+#include "graph.h"
+#include "pq.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Shortest path benchmark on road-network-like grids: side x side intersections
+ * joined to their 4 neighbours by two-way streets of random length, a few streets
+ * closed, and every ARTERIAL_EVERY-th row and column a fast arterial road. Compares
+ * graph_dijkstra() against the textbook pq_t loop that queues duplicates and skips
+ * stale entries and against graph_delta_stepping(), then point-to-point queries with
+ * and without an A* heuristic.
+ */
+
+#define ARTERIAL_EVERY 32
+#define CLOSED_PER_MILLE 50
+#define STREET_MIN 10
+#define STREET_SPAN 90
+#define ARTERIAL_MIN 1
+#define ARTERIAL_SPAN 9
+
+typedef struct {
+    uint64_t            dist;
+    uint32_t            node;
+} entry_t;
+
+typedef struct {
+    const char          *name;
+    size_t              queries;
+    double              ns;
+    uint64_t            settled;
+    uint64_t            pushes;
+    uint64_t            checksum;
+} result_t;
+
+static uint64_t rng_state = 0x2545f4914f6cdd1dULL;
+static uint32_t grid_side;
+static uint64_t delta;
+static unsigned threads;
+
+static uint64_t rng(void) {
+    uint64_t z = (rng_state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void grid_free(graph_t *g) {
+    free((void *)g->offsets);
+    free((void *)g->targets);
+    free((void *)g->weights);
+}
+
+/* Weight of the street from (x, y) towards +x (horizontal) or +y, or 0 if closed. */
+static uint32_t street(uint32_t x, uint32_t y, int horizontal) {
+    if (horizontal ? y % ARTERIAL_EVERY == 0 : x % ARTERIAL_EVERY == 0)
+        return ARTERIAL_MIN + rng() % ARTERIAL_SPAN;
+
+    if (rng() % 1000 < CLOSED_PER_MILLE)
+        return 0;
+
+    return STREET_MIN + rng() % STREET_SPAN;
+}
+
+static graph_t grid_create(uint32_t side) {
+    size_t n = (size_t)side * side;
+    uint32_t *right = malloc(n * sizeof(uint32_t)), *down = malloc(n * sizeof(uint32_t));
+    size_t *offsets = calloc(n + 1, sizeof(size_t));
+
+    for (uint32_t y = 0; y < side; y++) {
+        for (uint32_t x = 0; x < side; x++) {
+            size_t v = (size_t)y * side + x;
+
+            right[v] = x + 1 < side ? street(x, y, 1) : 0;
+            down[v] = y + 1 < side ? street(x, y, 0) : 0;
+            offsets[v + 1] += (right[v] != 0) + (down[v] != 0);
+            if (right[v])
+                offsets[v + 2]++;
+            if (down[v])
+                offsets[v + side + 1]++;
+        }
+    }
+
+    for (size_t v = 0; v < n; v++)
+        offsets[v + 1] += offsets[v];
+
+    uint32_t *targets = malloc(offsets[n] * sizeof(uint32_t)), *weights = malloc(offsets[n] * sizeof(uint32_t));
+    size_t *fill = malloc(n * sizeof(size_t));
+    memcpy(fill, offsets, n * sizeof(size_t));
+
+    for (size_t v = 0; v < n; v++) {
+        if (right[v]) {
+            targets[fill[v]] = v + 1, weights[fill[v]++] = right[v];
+            targets[fill[v + 1]] = v, weights[fill[v + 1]++] = right[v];
+        }
+        if (down[v]) {
+            targets[fill[v]] = v + side, weights[fill[v]++] = down[v];
+            targets[fill[v + side]] = v, weights[fill[v + side]++] = down[v];
+        }
+    }
+
+    free(fill);
+    free(right);
+    free(down);
+    return (graph_t){(uint32_t)n, offsets, targets, weights};
+}
+
+/* Every edge is at least ARTERIAL_MIN long, so this never overestimates. */
+static uint64_t manhattan(uint32_t v, void *arg) {
+    uint32_t t = *(const uint32_t *)arg;
+    uint32_t vx = v % grid_side, vy = v / grid_side, tx = t % grid_side, ty = t / grid_side;
+
+    return (uint64_t)ARTERIAL_MIN * ((vx > tx ? vx - tx : tx - vx) + (vy > ty ? vy - ty : ty - vy));
+}
+
+static int entry_cmp(const void *a, const void *b) {
+    uint64_t da = ((const entry_t *)a)->dist, db = ((const entry_t *)b)->dist;
+    return (da > db) - (da < db);
+}
+
+/* Dijkstra without decrease-key: every improvement queues a new entry. */
+static void lazy_dijkstra(const graph_t *g, uint32_t source, uint64_t *dist, entry_t *pool, result_t *r) {
+    pq_t *pq = pq_create(g->offsets[g->nodes] + 1, entry_cmp);
+    size_t used = 0;
+
+    for (uint32_t v = 0; v < g->nodes; v++)
+        dist[v] = GRAPH_INF;
+
+    dist[source] = 0;
+    pool[used] = (entry_t){0, source};
+    pq_insert(pq, &pool[used++]);
+
+    while (!pq_is_empty(pq)) {
+        const entry_t *top = pq_remove(pq);
+        uint32_t v = top->node;
+
+        if (top->dist > dist[v])
+            continue;
+
+        r->settled++;
+        for (size_t e = g->offsets[v]; e < g->offsets[v + 1]; e++) {
+            uint64_t nd = top->dist + g->weights[e];
+            uint32_t u = g->targets[e];
+
+            if (nd < dist[u]) {
+                dist[u] = nd;
+                pool[used] = (entry_t){nd, u};
+                pq_insert(pq, &pool[used++]);
+            }
+        }
+    }
+
+    r->pushes += used;
+    pq_destroy(pq, NULL);
+}
+
+static void run_sssp(const graph_t *g, const uint32_t *sources, size_t queries, result_t *lazy, result_t *heap,
+                     result_t *par) {
+    uint64_t *dist = malloc(g->nodes * sizeof(uint64_t));
+    uint32_t *parent = malloc(g->nodes * sizeof(uint32_t));
+    entry_t *pool = malloc((g->offsets[g->nodes] + 1) * sizeof(entry_t));
+    graph_search_t *gs = graph_search_create(g->nodes), *ps = graph_search_create(g->nodes);
+
+    for (size_t q = 0; q < queries; q++) {
+        double t0 = now_ns();
+        lazy_dijkstra(g, sources[q], dist, pool, lazy);
+        lazy->ns += now_ns() - t0;
+
+        t0 = now_ns();
+        graph_dijkstra(gs, g, sources[q]);
+        heap->ns += now_ns() - t0;
+        heap->settled += graph_settled(gs);
+        heap->pushes += graph_settled(gs);
+
+        for (uint32_t v = 0; v < g->nodes; v++) {
+            if (dist[v] != graph_dist(gs, v)) {
+                fprintf(stderr, "graph: distance mismatch at node %u from %u\n", v, sources[q]);
+                exit(1);
+            }
+            if (dist[v] != GRAPH_INF)
+                lazy->checksum += dist[v], heap->checksum += dist[v];
+            parent[v] = graph_parent(gs, v);
+        }
+
+        t0 = now_ns();
+        graph_delta_stepping(ps, g, sources[q], delta, threads);
+        par->ns += now_ns() - t0;
+        par->settled += graph_settled(ps);
+        par->pushes += graph_settled(ps);
+
+        for (uint32_t v = 0; v < g->nodes; v++) {
+            if (dist[v] != graph_dist(ps, v) || parent[v] != graph_parent(ps, v)) {
+                fprintf(stderr, "graph: delta stepping mismatch at node %u from %u\n", v, sources[q]);
+                exit(1);
+            }
+            if (dist[v] != GRAPH_INF)
+                par->checksum += dist[v];
+        }
+    }
+
+    graph_search_destroy(ps);
+    graph_search_destroy(gs);
+    free(pool);
+    free(parent);
+    free(dist);
+}
+
+static void run_p2p(const graph_t *g, const uint32_t *pairs, size_t queries, result_t *plain, result_t *astar) {
+    graph_search_t *gs = graph_search_create(g->nodes);
+
+    for (size_t q = 0; q < queries; q++) {
+        uint32_t s = pairs[2 * q], t = pairs[2 * q + 1];
+
+        double t0 = now_ns();
+        graph_astar(gs, g, s, t, NULL, NULL);
+        plain->ns += now_ns() - t0;
+        plain->settled += graph_settled(gs);
+
+        uint64_t d = graph_dist(gs, t);
+
+        t0 = now_ns();
+        graph_astar(gs, g, s, t, manhattan, &t);
+        astar->ns += now_ns() - t0;
+        astar->settled += graph_settled(gs);
+
+        if (d != graph_dist(gs, t)) {
+            fprintf(stderr, "graph: A* distance mismatch from %u to %u\n", s, t);
+            exit(1);
+        }
+        if (d != GRAPH_INF)
+            plain->checksum += d, astar->checksum += d;
+    }
+
+    graph_search_destroy(gs);
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [-q sssp_queries] [-p p2p_queries] [-d delta] [-t threads] [-o out.json] SIDE...\n"
+            "Runs on SIDE x SIDE grids, e.g. 3163 for 10M nodes. Delta stepping uses the\n"
+            "mean edge weight and one thread per CPU unless told otherwise\n", prog);
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    const char *out_path = NULL;
+    size_t sides[64], n_sides = 0, sssp = 3, p2p = 20;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-o") && i + 1 < argc)
+            out_path = argv[++i];
+        else if (!strcmp(argv[i], "-q") && i + 1 < argc)
+            sssp = strtoul(argv[++i], NULL, 10);
+        else if (!strcmp(argv[i], "-p") && i + 1 < argc)
+            p2p = strtoul(argv[++i], NULL, 10);
+        else if (!strcmp(argv[i], "-d") && i + 1 < argc)
+            delta = strtoull(argv[++i], NULL, 10);
+        else if (!strcmp(argv[i], "-t") && i + 1 < argc)
+            threads = strtoul(argv[++i], NULL, 10);
+        else if (argv[i][0] == '-' || n_sides == 64)
+            usage(argv[0]);
+        else
+            sides[n_sides++] = (size_t)strtod(argv[i], NULL);
+    }
+    if (!n_sides)
+        usage(argv[0]);
+
+    FILE *out = out_path ? fopen(out_path, "w") : NULL;
+    if (out_path && !out) {
+        perror(out_path);
+        return 1;
+    }
+    if (out)
+        fprintf(out, "{\n  \"results\": [\n");
+
+    printf("%-16s %10s %10s %12s %14s %14s\n", "run", "nodes", "queries", "ms/query", "settled/query", "pushes/query");
+
+    for (size_t s = 0; s < n_sides; s++) {
+        grid_side = (uint32_t)sides[s];
+        graph_t g = grid_create(grid_side);
+
+        uint32_t *sources = malloc(sssp * sizeof(uint32_t)), *pairs = malloc(2 * p2p * sizeof(uint32_t));
+        for (size_t q = 0; q < sssp; q++)
+            sources[q] = rng() % g.nodes;
+        for (size_t q = 0; q < 2 * p2p; q++)
+            pairs[q] = rng() % g.nodes;
+
+        result_t res[5] = {{"pq-lazy", sssp}, {"graph-dijkstra", sssp}, {"graph-delta", sssp},
+                           {"graph-p2p", p2p}, {"graph-astar", p2p}};
+        run_sssp(&g, sources, sssp, &res[0], &res[1], &res[2]);
+        run_p2p(&g, pairs, p2p, &res[3], &res[4]);
+
+        for (int r = 0; r < 5; r++) {
+            double q = res[r].queries ? (double)res[r].queries : 1;
+
+            printf("%-16s %10u %10zu %12.2f %14.0f %14.0f\n", res[r].name, g.nodes, res[r].queries,
+                   res[r].ns / q / 1e6, res[r].settled / q, res[r].pushes / q);
+            if (out)
+                fprintf(out, "%s    {\"run\": \"%s\", \"nodes\": %u, \"queries\": %zu, \"ms_per_query\": %.3f, "
+                        "\"settled_per_query\": %.0f, \"pushes_per_query\": %.0f, \"checksum\": %llu}",
+                        s || r ? ",\n" : "", res[r].name, g.nodes, res[r].queries, res[r].ns / q / 1e6,
+                        res[r].settled / q, res[r].pushes / q, (unsigned long long)res[r].checksum);
+        }
+
+        free(sources);
+        free(pairs);
+        grid_free(&g);
+    }
+
+    if (out) {
+        fprintf(out, "\n  ]\n}\n");
+        fclose(out);
+    }
+
+    return 0;
+}
@@ -0,0 +1,295 @@
+#include "pq.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Per-operation latency harness. Every pq_insert/pq_remove/pq_peek is timed
+ * individually and recorded into an HDR-style log-linear histogram (128
+ * sub-buckets per power of two, < 1% relative error), so tail latency from
+ * deep sifts and malloc in pq_insert shows up instead of being averaged away.
+ * Optional background threads walk a large buffer to thrash the shared caches.
+ */
+
+#define SUB_BITS 7
+#define SUB (1 << SUB_BITS)
+#define BUCKETS ((64 - SUB_BITS + 1) * SUB)
+
+enum { OP_INSERT, OP_REMOVE, OP_PEEK, OP_COUNT };
+
+static const char *const OP_NAMES[OP_COUNT] = {"insert", "remove", "peek"};
+
+typedef struct {
+    uint64_t            counts[BUCKETS];
+    uint64_t            total;
+    uint64_t            max;
+} hist_t;
+
+typedef struct {
+    uint64_t            key;
+} elem_t;
+
+typedef struct {
+    const char          *name;
+    void                (*run)(size_t n, hist_t *h);
+} workload_t;
+
+static uint64_t rng_state = 0x853c49e6748fea9bULL;
+static volatile int thrash_stop;
+/* Peeks store their result here, or the inlined pq_peek() load is optimized away. */
+static const void *volatile peek_sink;
+static size_t thrash_bytes = 64UL << 20;
+
+static uint64_t rng(void) {
+    uint64_t z = (rng_state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static int elem_cmp(const void *a, const void *b) {
+    uint64_t ka = ((const elem_t *)a)->key, kb = ((const elem_t *)b)->key;
+    return (ka > kb) - (ka < kb);
+}
+
+static inline uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static size_t hist_index(uint64_t v) {
+    if (v < SUB)
+        return v;
+
+    int shift = 63 - __builtin_clzll(v) - SUB_BITS;
+    return ((size_t)(shift + 1) << SUB_BITS) + ((v >> shift) & (SUB - 1));
+}
+
+/* Highest value that falls in the same bucket as index i. */
+static uint64_t hist_value(size_t i) {
+    if (i < SUB)
+        return i;
+
+    int shift = (int)(i >> SUB_BITS) - 1;
+    return (((uint64_t)SUB + (i & (SUB - 1)) + 1) << shift) - 1;
+}
+
+static inline void hist_record(hist_t *h, uint64_t v) {
+    h->counts[hist_index(v)]++;
+    h->total++;
+    if (v > h->max)
+        h->max = v;
+}
+
+static uint64_t hist_percentile(const hist_t *h, double p) {
+    uint64_t rank = (uint64_t)(p / 100.0 * h->total + 0.5), seen = 0;
+
+    if (!rank)
+        rank = 1;
+    for (size_t i = 0; i < BUCKETS; i++)
+        if ((seen += h->counts[i]) >= rank)
+            return hist_value(i) < h->max ? hist_value(i) : h->max;
+
+    return h->max;
+}
+
+#define TIMED(h, op, expr) do { \
+        uint64_t _t0 = now_ns(); \
+        expr; \
+        hist_record(&(h)[op], now_ns() - _t0); \
+    } while (0)
+
+static elem_t *fill(pq_t *pq, size_t n, size_t cap) {
+    elem_t *e = calloc(cap, sizeof(elem_t));
+    for (size_t i = 0; i < n; i++) {
+        e[i].key = rng();
+        pq_insert(pq, &e[i]);
+    }
+    return e;
+}
+
+/* Steady state: peek, pop the minimum and reinsert it with a later key. */
+static void run_hold(size_t n, hist_t *h) {
+    pq_t *pq = pq_create(n, elem_cmp);
+    elem_t *e = fill(pq, n, n);
+
+    for (size_t i = 0; i < 4 * n; i++) {
+        elem_t *top;
+        TIMED(h, OP_PEEK, peek_sink = pq_peek(pq));
+        TIMED(h, OP_REMOVE, top = (elem_t *)pq_remove(pq));
+        top->key += rng() >> 8;
+        TIMED(h, OP_INSERT, pq_insert(pq, top));
+    }
+
+    pq_destroy(pq, NULL);
+    free(e);
+}
+
+/* Bursts of n / 2 insertions followed by draining them again. */
+static void run_burst(size_t n, hist_t *h) {
+    size_t burst = n / 2 ? n / 2 : 1;
+    pq_t *pq = pq_create(n + burst, elem_cmp);
+    elem_t *e = fill(pq, n / 2, n + burst);
+
+    for (int round = 0; round < 8; round++) {
+        for (size_t i = 0; i < burst; i++) {
+            elem_t *x = &e[n / 2 + i];
+            x->key = rng();
+            TIMED(h, OP_INSERT, pq_insert(pq, x));
+        }
+        for (size_t i = 0; i < burst; i++)
+            TIMED(h, OP_REMOVE, pq_remove(pq));
+        TIMED(h, OP_PEEK, peek_sink = pq_peek(pq));
+    }
+
+    pq_destroy(pq, NULL);
+    free(e);
+}
+
+/* Random walk between n / 2 and n elements with equal insert/remove odds. */
+static void run_churn(size_t n, hist_t *h) {
+    pq_t *pq = pq_create(n, elem_cmp);
+    elem_t *e = fill(pq, n - n / 4, n);
+    elem_t **free_list = malloc(n * sizeof(elem_t *));
+    size_t n_free = 0;
+
+    for (size_t i = n - n / 4; i < n; i++)
+        free_list[n_free++] = &e[i];
+
+    for (size_t i = 0; i < 8 * n; i++) {
+        size_t len = pq_len(pq);
+        if ((rng() & 1 && len < n) || len <= n / 2) {
+            elem_t *x = free_list[--n_free];
+            x->key = rng();
+            TIMED(h, OP_INSERT, pq_insert(pq, x));
+        } else {
+            const void *x;
+            TIMED(h, OP_REMOVE, x = pq_remove(pq));
+            free_list[n_free++] = (elem_t *)x;
+        }
+        if (!(i & 7))
+            TIMED(h, OP_PEEK, peek_sink = pq_peek(pq));
+    }
+
+    pq_destroy(pq, NULL);
+    free(free_list);
+    free(e);
+}
+
+static const workload_t WORKLOADS[] = {
+    {"hold", run_hold},
+    {"burst", run_burst},
+    {"churn", run_churn},
+};
+
+static void *thrash(void *arg) {
+    uint64_t *buf = malloc(thrash_bytes), x = (uintptr_t)arg | 1;
+    size_t words = thrash_bytes / sizeof(uint64_t);
+
+    memset(buf, 0, thrash_bytes);
+    while (!thrash_stop) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        buf[x % words] += x;
+    }
+
+    free(buf);
+    return NULL;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [-t thrash_threads] [-m thrash_mb] [-o out.json] SIZE...\n"
+            "Sizes accept scientific notation, e.g. 1e6\n", prog);
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    const char *out_path = NULL;
+    size_t sizes[64], n_sizes = 0;
+    int n_thrash = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-o") && i + 1 < argc)
+            out_path = argv[++i];
+        else if (!strcmp(argv[i], "-t") && i + 1 < argc)
+            n_thrash = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-m") && i + 1 < argc)
+            thrash_bytes = (size_t)atol(argv[++i]) << 20;
+        else if (argv[i][0] == '-' || n_sizes == 64)
+            usage(argv[0]);
+        else
+            sizes[n_sizes++] = (size_t)strtod(argv[i], NULL);
+    }
+    if (!n_sizes || n_thrash < 0 || !thrash_bytes)
+        usage(argv[0]);
+
+    FILE *out = out_path ? fopen(out_path, "w") : NULL;
+    if (out_path && !out) {
+        perror(out_path);
+        return 1;
+    }
+
+    pthread_t *threads = calloc(n_thrash ? n_thrash : 1, sizeof(pthread_t));
+    for (int t = 0; t < n_thrash; t++)
+        pthread_create(&threads[t], NULL, thrash, (void *)(uintptr_t)(t + 1));
+
+    uint64_t overhead = UINT64_MAX;
+    for (int i = 0; i < 1000; i++) {
+        uint64_t t0 = now_ns(), d = now_ns() - t0;
+        overhead = d < overhead ? d : overhead;
+    }
+
+    printf("timer overhead: %llu ns, thrashing threads: %d x %zu MB\n",
+           (unsigned long long)overhead, n_thrash, thrash_bytes >> 20);
+    printf("%-6s %-7s %12s %12s %8s %8s %8s %10s\n", "work", "op", "n", "count", "p50", "p99", "p99.9", "max");
+    if (out)
+        fprintf(out, "{\n  \"cc\": \"%s\",\n  \"thrash_threads\": %d,\n  \"timer_overhead_ns\": %llu,\n  \"results\": [\n",
+                __VERSION__, n_thrash, (unsigned long long)overhead);
+
+    hist_t *h = malloc(OP_COUNT * sizeof(hist_t));
+    int first = 1;
+    for (size_t w = 0; w < sizeof(WORKLOADS) / sizeof(*WORKLOADS); w++)
+        for (size_t s = 0; s < n_sizes; s++) {
+            size_t n = sizes[s] > 4 ? sizes[s] : 4;
+
+            memset(h, 0, OP_COUNT * sizeof(hist_t));
+            WORKLOADS[w].run(n, h);
+
+            for (int op = 0; op < OP_COUNT; op++) {
+                uint64_t p50 = hist_percentile(&h[op], 50), p99 = hist_percentile(&h[op], 99);
+                uint64_t p999 = hist_percentile(&h[op], 99.9);
+
+                printf("%-6s %-7s %12zu %12llu %8llu %8llu %8llu %10llu\n", WORKLOADS[w].name, OP_NAMES[op], n,
+                       (unsigned long long)h[op].total, (unsigned long long)p50, (unsigned long long)p99,
+                       (unsigned long long)p999, (unsigned long long)h[op].max);
+
+                if (out)
+                    fprintf(out, "%s    {\"workload\": \"%s\", \"op\": \"%s\", \"n\": %zu, \"count\": %llu, "
+                            "\"p50_ns\": %llu, \"p99_ns\": %llu, \"p999_ns\": %llu, \"max_ns\": %llu}",
+                            first ? "" : ",\n", WORKLOADS[w].name, OP_NAMES[op], n,
+                            (unsigned long long)h[op].total, (unsigned long long)p50, (unsigned long long)p99,
+                            (unsigned long long)p999, (unsigned long long)h[op].max);
+                first = 0;
+            }
+            fflush(stdout);
+        }
+
+    thrash_stop = 1;
+    for (int t = 0; t < n_thrash; t++)
+        pthread_join(threads[t], NULL);
+
+    if (out) {
+        fprintf(out, "\n  ]\n}\n");
+        fclose(out);
+    }
+
+    free(threads);
+    free(h);
+    return 0;
+}
@@ -0,0 +1,181 @@
+#include "median.h"
+#include "pq.h"
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Rolling median benchmark over log-normal "request latencies". Compares the usual
+ * pair of pq_t heaps holding malloc'd samples (unbounded only: a pq_t cannot drop
+ * the oldest sample) against median_add() and median_add_n() in batches of BATCH,
+ * reading the median after every sample or batch. Windowed runs keep the last
+ * WINDOW samples.
+ */
+
+#define BATCH 1024
+#define WINDOW 10000
+
+typedef struct {
+    const char          *name;
+    size_t              window;
+    double              ns;
+    double              checksum;
+} result_t;
+
+static uint64_t rng_state = 0x2545f4914f6cdd1dULL;
+
+static uint64_t rng(void) {
+    uint64_t z = (rng_state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static double uniform(void) {
+    return ((rng() >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+}
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int min_cmp(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static int max_cmp(const void *a, const void *b) {
+    return min_cmp(b, a);
+}
+
+static void run_pq(const double *xs, size_t n, result_t *r) {
+    pq_t *low = pq_create_ex(n, max_cmp, PQ_GROW), *high = pq_create_ex(n, min_cmp, PQ_GROW);
+
+    double t0 = now_ns();
+    for (size_t i = 0; i < n; i++) {
+        double *x = malloc(sizeof(double));
+        *x = xs[i];
+
+        if (pq_is_empty(low) || *x <= *(const double *)pq_peek(low))
+            pq_insert(low, x);
+        else
+            pq_insert(high, x);
+
+        if (pq_len(low) > pq_len(high) + 1)
+            pq_insert(high, (void *)pq_remove(low));
+        else if (pq_len(high) > pq_len(low))
+            pq_insert(low, (void *)pq_remove(high));
+
+        double m = *(const double *)pq_peek(low);
+        if (pq_len(low) == pq_len(high))
+            m = (m + *(const double *)pq_peek(high)) / 2;
+        r->checksum += m;
+    }
+    r->ns += now_ns() - t0;
+
+    pq_destroy(low, free);
+    pq_destroy(high, free);
+}
+
+static void run_add(const double *xs, size_t n, result_t *r) {
+    median_t *m = median_create(r->window);
+
+    double t0 = now_ns();
+    for (size_t i = 0; i < n; i++) {
+        median_add(m, xs[i]);
+        r->checksum += median_get(m);
+    }
+    r->ns += now_ns() - t0;
+
+    median_destroy(m);
+}
+
+static void run_add_n(const double *xs, size_t n, result_t *r) {
+    median_t *m = median_create(r->window);
+
+    double t0 = now_ns();
+    for (size_t i = 0; i < n; i += BATCH) {
+        median_add_n(m, xs + i, n - i < BATCH ? n - i : BATCH);
+        r->checksum += median_get(m);
+    }
+    r->ns += now_ns() - t0;
+
+    median_destroy(m);
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-o out.json] SIZE...\n", prog);
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    const char *out_path = NULL;
+    size_t sizes[64], n_sizes = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-o") && i + 1 < argc)
+            out_path = argv[++i];
+        else if (argv[i][0] == '-' || n_sizes == 64)
+            usage(argv[0]);
+        else
+            sizes[n_sizes++] = (size_t)strtod(argv[i], NULL);
+    }
+    if (!n_sizes)
+        usage(argv[0]);
+
+    FILE *out = out_path ? fopen(out_path, "w") : NULL;
+    if (out_path && !out) {
+        perror(out_path);
+        return 1;
+    }
+    if (out)
+        fprintf(out, "{\n  \"results\": [\n");
+
+    printf("%-16s %10s %10s %12s\n", "run", "samples", "window", "ns/sample");
+
+    for (size_t s = 0; s < n_sizes; s++) {
+        size_t n = sizes[s];
+        double *xs = malloc((n ? n : 1) * sizeof(double));
+
+        /* Log-normal around 1 ms, from two uniforms (Box-Muller). */
+        for (size_t i = 0; i < n; i++)
+            xs[i] = exp(0.5 * sqrt(-2 * log(uniform())) * cos(6.283185307179586 * uniform()));
+
+        result_t res[5] = {{"pq-pair"}, {"median-add"}, {"median-add-n"},
+                           {"median-add", WINDOW}, {"median-add-n", WINDOW}};
+        run_pq(xs, n, &res[0]);
+        run_add(xs, n, &res[1]);
+        run_add_n(xs, n, &res[2]);
+        run_add(xs, n, &res[3]);
+        run_add_n(xs, n, &res[4]);
+
+        /* (a + b) / 2 and a + (b - a) / 2 may round apart. */
+        if (fabs(res[1].checksum - res[0].checksum) > 1e-9 * fabs(res[0].checksum)) {
+            fprintf(stderr, "median: medians differ over %zu samples\n", n);
+            return 1;
+        }
+
+        for (int r = 0; r < 5; r++) {
+            double q = n ? (double)n : 1;
+
+            printf("%-16s %10zu %10zu %12.1f\n", res[r].name, n, res[r].window, res[r].ns / q);
+            if (out)
+                fprintf(out, "%s    {\"run\": \"%s\", \"samples\": %zu, \"window\": %zu, \"ns_per_sample\": %.2f}",
+                        s || r ? ",\n" : "", res[r].name, n, res[r].window, res[r].ns / q);
+        }
+
+        free(xs);
+    }
+
+    if (out) {
+        fprintf(out, "\n  ]\n}\n");
+        fclose(out);
+    }
+
+    return 0;
+}
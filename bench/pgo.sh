@@ -0,0 +1,73 @@
+#!/bin/bash
+
+# Profile-guided build of the library, driven by the bench workloads.
+#
+# 1. Builds the library objects instrumented and links them into the bench.
+# 2. Trains on TRAIN_SIZES (all workloads).
+# 3. Rebuilds the objects with the profile into bin/pgo/libguilib.so and a bench.
+# 4. Runs the plain -O3 bench and the PGO bench on SIZES and compares them.
+#
+# Environment: CC (gcc or clang), CFLAGS, SIZES, TRAIN_SIZES.
+
+set -e
+
+CC=${CC:-gcc}
+CFLAGS=${CFLAGS:--O3 -Wall -fPIC -I./include}
+SIZES=${SIZES:-1e3 1e4 1e5 1e6}
+TRAIN_SIZES=${TRAIN_SIZES:-1e3 1e4 1e5}
+OUT=bin/pgo
+PROF=$PWD/$OUT/profile
+SRC=$(ls src/*.c)
+
+run() {
+    echo "+ $*"
+    "$@"
+}
+
+if $CC --version 2>/dev/null | grep -q clang; then
+    GEN_FLAGS="-fprofile-instr-generate=$PROF/%p.profraw"
+    USE_FLAGS="-fprofile-instr-use=$PROF/default.profdata"
+    merge() { run llvm-profdata merge -output="$PROF/default.profdata" "$PROF"/*.profraw; }
+else
+    GEN_FLAGS="-fprofile-generate=$PROF -fprofile-update=single"
+    USE_FLAGS="-fprofile-use=$PROF -fprofile-correction -Wno-missing-profile"
+    merge() { :; }
+fi
+
+# Objects keep the same path in every phase so that gcc finds their profiles.
+objects() {
+    local objs=""
+    for f in $SRC; do
+        local o=$OUT/obj/$(basename "${f%.c}").o
+        run $CC $CFLAGS $1 -c -o "$o" "$f"
+        objs="$objs $o"
+    done
+    OBJS=$objs
+}
+
+bench() {
+    run $CC $(echo $CFLAGS | sed 's/-fPIC//') -DBENCH_CFLAGS="\"$CFLAGS $2\"" -o "$1" bench/bench.c $OBJS $2
+}
+
+rm -rf "$OUT"
+mkdir -p "$OUT/obj" "$PROF"
+
+objects ""
+bench $OUT/bench-plain ""
+
+objects "$GEN_FLAGS"
+bench $OUT/bench-train "$GEN_FLAGS"
+run $OUT/bench-train $TRAIN_SIZES > /dev/null
+merge
+
+objects "$USE_FLAGS"
+run $CC $CFLAGS -shared -o $OUT/libguilib.so $OBJS
+bench $OUT/bench-pgo ""
+
+run $OUT/bench-plain -o $OUT/plain.json $SIZES > /dev/null
+run $OUT/bench-pgo -o $OUT/pgo.json $SIZES > /dev/null
+
+echo
+echo "PGO speedup over plain $(echo $CFLAGS | grep -o -- '-O[0-9s]*') ($CC):"
+bench/compare.sh $OUT/plain.json $OUT/pgo.json | tee $OUT/compare.txt
+awk '$1 == "geomean" { printf "speedup: %.3fx\n", 1 / $2 }' $OUT/compare.txt
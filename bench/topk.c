@@ -0,0 +1,197 @@
+#include "topk.h"
+#include "pq.h"
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Sliding-window top-k benchmark: log-normal latencies of random endpoints arrive
+ * one per microsecond (1M events/s), and a dashboard reads the top K every SNAPSHOT
+ * events. Compares topk_t against a pq_t max-heap of every malloc'd event in the
+ * window, which drops expired events when they surface and reads the top by popping
+ * K live events and pushing them back. Event times exclude the snapshots, and the
+ * items held are sampled at each snapshot.
+ */
+
+#define K 100
+#define SNAPSHOT 1000
+#define ENDPOINTS 10000
+
+typedef struct {
+    double              score;
+    uint64_t            time;
+    uint64_t            id;
+} event_t;
+
+typedef struct {
+    const char          *name;
+    double              ns;
+    double              snapshot_ns;
+    size_t              peak;
+    double              checksum;
+} result_t;
+
+static uint64_t rng_state = 0x2545f4914f6cdd1dULL;
+static uint64_t window = 1000000;
+
+static uint64_t rng(void) {
+    uint64_t z = (rng_state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static double uniform(void) {
+    return ((rng() >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+}
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* Best first: higher score, then more recent. */
+static int event_cmp(const void *a, const void *b) {
+    const event_t *x = a, *y = b;
+
+    if (x->score != y->score)
+        return x->score > y->score ? -1 : 1;
+    return (x->time < y->time) - (x->time > y->time);
+}
+
+static void run_pq(const event_t *events, size_t n, result_t *r) {
+    pq_t *pq = pq_create_ex(1024, event_cmp, PQ_GROW);
+    event_t *top[K];
+
+    double start = now_ns();
+    for (size_t i = 0; i < n; i++) {
+        event_t *e = malloc(sizeof(event_t));
+        *e = events[i];
+        pq_insert(pq, e);
+
+        if ((i + 1) % SNAPSHOT)
+            continue;
+
+        r->peak = pq_len(pq) > r->peak ? pq_len(pq) : r->peak;
+        double t0 = now_ns();
+        size_t got = 0;
+        while (got < K && !pq_is_empty(pq)) {
+            event_t *best = (event_t *)pq_remove(pq);
+
+            if (e->time - best->time < window)
+                top[got++] = best;
+            else
+                free(best);
+        }
+        for (size_t j = 0; j < got; j++) {
+            r->checksum += top[j]->score;
+            pq_insert(pq, top[j]);
+        }
+        r->snapshot_ns += now_ns() - t0;
+    }
+    r->ns = now_ns() - start - r->snapshot_ns;
+
+    pq_destroy(pq, free);
+}
+
+static void run_topk(const event_t *events, size_t n, result_t *r) {
+    topk_t *tk = topk_create(K, window);
+    topk_item_t top[K];
+
+    double start = now_ns();
+    for (size_t i = 0; i < n; i++) {
+        topk_add(tk, events[i].time, events[i].score, events[i].id);
+
+        if ((i + 1) % SNAPSHOT)
+            continue;
+
+        r->peak = topk_held(tk) > r->peak ? topk_held(tk) : r->peak;
+        double t0 = now_ns();
+        size_t got = topk_snapshot(tk, top, K);
+        for (size_t j = 0; j < got; j++)
+            r->checksum += top[j].score;
+        r->snapshot_ns += now_ns() - t0;
+    }
+    r->ns = now_ns() - start - r->snapshot_ns;
+
+    topk_destroy(tk);
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [-w window_us] [-o out.json] SIZE...\n"
+            "Streams SIZE events at 1M/s over a window of 1s unless told otherwise\n", prog);
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    const char *out_path = NULL;
+    size_t sizes[64], n_sizes = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-o") && i + 1 < argc)
+            out_path = argv[++i];
+        else if (!strcmp(argv[i], "-w") && i + 1 < argc)
+            window = strtoull(argv[++i], NULL, 10);
+        else if (argv[i][0] == '-' || n_sizes == 64)
+            usage(argv[0]);
+        else
+            sizes[n_sizes++] = (size_t)strtod(argv[i], NULL);
+    }
+    if (!n_sizes || !window)
+        usage(argv[0]);
+
+    FILE *out = out_path ? fopen(out_path, "w") : NULL;
+    if (out_path && !out) {
+        perror(out_path);
+        return 1;
+    }
+    if (out)
+        fprintf(out, "{\n  \"window_us\": %llu,\n  \"results\": [\n", (unsigned long long)window);
+
+    printf("%-10s %10s %12s %14s %10s\n", "run", "events", "ns/event", "us/snapshot", "peak held");
+
+    for (size_t s = 0; s < n_sizes; s++) {
+        size_t n = sizes[s];
+        event_t *events = malloc((n ? n : 1) * sizeof(event_t));
+
+        for (size_t i = 0; i < n; i++) {
+            double z = sqrt(-2 * log(uniform())) * cos(6.283185307179586 * uniform());
+            events[i] = (event_t){exp(0.5 * z), i, rng() % ENDPOINTS};
+        }
+
+        result_t res[2] = {{"pq-all"}, {"topk"}};
+        run_pq(events, n, &res[0]);
+        run_topk(events, n, &res[1]);
+
+        if (res[0].checksum != res[1].checksum) {
+            fprintf(stderr, "topk: snapshots differ over %zu events\n", n);
+            return 1;
+        }
+
+        for (int r = 0; r < 2; r++) {
+            double q = n ? (double)n : 1, snaps = n / SNAPSHOT ? (double)(n / SNAPSHOT) : 1;
+
+            printf("%-10s %10zu %12.1f %14.2f %10zu\n", res[r].name, n, res[r].ns / q,
+                   res[r].snapshot_ns / snaps / 1e3, res[r].peak);
+            if (out)
+                fprintf(out, "%s    {\"run\": \"%s\", \"events\": %zu, \"ns_per_event\": %.2f, "
+                        "\"us_per_snapshot\": %.3f, \"peak_held\": %zu}",
+                        s || r ? ",\n" : "", res[r].name, n, res[r].ns / q, res[r].snapshot_ns / snaps / 1e3,
+                        res[r].peak);
+        }
+
+        free(events);
+    }
+
+    if (out) {
+        fprintf(out, "\n  ]\n}\n");
+        fclose(out);
+    }
+
+    return 0;
+}
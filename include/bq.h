@@ -0,0 +1,142 @@
+#ifndef BQ_H
+#define BQ_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @file bq.h
+ * @brief Bucket Queue Implementation
+ *
+ * This header file declares the interface for a bucket queue (bq_t), a priority
+ * queue for small integer priorities (e.g. 0-255 QoS classes). Every priority has
+ * its own FIFO list, and a two-level bitmap of non-empty lists is searched with
+ * find-first-set, so insertion and removal take constant time and elements of
+ * equal priority leave in insertion order.
+ *
+ * Lists are intrusive: elements embed a `bq_node_t` and the queue never allocates
+ * per element. `BQ_ENTRY()` recovers the element from its node.
+ */
+
+/**
+ * @brief Largest number of priorities a bucket queue can have.
+ */
+#define BQ_MAX_PRIOS 4096
+
+/**
+ * @struct bq_node_t
+ * @brief Link embedded in the elements of a bucket queue.
+ *
+ * @note A node can only be queued once at a time.
+ */
+typedef struct bq_node {
+    struct bq_node      *next;
+} bq_node_t;
+
+/**
+ * @brief Returns a pointer to the `type` holding the node `ptr` as its `member`.
+ */
+#define BQ_ENTRY(ptr, type, member) ((type *)((char *)(ptr) - offsetof(type, member)))
+
+/**
+ * @struct bq_t
+ * @brief A structure representing a bucket queue.
+ *
+ * @note Users should not modify the structure directly. All interactions should
+ *       be done via the provided functions.
+ */
+typedef struct _bq_t bq_t;
+
+/**
+ * @brief Creates a new bucket queue.
+ *
+ * @param prios The number of priorities, between 1 and `BQ_MAX_PRIOS`. Elements take
+ *        priorities `0` (removed first) to `prios - 1`.
+ *
+ * @return A pointer to the created bucket queue.
+ *
+ * @note The queue needs to be freed using `bq_destroy()` when no longer needed.
+ */
+bq_t *bq_create(unsigned prios);
+
+/**
+ * @brief Destroys a bucket queue.
+ *
+ * @param bq A pointer to the bucket queue to be destroyed.
+ * @param free_func Called on the node of every element still queued, or NULL.
+ *
+ * @note Nodes are owned by the caller, the queue only frees its own memory.
+ */
+void bq_destroy(bq_t *bq, void (*free_func)(bq_node_t *));
+
+/**
+ * @brief Appends an element to the list of its priority.
+ *
+ * @param bq A pointer to the bucket queue.
+ * @param node The node embedded in the element.
+ * @param prio The priority of the element.
+ *
+ * @note If `prio` is out of range, this function will terminate the program by calling `abort()`.
+ */
+void bq_insert(bq_t *bq, bq_node_t *node, unsigned prio);
+
+/**
+ * @brief Checks if the bucket queue is empty.
+ *
+ * @param bq A pointer to the bucket queue.
+ *
+ * @return `1` if the queue is empty, `0` otherwise.
+ */
+char bq_is_empty(bq_t *bq);
+
+/**
+ * @brief Returns the oldest element of the smallest priority without removing it.
+ *
+ * @param bq A pointer to the bucket queue.
+ * @param prio If not NULL, receives the priority of the element.
+ *
+ * @return The node of the top element.
+ *
+ * @note If the queue is empty, this function will abort the program.
+ */
+bq_node_t *bq_peek(bq_t *bq, unsigned *prio);
+
+/**
+ * @brief Removes and returns the oldest element of the smallest priority.
+ *
+ * @param bq A pointer to the bucket queue.
+ * @param prio If not NULL, receives the priority of the element.
+ *
+ * @return The node of the removed element.
+ *
+ * @note If the queue is empty, this function will abort the program.
+ */
+bq_node_t *bq_remove(bq_t *bq, unsigned *prio);
+
+/**
+ * @brief Returns the number of elements in the bucket queue.
+ *
+ * @param bq A pointer to the bucket queue.
+ *
+ * @return The number of queued elements.
+ */
+size_t bq_len(bq_t *bq);
+
+/**
+ * @brief Returns the number of priorities of the bucket queue.
+ *
+ * @param bq A pointer to the bucket queue.
+ *
+ * @return The `prios` the queue was created with.
+ */
+unsigned bq_prios(bq_t *bq);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
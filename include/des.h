@@ -0,0 +1,174 @@
+#ifndef DES_H
+#define DES_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @file des.h
+ * @brief Discrete-Event Simulation Engine
+ *
+ * This header file declares an event list for discrete-event simulations (des_t).
+ * Events are a handler and its argument scheduled at an integer timestamp. They are
+ * dispatched in timestamp order, and events with equal timestamps in the order they
+ * were scheduled. `des_step()` takes every event of the next timestamp off the list
+ * at once and then runs them.
+ *
+ * Events live in a pool owned by the engine that grows by doubling and recycles the
+ * slots of dispatched and cancelled events, so scheduling does not call `malloc()`
+ * once the pool has reached the peak number of pending events. Scheduling returns a
+ * handle that cancels the event in O(log n) (O(1) with `DES_CALENDAR`). A handle
+ * goes stale when its event runs or is cancelled, and cancelling it again is a no-op.
+ *
+ * The default event list is an implicit 4-ary heap with the keys stored inline.
+ * `DES_CALENDAR` uses a calendar queue instead: a ring of sorted lists, each one a
+ * power of two time units wide, resized as the number of events changes. Its
+ * schedule and dispatch take O(1) expected time when timestamps are spread evenly,
+ * against O(log n) for the heap. It is faster with many pending events. It can be
+ * slower when timestamps are skewed.
+ */
+
+/**
+ * @brief Uses a calendar queue instead of a heap as the event list.
+ */
+#define DES_CALENDAR 1u
+
+/**
+ * @brief Timestamp returned by `des_next()` when no event is pending.
+ */
+#define DES_NEVER UINT64_MAX
+
+/**
+ * @brief A handle that never names an event.
+ */
+#define DES_NONE 0
+
+/**
+ * @struct des_t
+ * @brief A structure representing a discrete-event simulation.
+ *
+ * @note Users should not modify the structure directly. All interactions should
+ *       be done via the provided functions.
+ */
+typedef struct _des_t des_t;
+
+/**
+ * @brief Names a scheduled event, for `des_cancel()`.
+ */
+typedef uint64_t des_id_t;
+
+/**
+ * @brief Runs an event. `des_now()` is its timestamp.
+ *
+ * A handler may schedule and cancel events, but not call `des_step()` or `des_run()`.
+ */
+typedef void (*des_handler_t)(des_t *des, void *arg);
+
+/**
+ * @brief Creates a new simulation at time `0`.
+ *
+ * @param size The number of pending events the pool holds before it first grows.
+ * @param flags `0` or `DES_CALENDAR`.
+ *
+ * @return A pointer to the created simulation.
+ *
+ * @note If `flags` has unknown bits, this function will terminate the program by calling `abort()`.
+ * @note The simulation needs to be freed using `des_destroy()` when no longer needed.
+ */
+des_t *des_create(size_t size, unsigned flags);
+
+/**
+ * @brief Destroys a simulation and frees its associated memory.
+ *
+ * @param des A pointer to the simulation to be destroyed.
+ * @param free_func Called on the argument of every event still pending, or NULL.
+ */
+void des_destroy(des_t *des, void (*free_func)(void *));
+
+/**
+ * @brief Schedules an event.
+ *
+ * @param des A pointer to the simulation.
+ * @param time The timestamp of the event, not before `des_now()`.
+ * @param fn The handler of the event.
+ * @param arg Passed to the handler.
+ *
+ * @return The handle of the event.
+ *
+ * @note If `time` is in the past or `fn` is NULL, this function will terminate the program
+ *       by calling `abort()`.
+ */
+des_id_t des_schedule(des_t *des, uint64_t time, des_handler_t fn, void *arg);
+
+/**
+ * @brief Cancels a pending event.
+ *
+ * Events taken off the list by the running `des_step()` can still be cancelled until
+ * their handler runs.
+ *
+ * @param des A pointer to the simulation.
+ * @param id The handle returned by `des_schedule()`.
+ *
+ * @return `1` if the event was pending and will not run, `0` if the handle is stale.
+ */
+char des_cancel(des_t *des, des_id_t id);
+
+/**
+ * @brief Runs every event of the next timestamp, advancing the clock to it.
+ *
+ * Events the handlers schedule at the same timestamp run in the next call.
+ *
+ * @param des A pointer to the simulation.
+ *
+ * @return The number of events that ran, `0` if none was pending.
+ */
+size_t des_step(des_t *des);
+
+/**
+ * @brief Runs events until the next one is after a timestamp or none is pending.
+ *
+ * @param des A pointer to the simulation.
+ * @param until The last timestamp to run. `DES_NEVER` runs until no event is left.
+ *
+ * @return The number of events that ran.
+ *
+ * @note The clock stays at the timestamp of the last event that ran.
+ */
+size_t des_run(des_t *des, uint64_t until);
+
+/**
+ * @brief Returns the current time.
+ *
+ * @param des A pointer to the simulation.
+ *
+ * @return The timestamp of the last events dispatched, `0` before any.
+ */
+uint64_t des_now(des_t *des);
+
+/**
+ * @brief Returns the timestamp of the next event.
+ *
+ * @param des A pointer to the simulation.
+ *
+ * @return The timestamp of the earliest pending event, or `DES_NEVER` if none is pending.
+ */
+uint64_t des_next(des_t *des);
+
+/**
+ * @brief Returns the number of pending events.
+ *
+ * @param des A pointer to the simulation.
+ *
+ * @return The number of events scheduled and not yet run or cancelled.
+ */
+size_t des_len(des_t *des);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
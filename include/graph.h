@@ -0,0 +1,190 @@
+#ifndef GRAPH_H
+#define GRAPH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @file graph.h
+ * @brief Shortest Path Search
+ *
+ * This header file declares single-source shortest path searches (Dijkstra, A* and
+ * parallel delta stepping) over a directed graph in compressed sparse row (CSR) form
+ * with non-negative integer edge weights.
+ *
+ * The frontier is an indexed 4-ary heap that holds every node at most once and
+ * lowers its key in place when a shorter path is found, instead of queueing a
+ * duplicate and skipping stale entries. All buffers live in a `graph_search_t`
+ * sized for the graph and are reused by every query run with it; starting a query
+ * costs O(1), not O(nodes).
+ */
+
+/**
+ * @brief Distance of the nodes a search did not reach.
+ */
+#define GRAPH_INF UINT64_MAX
+
+/**
+ * @brief No node, the parent of the source and of unreached nodes.
+ */
+#define GRAPH_NONE UINT32_MAX
+
+/**
+ * @struct graph_t
+ * @brief A directed graph in compressed sparse row form.
+ *
+ * The edges leaving node `v` are `targets[i]`, with weight `weights[i]`, for `i` in
+ * `[offsets[v], offsets[v + 1])`. The arrays belong to the caller and are only read.
+ *
+ * - `nodes`: The number of nodes, below `GRAPH_NONE`.
+ * - `offsets`: `nodes + 1` ascending edge offsets, starting at `0`.
+ * - `targets`: The head node of every edge.
+ * - `weights`: The weight of every edge.
+ */
+typedef struct {
+    uint32_t            nodes;
+    const size_t        *offsets;
+    const uint32_t      *targets;
+    const uint32_t      *weights;
+} graph_t;
+
+/**
+ * @struct graph_search_t
+ * @brief Buffers and results of shortest path queries.
+ *
+ * @note Users should not modify the structure directly. All interactions should
+ *       be done via the provided functions.
+ */
+typedef struct _graph_search_t graph_search_t;
+
+/**
+ * @brief Creates the buffers for searching graphs of up to `nodes` nodes.
+ *
+ * @param nodes The largest number of nodes of the searched graphs.
+ *
+ * @return A pointer to the created search context.
+ *
+ * @note The context needs to be freed using `graph_search_destroy()` when no longer needed.
+ */
+graph_search_t *graph_search_create(uint32_t nodes);
+
+/**
+ * @brief Destroys a search context and frees its associated memory.
+ *
+ * @param gs A pointer to the search context to be destroyed.
+ */
+void graph_search_destroy(graph_search_t *gs);
+
+/**
+ * @brief Computes the shortest distances from a source to every node.
+ *
+ * @param gs A pointer to the search context. Its previous results are discarded.
+ * @param g A pointer to the graph.
+ * @param source The node the paths start at.
+ *
+ * @note If the graph has more nodes than the context was created for, or the source is
+ *       not a node of the graph, this function will terminate the program by calling `abort()`.
+ */
+void graph_dijkstra(graph_search_t *gs, const graph_t *g, uint32_t source);
+
+/**
+ * @brief Computes a shortest path from a source to a target with the A* algorithm.
+ *
+ * Nodes are expanded by distance plus `h`, which must never overestimate the remaining
+ * distance to the target and must be consistent (`h(u) <= w(u, v) + h(v)` on every
+ * edge). The search stops as soon as the target is settled. With `h` NULL it is
+ * Dijkstra's algorithm stopping at the target.
+ *
+ * @param gs A pointer to the search context. Its previous results are discarded.
+ * @param g A pointer to the graph.
+ * @param source The node the path starts at.
+ * @param target The node the path ends at.
+ * @param h The heuristic, a lower bound of the distance from a node to the target, or NULL.
+ * @param arg Passed to every call of `h`.
+ *
+ * @return `1` if the target was reached, `0` otherwise.
+ *
+ * @note Distances are only final for the nodes settled before the search stopped.
+ */
+char graph_astar(graph_search_t *gs, const graph_t *g, uint32_t source, uint32_t target,
+                 uint64_t (*h)(uint32_t node, void *arg), void *arg);
+
+/**
+ * @brief Computes the shortest distances from a source to every node on several threads.
+ *
+ * Delta stepping: nodes wait in buckets of distances `delta` wide, and all nodes of
+ * the lowest bucket are expanded at once, each thread relaxing the edges of the nodes
+ * it owns. Improvements to other threads' nodes go through per-thread request buffers
+ * that their owners apply after a barrier, so no locks are taken on the graph. Worker
+ * buffers are kept in the context and reused by later calls with as many threads.
+ *
+ * The distances are those of `graph_dijkstra()`. So are the parents when every weight
+ * is positive: both keep the smallest predecessor among equally short paths. With zero
+ * weights the parents may differ, but still trace shortest paths back to the source.
+ *
+ * @param gs A pointer to the search context. Its previous results are discarded.
+ * @param g A pointer to the graph.
+ * @param source The node the paths start at.
+ * @param delta The width of a bucket, or `0` for the mean edge weight.
+ * @param threads The number of threads, or `0` for one per online CPU. At most 256.
+ *
+ * @note Small `delta` expands fewer nodes more than once but takes more rounds, each
+ *       ending in a barrier. The search only pays off on large graphs.
+ * @note If the graph has more nodes than the context was created for, the source is not
+ *       a node of the graph, or a thread cannot be started, this function will terminate
+ *       the program by calling `abort()`.
+ */
+void graph_delta_stepping(graph_search_t *gs, const graph_t *g, uint32_t source, uint64_t delta, unsigned threads);
+
+/**
+ * @brief Returns the distance found to a node by the last query.
+ *
+ * @param gs A pointer to the search context.
+ * @param node The node.
+ *
+ * @return The length of the path found to `node`, or `GRAPH_INF` if it was not reached.
+ */
+uint64_t graph_dist(graph_search_t *gs, uint32_t node);
+
+/**
+ * @brief Returns the predecessor of a node on the path found by the last query.
+ *
+ * @param gs A pointer to the search context.
+ * @param node The node.
+ *
+ * @return The previous node on the path, or `GRAPH_NONE` for the source and unreached nodes.
+ */
+uint32_t graph_parent(graph_search_t *gs, uint32_t node);
+
+/**
+ * @brief Writes the path found by the last query to a node.
+ *
+ * @param gs A pointer to the search context.
+ * @param node The last node of the path.
+ * @param out Receives the nodes of the path, from the source to `node`, or NULL.
+ * @param cap The number of nodes `out` can hold.
+ *
+ * @return The number of nodes of the path, `0` if `node` was not reached. Only the first
+ *         `cap` of them are written.
+ */
+size_t graph_path(graph_search_t *gs, uint32_t node, uint32_t *out, size_t cap);
+
+/**
+ * @brief Returns the number of nodes the last query settled.
+ *
+ * @param gs A pointer to the search context.
+ *
+ * @return The number of nodes removed from the frontier by the last query. After
+ *         `graph_delta_stepping()`, nodes expanded more than once count every time.
+ */
+size_t graph_settled(graph_search_t *gs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
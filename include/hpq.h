@@ -0,0 +1,148 @@
+#ifndef HPQ_H
+#define HPQ_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @file hpq.h
+ * @brief Indexed Priority Queue Implementation
+ *
+ * This header file declares the interface for an indexed priority queue (hpq_t), a
+ * binary min-heap of user keys with 64-bit priorities that holds every key at most
+ * once. An open-addressing hash table maps each key to its heap position, so that
+ * `hpq_upsert()` can change the priority of a queued key in place and keys can be
+ * looked up or erased in O(1) plus one O(log n) sift.
+ *
+ * Keys are compared with the user's hash and equality functions. The queue stores
+ * key pointers, it does not copy the keys.
+ */
+
+/**
+ * @struct hpq_t
+ * @brief A structure representing an indexed priority queue.
+ *
+ * @note Users should not modify the structure directly. All interactions should
+ *       be done via the provided functions.
+ */
+typedef struct _hpq_t hpq_t;
+
+/**
+ * @brief Creates a new indexed priority queue.
+ *
+ * @param size The maximum number of distinct keys the queue can hold.
+ * @param hash Hashes a key. Equal keys must have equal hashes.
+ * @param equal Returns non-zero when two keys are equal.
+ *
+ * @return A pointer to the created queue.
+ *
+ * @note Neither function may be NULL.
+ * @note The queue needs to be freed using `hpq_destroy()` when no longer needed.
+ */
+hpq_t *hpq_create(size_t size, uint64_t (*hash)(const void *), int (*equal)(const void *, const void *));
+
+/**
+ * @brief Destroys an indexed priority queue and frees its associated memory.
+ *
+ * @param hpq A pointer to the queue to be destroyed.
+ * @param free_func Called on every key still queued, or NULL.
+ */
+void hpq_destroy(hpq_t *hpq, void (*free_func)(void *));
+
+/**
+ * @brief Inserts a key or updates the priority of a queued one.
+ *
+ * When an equal key is already queued its priority is replaced and it is sifted to
+ * its new place; the queue keeps the key pointer it was first given.
+ *
+ * @param hpq A pointer to the queue.
+ * @param key A pointer to the key.
+ * @param prio The priority of the key. Smaller priorities are removed first.
+ *
+ * @return `1` if the key was inserted, `0` if an equal key was updated.
+ *
+ * @note If a new key does not fit, this function will terminate the program by calling `abort()`.
+ */
+char hpq_upsert(hpq_t *hpq, void *key, uint64_t prio);
+
+/**
+ * @brief Looks a key up.
+ *
+ * @param hpq A pointer to the queue.
+ * @param key A pointer to the key.
+ * @param prio If not NULL and the key is queued, receives its priority.
+ *
+ * @return `1` if an equal key is queued, `0` otherwise.
+ */
+char hpq_contains(hpq_t *hpq, const void *key, uint64_t *prio);
+
+/**
+ * @brief Removes a key wherever it is in the queue.
+ *
+ * @param hpq A pointer to the queue.
+ * @param key A pointer to the key.
+ *
+ * @return The queued key pointer that was removed, or NULL if no equal key was queued.
+ */
+void *hpq_erase(hpq_t *hpq, const void *key);
+
+/**
+ * @brief Checks if the queue is empty.
+ *
+ * @param hpq A pointer to the queue.
+ *
+ * @return `1` if the queue is empty, `0` otherwise.
+ */
+char hpq_is_empty(hpq_t *hpq);
+
+/**
+ * @brief Returns the key with the smallest priority without removing it.
+ *
+ * @param hpq A pointer to the queue.
+ * @param prio If not NULL, receives the priority of the key.
+ *
+ * @return A pointer to the top key.
+ *
+ * @note If the queue is empty, this function will abort the program.
+ */
+void *hpq_peek(hpq_t *hpq, uint64_t *prio);
+
+/**
+ * @brief Removes and returns the key with the smallest priority.
+ *
+ * @param hpq A pointer to the queue.
+ * @param prio If not NULL, receives the priority of the key.
+ *
+ * @return A pointer to the removed key.
+ *
+ * @note If the queue is empty, this function will abort the program.
+ */
+void *hpq_remove(hpq_t *hpq, uint64_t *prio);
+
+/**
+ * @brief Returns the number of keys in the queue.
+ *
+ * @param hpq A pointer to the queue.
+ *
+ * @return The number of keys in the queue.
+ */
+size_t hpq_len(hpq_t *hpq);
+
+/**
+ * @brief Returns the maximum size of the queue.
+ *
+ * @param hpq A pointer to the queue.
+ *
+ * @return The maximum number of keys the queue can hold.
+ */
+size_t hpq_size(hpq_t *hpq);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
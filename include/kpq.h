@@ -0,0 +1,166 @@
+#ifndef KPQ_H
+#define KPQ_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @file kpq.h
+ * @brief Keyed Priority Queue Implementation
+ *
+ * This header file declares the interface for a keyed priority queue (kpq_t).
+ * Unlike `pq_t`, every element carries an unsigned 64-bit key stored inline in the
+ * heap, so ordering never calls back into user code nor dereferences elements.
+ * The queue is a d-ary min-heap whose hot kernels (child selection, bulk heapify
+ * and batch key comparison) are vectorized and picked at load time for the running
+ * CPU (scalar, AVX2 or AVX-512). Set `GUILIB_ISA=scalar` in the environment to
+ * force the portable kernels.
+ */
+
+/**
+ * @struct kpq_t
+ * @brief A structure representing a keyed priority queue.
+ *
+ * @note Users should not modify the structure directly. All interactions should
+ *       be done via the provided functions.
+ */
+typedef struct _kpq_t kpq_t;
+
+/**
+ * @brief Creates a new keyed priority queue.
+ *
+ * @param size The maximum number of elements the queue can hold.
+ * @param arity The number of children per heap node, between 2 and 64. `0` selects 8,
+ *        which fills exactly one cache line per sibling group.
+ *
+ * @return A pointer to the created queue.
+ *
+ * @note The queue needs to be freed using `kpq_destroy()` when no longer needed.
+ */
+kpq_t *kpq_create(size_t size, unsigned arity);
+
+/**
+ * @brief Creates a copy of an existing keyed priority queue.
+ *
+ * @param source_kpq A pointer to the queue to be copied.
+ *
+ * @return A pointer to the new queue, holding the same keys and element pointers.
+ *
+ * @note The elements themselves are not copied, both queues point to them.
+ */
+kpq_t *kpq_copy(kpq_t *source_kpq);
+
+/**
+ * @brief Destroys a keyed priority queue and frees its associated memory.
+ *
+ * @param kpq A pointer to the queue to be destroyed.
+ * @param free_func Called on every element still queued, or NULL.
+ */
+void kpq_destroy(kpq_t *kpq, void (*free_func)(void *));
+
+/**
+ * @brief Inserts an element with the given key.
+ *
+ * @param kpq A pointer to the queue.
+ * @param key The priority of the element. Smaller keys are removed first.
+ * @param i A pointer to the element to be inserted.
+ *
+ * @note If the queue is full, this function will terminate the program by calling `abort()`.
+ */
+void kpq_insert(kpq_t *kpq, uint64_t key, void *i);
+
+/**
+ * @brief Inserts `n` elements at once.
+ *
+ * When the batch is large compared to the queue, the elements are appended and
+ * the whole heap is rebuilt bottom-up in linear time instead of being sifted up one by one.
+ *
+ * @param kpq A pointer to the queue.
+ * @param keys The keys of the elements.
+ * @param items The elements, `items[j]` having key `keys[j]`.
+ * @param n The number of elements.
+ *
+ * @note If the elements do not fit, this function will terminate the program by calling `abort()`.
+ */
+void kpq_insert_n(kpq_t *kpq, const uint64_t *keys, void *const *items, size_t n);
+
+/**
+ * @brief Checks if the queue is empty.
+ *
+ * @param kpq A pointer to the queue.
+ *
+ * @return `1` if the queue is empty, `0` otherwise.
+ */
+char kpq_is_empty(kpq_t *kpq);
+
+/**
+ * @brief Returns the element with the smallest key without removing it.
+ *
+ * @param kpq A pointer to the queue.
+ * @param key If not NULL, receives the key of the element.
+ *
+ * @return A pointer to the top element.
+ *
+ * @note If the queue is empty, this function will abort the program.
+ */
+const void *kpq_peek(kpq_t *kpq, uint64_t *key);
+
+/**
+ * @brief Removes and returns the element with the smallest key.
+ *
+ * @param kpq A pointer to the queue.
+ * @param key If not NULL, receives the key of the removed element.
+ *
+ * @return A pointer to the removed element.
+ *
+ * @note If the queue is empty, this function will abort the program.
+ */
+const void *kpq_remove(kpq_t *kpq, uint64_t *key);
+
+/**
+ * @brief Counts the queued elements whose key is strictly smaller than `key`.
+ *
+ * This is a linear, vectorized scan of the keys, e.g. to measure how far from the
+ * minimum a key would rank.
+ *
+ * @param kpq A pointer to the queue.
+ * @param key The key to rank.
+ *
+ * @return The number of elements with a smaller key.
+ */
+size_t kpq_rank(kpq_t *kpq, uint64_t key);
+
+/**
+ * @brief Returns the number of elements in the queue.
+ *
+ * @param kpq A pointer to the queue.
+ *
+ * @return The number of elements in the queue.
+ */
+size_t kpq_len(kpq_t *kpq);
+
+/**
+ * @brief Returns the maximum size of the queue.
+ *
+ * @param kpq A pointer to the queue.
+ *
+ * @return The maximum number of elements the queue can hold.
+ */
+size_t kpq_size(kpq_t *kpq);
+
+/**
+ * @brief Returns the instruction set of the kernels selected at load time.
+ *
+ * @return `"scalar"`, `"avx2"` or `"avx512"`.
+ */
+const char *kpq_isa(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
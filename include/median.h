@@ -0,0 +1,121 @@
+#ifndef MEDIAN_H
+#define MEDIAN_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @file median.h
+ * @brief Streaming Median and Quantile Tracker
+ *
+ * This header file declares a tracker (median_t) of the median, or of any fixed
+ * quantile, of a stream of samples. The samples are split between a max-heap of
+ * the lower ones and a min-heap of the upper ones, rebalanced so that the quantile
+ * sits at the top of the max-heap, or between the two tops. Adding a sample takes
+ * O(log n) and reading the quantile O(1).
+ *
+ * Both heaps are 4-ary heaps of inline `double` keys in arrays owned by the tracker:
+ * adding a sample does not allocate, except to grow an unbounded tracker's arrays.
+ *
+ * With a window, only the last `window` samples are tracked. Every heap slot is
+ * indexed by the sample's position in a ring, so the oldest sample is removed from
+ * its heap in O(log n) when a new one arrives.
+ */
+
+/**
+ * @struct median_t
+ * @brief A structure representing a streaming quantile tracker.
+ *
+ * @note Users should not modify the structure directly. All interactions should
+ *       be done via the provided functions.
+ */
+typedef struct _median_t median_t;
+
+/**
+ * @brief Creates a tracker of the median.
+ *
+ * @param window The number of most recent samples tracked, or `0` to track every sample.
+ *
+ * @return A pointer to the created tracker.
+ *
+ * @note The tracker needs to be freed using `median_destroy()` when no longer needed.
+ */
+median_t *median_create(size_t window);
+
+/**
+ * @brief Creates a tracker of a quantile.
+ *
+ * The quantile of `n` samples is interpolated linearly between the samples of rank
+ * `floor(q * (n - 1))` and the next one, counting from `0`, so `q = 0.5` is the median.
+ *
+ * @param window The number of most recent samples tracked, or `0` to track every sample.
+ * @param q The quantile, between `0` and `1`.
+ *
+ * @return A pointer to the created tracker.
+ *
+ * @note If `q` is not between `0` and `1`, or the window holds `2^31` samples or more,
+ *       this function will terminate the program by calling `abort()`.
+ * @note The tracker needs to be freed using `median_destroy()` when no longer needed.
+ */
+median_t *median_create_ex(size_t window, double q);
+
+/**
+ * @brief Destroys a tracker and frees its associated memory.
+ *
+ * @param m A pointer to the tracker to be destroyed.
+ */
+void median_destroy(median_t *m);
+
+/**
+ * @brief Adds a sample, dropping the oldest one if the window is full.
+ *
+ * @param m A pointer to the tracker.
+ * @param x The sample.
+ *
+ * @note If `x` is NaN, this function will terminate the program by calling `abort()`.
+ */
+void median_add(median_t *m, double x);
+
+/**
+ * @brief Adds samples in order, as if by calling `median_add()` on each.
+ *
+ * The heaps are rebalanced once for the whole batch. A batch at least as large as the
+ * samples already tracked is split around the quantile by selection and heapified
+ * in O(n) instead.
+ *
+ * @param m A pointer to the tracker.
+ * @param xs The samples, oldest first.
+ * @param n The number of samples.
+ *
+ * @note If a sample is NaN, this function will terminate the program by calling `abort()`.
+ */
+void median_add_n(median_t *m, const double *xs, size_t n);
+
+/**
+ * @brief Returns the tracked quantile of the samples.
+ *
+ * @param m A pointer to the tracker.
+ *
+ * @return The median, or the quantile the tracker was created for.
+ *
+ * @note If no sample was added, this function will terminate the program by calling `abort()`.
+ */
+double median_get(median_t *m);
+
+/**
+ * @brief Returns the number of tracked samples.
+ *
+ * @param m A pointer to the tracker.
+ *
+ * @return The number of samples, at most the window.
+ */
+size_t median_len(median_t *m);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
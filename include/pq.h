@@ -2,6 +2,11 @@
 #define PQ_H
 
 #include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 /**
  * @file pq.h
@@ -28,6 +33,87 @@
  */
 typedef struct _pq_t pq_t;
 
+/**
+ * @brief Number of buckets in the sift depth histograms of `pq_stats_t`.
+ *
+ * Bucket `d` counts sifts that moved an element `d` levels; the last bucket also
+ * collects every deeper sift.
+ */
+#define PQ_STATS_DEPTHS 64
+
+/**
+ * @struct pq_stats_t
+ * @brief Hot-path counters of a priority queue.
+ *
+ * Counters are only maintained when the library is built with `PQ_STATS` defined
+ * (`make STATS=1`). Otherwise `pq_stats()` reports all zeros and the counters cost nothing.
+ *
+ * - `compares`: Calls made to the comparison function.
+ * - `swaps`: Element moves performed while sifting.
+ * - `sift_up`: Histogram of sift-up depths, one sample per insertion.
+ * - `sift_down`: Histogram of sift-down depths, one sample per removal.
+ * - `allocs`: Calls made to `malloc()` (queue structures, arrays and nodes).
+ * - `peak_len`: Largest length the queue reached.
+ * - `full_events`: Insertions attempted while the queue was at full capacity.
+ * - `switches`: Changes of representation made by a `PQ_ADAPTIVE` queue.
+ */
+typedef struct {
+    size_t              compares;
+    size_t              swaps;
+    size_t              sift_up[PQ_STATS_DEPTHS];
+    size_t              sift_down[PQ_STATS_DEPTHS];
+    size_t              allocs;
+    size_t              peak_len;
+    size_t              full_events;
+    size_t              switches;
+} pq_stats_t;
+
+typedef struct {
+    int                 copies;
+    const void          *val;
+} _pq_node_t;
+
+/*
+ * The members read by the inline accessors below. They are the only public part of
+ * a queue: the library allocates its private state after them, so this layout does
+ * not change with the library's internals or build options.
+ */
+struct _pq_t {
+    size_t              len;
+    size_t              pending;
+    size_t              size;
+    unsigned            slow;
+    _pq_node_t          **arr;
+};
+
+/* Out-of-line halves of the inline accessors and the checks. Not part of the API. */
+#ifdef __GNUC__
+__attribute__((noreturn, cold, format(printf, 1, 2)))
+#endif
+void _pq_fatal(const char *fmt, ...);
+const void *_pq_peek(pq_t *pq);
+
+#ifdef PQ_NO_CHECKS
+#define _PQ_CHECK(cond, ...) ((void)0)
+#else
+#define _PQ_CHECK(cond, ...) ((cond) ? _pq_fatal(__VA_ARGS__) : (void)0)
+#endif
+
+/**
+ * @brief Status codes returned by the `pq_try_*` functions.
+ *
+ * The checked functions (`pq_insert()`, `pq_remove()`, ...) abort on the same conditions.
+ * When the library and the caller are built with `PQ_NO_CHECKS` (`make CHECKS=0`) they skip
+ * the checks altogether and behave like their `_unchecked` counterparts, which is undefined
+ * behavior on misuse. The `pq_try_*` functions always check.
+ */
+enum pq_status {
+    PQ_OK = 0,
+    PQ_ENULL = -1,
+    PQ_EFULL = -2,
+    PQ_EEMPTY = -3,
+};
+
 /**
  * @brief Creates a new priority queue.
  *
@@ -48,6 +134,76 @@ typedef struct _pq_t pq_t;
  */
 pq_t *pq_create(size_t size, int (*compare)(const void *, const void *));
 
+/**
+ * @brief Tunes a priority queue for heaps much larger than the CPU caches.
+ *
+ * Removals prefetch the next level of the heap while comparing the current one and
+ * pick the smaller child without branching. This pays off from roughly a million
+ * elements; on small heaps it is neutral to slightly slower.
+ */
+#define PQ_LARGE 1u
+
+/**
+ * @brief Stores the heap in a page-blocked (B-heap) layout.
+ *
+ * Every 4 KiB page holds a 9-level subtree, so a root-to-leaf path touches about
+ * log2(n) / 9 pages instead of one page per level below the first few, which relieves
+ * the TLB on heaps of 100M+ elements. Sifts pay a few extra operations per level for
+ * the index mapping, so the layout is slower than the default one while the array is
+ * covered by the TLB (small heaps, or transparent huge pages). The array is page
+ * aligned and may reserve up to twice `size` slots. `PQ_LARGE` has no further effect
+ * on such queues.
+ */
+#define PQ_BHEAP 2u
+
+/**
+ * @brief Lets the queue grow instead of reporting it full.
+ *
+ * The capacity doubles whenever an insertion would not fit. With a work budget set
+ * by `pq_set_budget()` the larger array is filled a budget of slots per operation,
+ * starting once the queue is 3/4 full, so no call pays for copying the whole heap.
+ * Cannot be combined with `PQ_BHEAP`.
+ */
+#define PQ_GROW 4u
+
+/**
+ * @brief Defers ordering inserted elements until they are needed.
+ *
+ * Inserts append to an unsorted buffer and only track its minimum, so `pq_peek()`
+ * stays O(1). The next `pq_remove()` orders the buffer, by heapifying it when it
+ * is large and by sifting its elements up otherwise, and merges it into the heap
+ * as `pq_insert_n()` does. Pays off when bursts of inserts would each sift far, such
+ * as keys arriving in decreasing order; random keys sift up O(1) levels on average,
+ * where the buffer is about neutral. Under a budget set by `pq_set_budget()` inserts
+ * are not deferred, so that no removal orders a whole backlog.
+ */
+#define PQ_LAZY 8u
+
+/**
+ * @brief Picks the heap representation from the observed size and workload.
+ *
+ * Queues below 32 elements are kept as a sorted array, larger ones as a binary heap
+ * and, from 65536 elements, as a 4-ary heap or an 8-ary heap when inserts outnumber
+ * removals two to one. The thresholds have hysteresis and conversions that rebuild
+ * the heap wait for as many operations as the queue holds, so their O(n) cost is
+ * amortized. Switches are counted in `pq_stats_t`. Cannot be combined with
+ * `PQ_BHEAP` or `PQ_GROW`.
+ */
+#define PQ_ADAPTIVE 16u
+
+/**
+ * @brief Creates a new priority queue with layout and tuning flags.
+ *
+ * @param size The maximum number of elements the priority queue can hold.
+ * @param compare A comparison function used to maintain the heap order, as in `pq_create()`.
+ * @param flags A bitwise OR of `PQ_LARGE`, `PQ_BHEAP`, `PQ_GROW`, `PQ_LAZY` and `PQ_ADAPTIVE`, or `0` for the behavior of `pq_create()`.
+ *
+ * @return A pointer to the created priority queue.
+ *
+ * @note The flags are kept by `pq_copy()`.
+ */
+pq_t *pq_create_ex(size_t size, int (*compare)(const void *, const void *), unsigned flags);
+
 /**
  * @brief Creates a copy of an existing priority queue.
  *
@@ -109,6 +265,60 @@ void pq_destroy(pq_t *pq, void (*free_func)(void *));
  */
 void pq_insert(pq_t *pq, void *i);
 
+/**
+ * @brief Inserts an element without validating the queue.
+ *
+ * @param pq A pointer to the priority queue. Must not be NULL.
+ * @param i A pointer to the element to be inserted.
+ *
+ * @note The queue must not be full.
+ */
+void pq_insert_unchecked(pq_t *pq, void *i);
+
+/**
+ * @brief Inserts an element, reporting failures instead of aborting.
+ *
+ * @param pq A pointer to the priority queue.
+ * @param i A pointer to the element to be inserted.
+ *
+ * @return `PQ_OK`, `PQ_ENULL` if `pq` is NULL or `PQ_EFULL` if the queue is full,
+ *         in which case nothing is inserted.
+ */
+int pq_try_insert(pq_t *pq, void *i);
+
+/**
+ * @brief Inserts a batch of elements.
+ *
+ * The batch is heapified on its own in O(n). Without a work budget it is merged into
+ * the queue right away, by rebuilding the heap when the batch is at least half as
+ * large as the queue and by sifting each element up otherwise. With a budget it is
+ * merged a budget of elements per later operation; peeks and removals stay exact
+ * meanwhile, they compare the tops of the queue and of the unmerged batch.
+ *
+ * @param pq A pointer to the priority queue.
+ * @param items The elements to be inserted.
+ * @param n The number of elements in `items`.
+ *
+ * @note If the batch does not fit and the queue was not created with `PQ_GROW`,
+ *       this function will terminate the program by calling `abort()`.
+ */
+void pq_insert_n(pq_t *pq, void *const *items, size_t n);
+
+/**
+ * @brief Bounds the maintenance work done by each operation.
+ *
+ * Growing a `PQ_GROW` queue and merging batches from `pq_insert_n()` are O(n) jobs.
+ * With a budget they are spread over the following inserts and removals, each one
+ * moving at most `work` elements per job on top of its own sift, which bounds the
+ * worst-case latency of every call. A budget of `0`, the default, does every job at
+ * once and finishes any job in progress. A `PQ_LAZY` queue stops deferring inserts
+ * under a budget, and setting one orders the elements already deferred.
+ *
+ * @param pq A pointer to the priority queue.
+ * @param work The number of elements moved per operation, at least 8, or `0`.
+ */
+void pq_set_budget(pq_t *pq, size_t work);
+
 /**
  * @brief Checks if the priority queue is empty.
  *
@@ -118,7 +328,20 @@ void pq_insert(pq_t *pq, void *i);
  *
  * @return `1` if the priority queue is empty, `0` otherwise.
  */
-char pq_is_empty(pq_t *pq);
+inline char pq_is_empty(pq_t *pq) {
+    return !pq->len && !pq->pending;
+}
+
+/**
+ * @brief Returns the top element without validating the queue.
+ *
+ * @param pq A pointer to the priority queue. Must not be NULL nor empty.
+ *
+ * @return A pointer to the top element in the priority queue.
+ */
+inline const void *pq_peek_unchecked(pq_t *pq) {
+    return pq->slow ? _pq_peek(pq) : pq->arr[0]->val;
+}
 
 /**
  * @brief Returns the element at the top of the priority queue.
@@ -131,8 +354,40 @@ char pq_is_empty(pq_t *pq);
  * @return A pointer to the top element in the priority queue.
  *
  * @note If the queue is empty, this function will abort the program.
+ *
+ * @note Inlined calls only enter the library (firing the `pq_peek` tracepoint)
+ *       while the queue is being traced.
  */
-const void *pq_peek(pq_t *pq);
+inline const void *pq_peek(pq_t *pq) {
+#ifndef PQ_NO_CHECKS
+    if (!pq || (!pq->len && !pq->pending))
+        return _pq_peek(pq);
+#endif
+
+    return pq_peek_unchecked(pq);
+}
+
+/**
+ * @brief Returns the top element, reporting failures instead of aborting.
+ *
+ * @param pq A pointer to the priority queue.
+ * @param out If not NULL, receives the top element.
+ *
+ * @return `PQ_OK`, `PQ_ENULL` if `pq` is NULL or `PQ_EEMPTY` if the queue is empty.
+ */
+inline int pq_try_peek(pq_t *pq, const void **out) {
+    if (!pq)
+        return PQ_ENULL;
+
+    if (!pq->len && !pq->pending)
+        return PQ_EEMPTY;
+
+    const void *top = pq_peek_unchecked(pq);
+    if (out)
+        *out = top;
+
+    return PQ_OK;
+}
 
 /**
  * @brief Removes and returns the element at the top of the priority queue.
@@ -148,6 +403,26 @@ const void *pq_peek(pq_t *pq);
  */
 const void *pq_remove(pq_t *pq);
 
+/**
+ * @brief Removes and returns the top element without validating the queue.
+ *
+ * @param pq A pointer to the priority queue. Must not be NULL nor empty.
+ *
+ * @return A pointer to the element that was removed from the top of the queue.
+ */
+const void *pq_remove_unchecked(pq_t *pq);
+
+/**
+ * @brief Removes the top element, reporting failures instead of aborting.
+ *
+ * @param pq A pointer to the priority queue.
+ * @param out If not NULL, receives the removed element.
+ *
+ * @return `PQ_OK`, `PQ_ENULL` if `pq` is NULL or `PQ_EEMPTY` if the queue is empty,
+ *         in which case nothing is removed.
+ */
+int pq_try_remove(pq_t *pq, const void **out);
+
 /**
  * @brief Returns the number of elements in the priority queue.
  *
@@ -157,7 +432,19 @@ const void *pq_remove(pq_t *pq);
  *
  * @return The number of elements in the priority queue.
  */
-size_t pq_len(pq_t *pq);
+inline size_t pq_len(pq_t *pq) {
+    _PQ_CHECK(!pq, "Trying to get len from nullptr");
+    return pq->len + pq->pending;
+}
+
+/**
+ * @brief Returns the number of elements of the priority queue without validating it.
+ *
+ * @param pq A pointer to the priority queue. Must not be NULL.
+ */
+inline size_t pq_len_unchecked(pq_t *pq) {
+    return pq->len + pq->pending;
+}
 
 /**
  * @brief Returns the maximum size of the priority queue.
@@ -168,7 +455,19 @@ size_t pq_len(pq_t *pq);
  *
  * @return The maximum size of the priority queue.
  */
-size_t pq_size(pq_t *pq);
+inline size_t pq_size(pq_t *pq) {
+    _PQ_CHECK(!pq, "Trying to get size from nullptr");
+    return pq->size;
+}
+
+/**
+ * @brief Returns the maximum size of the priority queue without validating it.
+ *
+ * @param pq A pointer to the priority queue. Must not be NULL.
+ */
+inline size_t pq_size_unchecked(pq_t *pq) {
+    return pq->size;
+}
 
 /**
  * @brief Prints the elements of a priority queue.
@@ -181,6 +480,78 @@ size_t pq_size(pq_t *pq);
  */
 void pq_print(pq_t *pq, const char* (*to_str)(const void *));
 
+/**
+ * @brief Reads the hot-path counters of a priority queue.
+ *
+ * @param pq A pointer to the priority queue.
+ * @param out Where the counters are copied to.
+ *
+ * @note When the library is built without `PQ_STATS`, `out` is zero-filled.
+ */
+void pq_stats(pq_t *pq, pq_stats_t *out);
+
+/**
+ * @brief Resets the hot-path counters of a priority queue.
+ *
+ * `peak_len` restarts from the current length of the queue.
+ *
+ * @param pq A pointer to the priority queue.
+ */
+void pq_stats_reset(pq_t *pq);
+
+/**
+ * @brief Magic number opening every operation trace file ("PQTR" in little endian).
+ */
+#define PQ_TRACE_MAGIC 0x52545150u
+
+/**
+ * @brief Version of the operation trace format.
+ */
+#define PQ_TRACE_VERSION 1
+
+/**
+ * @brief Set in the trace header flags when records carry user keys instead of element ids.
+ */
+#define PQ_TRACE_KEYED 1u
+
+/**
+ * @brief Operation codes stored in trace records.
+ */
+enum pq_trace_op {
+    PQ_TRACE_INSERT = 0,
+    PQ_TRACE_REMOVE = 1,
+    PQ_TRACE_PEEK = 2,
+};
+
+/**
+ * @brief Starts capturing the operations of a priority queue to a binary trace file.
+ *
+ * Every `pq_insert()`, `pq_remove()` and `pq_peek()` on `pq` appends a 12-byte record to `path`.
+ * The file starts with four `uint32_t` (`PQ_TRACE_MAGIC`, `PQ_TRACE_VERSION`, flags, reserved),
+ * followed by records made of a `uint64_t` key and a `uint32_t` holding the nanoseconds elapsed
+ * since the previous record shifted left by two, OR'ed with the `pq_trace_op`. Values are stored
+ * in host byte order. Records are buffered and flushed by `pq_trace_stop()` or `pq_destroy()`.
+ *
+ * @param pq A pointer to the priority queue.
+ * @param path The file the trace is written to. It is truncated if it exists.
+ * @param key A function mapping an element to a 64-bit key ordered like `compare`, or NULL.
+ *        When NULL, records carry a hash of the element pointer and replay tools derive
+ *        equivalent keys from the order in which elements were removed.
+ *
+ * @return `0` on success, `-1` if the file could not be opened or the library was built
+ *         without `PQ_TRACE` (`make TRACE=1`).
+ *
+ * @note Starting a trace on a queue that is already tracing stops the previous trace first.
+ */
+int pq_trace_start(pq_t *pq, const char *path, uint64_t (*key)(const void *));
+
+/**
+ * @brief Stops capturing operations and closes the trace file.
+ *
+ * @param pq A pointer to the priority queue. Does nothing if the queue is not tracing.
+ */
+void pq_trace_stop(pq_t *pq);
+
 /**
  * @brief A constant function pointer that provides a string representation of a pointer.
  *
@@ -199,4 +570,8 @@ void pq_print(pq_t *pq, const char* (*to_str)(const void *));
  */
 extern const char *(*const DEFAULT_TO_STR)(const void *);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif
@@ -0,0 +1,142 @@
+#ifndef SPQ_H
+#define SPQ_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @file spq.h
+ * @brief String-Keyed Priority Queue Implementation
+ *
+ * This header file declares the interface for a string-keyed priority queue (spq_t),
+ * a binary min-heap ordered like `strcmp()` on a string key given with every element.
+ * Each heap slot caches the first 8 bytes of its key as a big-endian integer, so most
+ * comparisons are a single integer compare that never touches the strings. Only keys
+ * sharing their first 8 bytes fall back to comparing the rest of the strings.
+ *
+ * The queue stores key pointers, it does not copy the strings: a key must stay valid
+ * and unchanged while its element is queued.
+ */
+
+/**
+ * @struct spq_t
+ * @brief A structure representing a string-keyed priority queue.
+ *
+ * @note Users should not modify the structure directly. All interactions should
+ *       be done via the provided functions.
+ */
+typedef struct _spq_t spq_t;
+
+/**
+ * @brief Creates a new string-keyed priority queue.
+ *
+ * @param size The maximum number of elements the queue can hold.
+ *
+ * @return A pointer to the created queue.
+ *
+ * @note The queue needs to be freed using `spq_destroy()` when no longer needed.
+ */
+spq_t *spq_create(size_t size);
+
+/**
+ * @brief Creates a copy of an existing string-keyed priority queue.
+ *
+ * @param source_spq A pointer to the queue to be copied.
+ *
+ * @return A pointer to the new queue, holding the same keys and element pointers.
+ *
+ * @note Neither the keys nor the elements are copied, both queues point to them.
+ */
+spq_t *spq_copy(spq_t *source_spq);
+
+/**
+ * @brief Destroys a string-keyed priority queue and frees its associated memory.
+ *
+ * @param spq A pointer to the queue to be destroyed.
+ * @param free_func Called on every element still queued, or NULL.
+ */
+void spq_destroy(spq_t *spq, void (*free_func)(void *));
+
+/**
+ * @brief Inserts an element with the given key.
+ *
+ * @param spq A pointer to the queue.
+ * @param key A NUL-terminated string. Smaller keys (by `strcmp()`) are removed first.
+ * @param i A pointer to the element to be inserted.
+ *
+ * @note If the queue is full, this function will terminate the program by calling `abort()`.
+ */
+void spq_insert(spq_t *spq, const char *key, void *i);
+
+/**
+ * @brief Checks if the queue is empty.
+ *
+ * @param spq A pointer to the queue.
+ *
+ * @return `1` if the queue is empty, `0` otherwise.
+ */
+char spq_is_empty(spq_t *spq);
+
+/**
+ * @brief Returns the element with the smallest key without removing it.
+ *
+ * @param spq A pointer to the queue.
+ * @param key If not NULL, receives the key of the element.
+ *
+ * @return A pointer to the top element.
+ *
+ * @note If the queue is empty, this function will abort the program.
+ */
+void *spq_peek(spq_t *spq, const char **key);
+
+/**
+ * @brief Removes and returns the element with the smallest key.
+ *
+ * @param spq A pointer to the queue.
+ * @param key If not NULL, receives the key of the removed element.
+ *
+ * @return A pointer to the removed element.
+ *
+ * @note If the queue is empty, this function will abort the program.
+ */
+void *spq_remove(spq_t *spq, const char **key);
+
+/**
+ * @brief Returns the number of elements in the queue.
+ *
+ * @param spq A pointer to the queue.
+ *
+ * @return The number of elements in the queue.
+ */
+size_t spq_len(spq_t *spq);
+
+/**
+ * @brief Returns the maximum size of the queue.
+ *
+ * @param spq A pointer to the queue.
+ *
+ * @return The maximum number of elements the queue can hold.
+ */
+size_t spq_size(spq_t *spq);
+
+/**
+ * @brief Returns how many comparisons had to read the strings.
+ *
+ * These are the comparisons of keys sharing their first 8 bytes. Compared to the total
+ * number of comparisons it tells how well the cached prefixes discriminate the keys.
+ *
+ * @param spq A pointer to the queue.
+ *
+ * @return The number of string comparisons made since the queue was created.
+ */
+size_t spq_fallbacks(spq_t *spq);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
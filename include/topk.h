@@ -0,0 +1,133 @@
+#ifndef TOPK_H
+#define TOPK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @file topk.h
+ * @brief Sliding-Window Top-K
+ *
+ * This header file declares a tracker (topk_t) of the `k` best scored items among
+ * those added during the last `window` time units. Items are added in time order,
+ * and an item stays in the window while `now - time < window`. Among equal scores,
+ * the more recent item ranks first.
+ *
+ * The current top `k` are a bounded min-heap with the worst at the root, so a new
+ * item that makes the cut replaces it in O(log k) and one that does not costs O(1).
+ * Items pushed out, or never let in, wait in a reserve in case top items expire
+ * before them. The reserve is a max-heap that absorbs new items unsorted and only
+ * orders them when a top item expires. Expired items are dropped when they surface
+ * at its root, and every time the reserve grows fourfold it is compacted in linear
+ * time. Compaction drops expired items and items outranked by `k` more recent ones,
+ * which can never make the top again. On a random stream, about `k * ln(n / k)`
+ * items survive compaction for `n` items in the window.
+ *
+ * To rank keys (e.g. endpoints) rather than single events, add one item per key and
+ * aggregation period carrying the key's aggregate as score and the key as `id`.
+ */
+
+/**
+ * @struct topk_item_t
+ * @brief An item as written by `topk_snapshot()`.
+ *
+ * - `score`: The score the item was added with.
+ * - `time`: The time the item was added at.
+ * - `id`: The identifier the item was added with.
+ */
+typedef struct {
+    double              score;
+    uint64_t            time;
+    uint64_t            id;
+} topk_item_t;
+
+/**
+ * @struct topk_t
+ * @brief A structure representing a sliding-window top-k tracker.
+ *
+ * @note Users should not modify the structure directly. All interactions should
+ *       be done via the provided functions.
+ */
+typedef struct _topk_t topk_t;
+
+/**
+ * @brief Creates a new tracker at time `0`.
+ *
+ * @param k The number of best items tracked.
+ * @param window How long an item stays in the window, in the units of the item times.
+ *
+ * @return A pointer to the created tracker.
+ *
+ * @note If `k` or `window` is `0`, this function will terminate the program by calling `abort()`.
+ * @note The tracker needs to be freed using `topk_destroy()` when no longer needed.
+ */
+topk_t *topk_create(size_t k, uint64_t window);
+
+/**
+ * @brief Destroys a tracker and frees its associated memory.
+ *
+ * @param tk A pointer to the tracker to be destroyed.
+ */
+void topk_destroy(topk_t *tk);
+
+/**
+ * @brief Adds an item, first moving the window to its time.
+ *
+ * @param tk A pointer to the tracker.
+ * @param time The time of the item, not before the current time.
+ * @param score The score of the item, higher is better.
+ * @param id Kept with the item for the caller.
+ *
+ * @note If `time` is in the past or `score` is NaN, this function will terminate the
+ *       program by calling `abort()`.
+ */
+void topk_add(topk_t *tk, uint64_t time, double score, uint64_t id);
+
+/**
+ * @brief Moves the window to a later time, expiring the items that fall out of it.
+ *
+ * @param tk A pointer to the tracker.
+ * @param now The current time, not before the previous one.
+ *
+ * @note If `now` is in the past, this function will terminate the program by calling `abort()`.
+ */
+void topk_advance(topk_t *tk, uint64_t now);
+
+/**
+ * @brief Writes the current top items, best first, without allocating.
+ *
+ * @param tk A pointer to the tracker.
+ * @param out Receives the items.
+ * @param cap The number of items `out` can hold. Only the best `cap` items are written.
+ *
+ * @return The number of items written, at most `k`.
+ */
+size_t topk_snapshot(topk_t *tk, topk_item_t *out, size_t cap);
+
+/**
+ * @brief Returns the number of items in the current top.
+ *
+ * @param tk A pointer to the tracker.
+ *
+ * @return `k`, or fewer if the window holds fewer items.
+ */
+size_t topk_len(topk_t *tk);
+
+/**
+ * @brief Returns the number of items held, in the top and in reserve.
+ *
+ * @param tk A pointer to the tracker.
+ *
+ * @return The number of items held, expired ones not yet dropped included.
+ */
+size_t topk_held(topk_t *tk);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
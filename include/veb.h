@@ -0,0 +1,160 @@
+#ifndef VEB_H
+#define VEB_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @file veb.h
+ * @brief Integer Priority Queue Implementation
+ *
+ * This header file declares the interface for an integer priority queue (veb_t) over
+ * keys from a fixed universe of up to 2^32 values. Keys are kept as a set in a tree
+ * of 64-bit bitmaps, each bit of an upper level telling whether the 64 bits below it
+ * hold any key (a van Emde Boas style layout with 64-ary nodes). Insertion, removal,
+ * minimum and successor queries walk at most one word per level, i.e. 6 words for
+ * 32-bit keys, using count-trailing-zeros.
+ *
+ * Inserting a key already present does nothing, so the queue deduplicates by itself.
+ */
+
+/**
+ * @struct veb_t
+ * @brief A structure representing an integer priority queue.
+ *
+ * @note Users should not modify the structure directly. All interactions should
+ *       be done via the provided functions.
+ */
+typedef struct _veb_t veb_t;
+
+/**
+ * @brief Creates a new integer priority queue.
+ *
+ * @param universe Keys range from `0` to `universe - 1`. At most 2^32.
+ *
+ * @return A pointer to the created queue.
+ *
+ * @note The bitmaps take about `universe / 8` bytes, allocated zeroed so that the
+ *       operating system only backs the pages that are touched.
+ *
+ * @note The queue needs to be freed using `veb_destroy()` when no longer needed.
+ */
+veb_t *veb_create(uint64_t universe);
+
+/**
+ * @brief Creates a copy of an existing integer priority queue.
+ *
+ * @param source_veb A pointer to the queue to be copied.
+ *
+ * @return A pointer to the new queue, holding the same keys.
+ */
+veb_t *veb_copy(veb_t *source_veb);
+
+/**
+ * @brief Destroys an integer priority queue and frees its associated memory.
+ *
+ * @param veb A pointer to the queue to be destroyed.
+ */
+void veb_destroy(veb_t *veb);
+
+/**
+ * @brief Inserts a key.
+ *
+ * @param veb A pointer to the queue.
+ * @param key The key to insert.
+ *
+ * @return `1` if the key was inserted, `0` if it was already present.
+ *
+ * @note If `key` is not in the universe, this function will terminate the program by calling `abort()`.
+ */
+char veb_insert(veb_t *veb, uint32_t key);
+
+/**
+ * @brief Removes a key.
+ *
+ * @param veb A pointer to the queue.
+ * @param key The key to remove.
+ *
+ * @return `1` if the key was removed, `0` if it was not present.
+ */
+char veb_erase(veb_t *veb, uint32_t key);
+
+/**
+ * @brief Checks whether a key is present.
+ *
+ * @param veb A pointer to the queue.
+ * @param key The key to look up.
+ *
+ * @return `1` if the key is present, `0` otherwise.
+ */
+char veb_contains(veb_t *veb, uint32_t key);
+
+/**
+ * @brief Checks if the queue is empty.
+ *
+ * @param veb A pointer to the queue.
+ *
+ * @return `1` if the queue is empty, `0` otherwise.
+ */
+char veb_is_empty(veb_t *veb);
+
+/**
+ * @brief Returns the smallest key without removing it.
+ *
+ * @param veb A pointer to the queue.
+ *
+ * @return The smallest key.
+ *
+ * @note If the queue is empty, this function will abort the program.
+ */
+uint32_t veb_peek(veb_t *veb);
+
+/**
+ * @brief Removes and returns the smallest key.
+ *
+ * @param veb A pointer to the queue.
+ *
+ * @return The removed key.
+ *
+ * @note If the queue is empty, this function will abort the program.
+ */
+uint32_t veb_remove(veb_t *veb);
+
+/**
+ * @brief Finds the smallest key strictly greater than `key`.
+ *
+ * @param veb A pointer to the queue.
+ * @param key The key to start from. It does not need to be present.
+ * @param out Receives the successor when there is one.
+ *
+ * @return `1` if a successor was found, `0` otherwise.
+ */
+char veb_succ(veb_t *veb, uint32_t key, uint32_t *out);
+
+/**
+ * @brief Returns the number of keys in the queue.
+ *
+ * @param veb A pointer to the queue.
+ *
+ * @return The number of keys.
+ */
+size_t veb_len(veb_t *veb);
+
+/**
+ * @brief Returns the universe of the queue.
+ *
+ * @param veb A pointer to the queue.
+ *
+ * @return The `universe` the queue was created with.
+ */
+uint64_t veb_universe(veb_t *veb);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
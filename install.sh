@@ -54,4 +54,4 @@ find $INCLUDE_DIR -type f ! -name "utils.h" -exec echo "+ $full_command" \; -exe
 
 
 full_command="sudo $command {} $t_so_path"
-find $BUILD_DIR -type f -exec echo "+ $full_command" \; -exec $full_command \;
+find $BUILD_DIR -maxdepth 1 -type f -name "lib*" -exec echo "+ $full_command" \; -exec $full_command \;
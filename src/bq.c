@@ -0,0 +1,152 @@
+#include "utils.h"
+#include "bq.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define WORD_BITS 64
+
+typedef struct {
+    bq_node_t           *head;
+    bq_node_t           *tail;
+} _bq_list_t;
+
+/*
+ * Bit w of `summary` is set when `words[w]` is not zero, bit b of `words[w]` when
+ * the list of priority w * 64 + b is not empty. 64 words cover BQ_MAX_PRIOS.
+ */
+struct _bq_t {
+    size_t              len;
+    unsigned            prios;
+    uint64_t            summary;
+    uint64_t            *words;
+    _bq_list_t          *lists;
+};
+
+static inline unsigned _bq_min(const bq_t *bq) {
+    unsigned w = __builtin_ctzll(bq->summary);
+    return w * WORD_BITS + __builtin_ctzll(bq->words[w]);
+}
+
+bq_t *bq_create(unsigned prios) {
+    if (!prios || prios > BQ_MAX_PRIOS) {
+        fprintf(stderr, "bq_error: Priorities %u are not between 1 and %d\n", prios, BQ_MAX_PRIOS);
+        abort();
+    }
+
+    bq_t *bq_ptr = malloc(sizeof(bq_t));
+    bq_ptr->len = 0;
+    bq_ptr->prios = prios;
+    bq_ptr->summary = 0;
+    bq_ptr->words = calloc((prios + WORD_BITS - 1) / WORD_BITS, sizeof(uint64_t));
+    bq_ptr->lists = calloc(prios, sizeof(_bq_list_t));
+
+    return bq_ptr;
+}
+
+void bq_destroy(bq_t *bq, void (*free_func)(bq_node_t *)) {
+    if (free_func)
+        for (unsigned p = 0; p < bq->prios; p++)
+            for (bq_node_t *n = bq->lists[p].head, *next; n; n = next) {
+                next = n->next;
+                free_func(n);
+            }
+
+    free(bq->words);
+    free(bq->lists);
+    free(bq);
+}
+
+void bq_insert(bq_t *bq, bq_node_t *node, unsigned prio) {
+    if (!bq) {
+        fprintf(stderr, "bq_error: Trying to insert to nullptr\n");
+        abort();
+    }
+
+    if (prio >= bq->prios) {
+        fprintf(stderr, "bq_error: Priority %u is out of range [0, %u)\n", prio, bq->prios);
+        abort();
+    }
+
+    _bq_list_t *list = &bq->lists[prio];
+
+    node->next = NULL;
+    if (list->head) {
+        list->tail->next = node;
+    } else {
+        list->head = node;
+        bq->words[prio / WORD_BITS] |= 1ULL << (prio % WORD_BITS);
+        bq->summary |= 1ULL << (prio / WORD_BITS);
+    }
+    list->tail = node;
+    bq->len++;
+}
+
+char bq_is_empty(bq_t *bq) {
+    return !bq->len;
+}
+
+bq_node_t *bq_peek(bq_t *bq, unsigned *prio) {
+    if (!bq) {
+        fprintf(stderr, "bq_error: Trying to peek in nullptr\n");
+        abort();
+    }
+
+    if (!bq->len) {
+        fprintf(stderr, "bq_error: Trying to access element in empty bq\n");
+        abort();
+    }
+
+    unsigned p = _bq_min(bq);
+    if (prio)
+        *prio = p;
+
+    return bq->lists[p].head;
+}
+
+bq_node_t *bq_remove(bq_t *bq, unsigned *prio) {
+    if (!bq) {
+        fprintf(stderr, "bq_error: Trying to remove from nullptr\n");
+        abort();
+    }
+
+    if (!bq->len) {
+        fprintf(stderr, "bq_error: Trying to remove element from empty bq\n");
+        abort();
+    }
+
+    unsigned p = _bq_min(bq);
+    _bq_list_t *list = &bq->lists[p];
+    bq_node_t *top = list->head;
+
+    if (!(list->head = top->next)) {
+        uint64_t *word = &bq->words[p / WORD_BITS];
+        if (!(*word &= ~(1ULL << (p % WORD_BITS))))
+            bq->summary &= ~(1ULL << (p / WORD_BITS));
+    }
+
+    if (prio)
+        *prio = p;
+
+    bq->len--;
+    top->next = NULL;
+    return top;
+}
+
+size_t bq_len(bq_t *bq) {
+    if (!bq) {
+        fprintf(stderr, "bq_error: Trying to get len from nullptr\n");
+        abort();
+    }
+
+    return bq->len;
+}
+
+unsigned bq_prios(bq_t *bq) {
+    if (!bq) {
+        fprintf(stderr, "bq_error: Trying to get prios from nullptr\n");
+        abort();
+    }
+
+    return bq->prios;
+}
@@ -0,0 +1,445 @@
+#include "utils.h"
+#include "des.h"
+#include "dheap.h"
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define ARITY 4
+#define NIL UINT32_MAX
+#define QUEUED (UINT32_MAX - 1)
+#define BATCHED (UINT32_MAX - 2)
+#define FREE (UINT32_MAX - 3)
+#define MAX_EVENTS ((size_t)UINT32_MAX - 3)
+#define POOL_MIN 16
+#define CAL_MIN 16
+#define CAL_SAMPLE 25
+
+/*
+ * Events are slots of a pool addressed by index, so growing it with realloc() keeps
+ * handles valid: a handle is the slot's generation, bumped every time the slot is
+ * freed, above its index. `pos` is the event's heap index, or QUEUED in a calendar
+ * list, BATCHED once des_step() took it off the list, FREE in the free list (linked
+ * through `next`).
+ */
+typedef struct {
+    uint64_t            time;
+    uint64_t            seq;
+    des_handler_t       fn;
+    void                *arg;
+    uint32_t            gen;
+    uint32_t            pos;
+    uint32_t            prev;
+    uint32_t            next;
+} _des_event_t;
+
+/* Heap entries carry their keys so that sifting does not touch the pool. */
+typedef struct {
+    uint64_t            time;
+    uint64_t            seq;
+    uint32_t            ev;
+} _des_entry_t;
+
+typedef struct {
+    uint32_t            ev;
+    uint32_t            gen;
+} _des_batch_t;
+
+/*
+ * Calendar bucket i holds, sorted, the events whose day (time >> shift) is i modulo
+ * nb. `day` is at most the day of the earliest queued event: dispatch scans buckets
+ * from it for an event of the day it is looking at, and falls back to the earliest
+ * head after a whole year of empty days.
+ */
+struct _des_t {
+    uint64_t            now;
+    uint64_t            seq;
+    size_t              len;
+    size_t              queued;
+    size_t              cap;
+    unsigned            flags;
+    char                running;
+    uint32_t            free;
+    _des_event_t        *ev;
+    _des_entry_t        *heap;
+    uint32_t            *head;
+    uint32_t            *tail;
+    size_t              nb;
+    unsigned            shift;
+    uint64_t            day;
+    _des_batch_t        *batch;
+    size_t              batch_cap;
+};
+
+static void _des_pool_grow(des_t *des, size_t cap) {
+    des->ev = realloc(des->ev, cap * sizeof(_des_event_t));
+    if (!(des->flags & DES_CALENDAR))
+        des->heap = realloc(des->heap, cap * sizeof(_des_entry_t));
+
+    for (size_t i = cap; i-- > des->cap;) {
+        des->ev[i].gen = 1;
+        des->ev[i].pos = FREE;
+        des->ev[i].next = des->free;
+        des->free = (uint32_t)i;
+    }
+
+    des->cap = cap;
+}
+
+static inline uint32_t _des_alloc(des_t *des) {
+    if (des->free == NIL) {
+        if (des->cap == MAX_EVENTS) {
+            fprintf(stderr, "des_error: More than %zu pending events\n", MAX_EVENTS);
+            abort();
+        }
+
+        _des_pool_grow(des, des->cap > MAX_EVENTS / 2 ? MAX_EVENTS : 2 * des->cap);
+    }
+
+    uint32_t e = des->free;
+    des->free = des->ev[e].next;
+    des->len++;
+    return e;
+}
+
+static inline void _des_release(des_t *des, uint32_t e) {
+    _des_event_t *x = &des->ev[e];
+
+    x->gen = x->gen + 1 ? x->gen + 1 : 1;
+    x->pos = FREE;
+    x->next = des->free;
+    des->free = e;
+    des->len--;
+}
+
+static inline int _des_before(const _des_entry_t *a, const _des_entry_t *b) {
+    return a->time < b->time || (a->time == b->time && a->seq < b->seq);
+}
+
+static inline void _des_place(des_t *des, size_t i, _des_entry_t x) {
+    des->heap[i] = x;
+    des->ev[x.ev].pos = (uint32_t)i;
+}
+
+#define ENTRY(des, i) (&(des)->heap[i])
+#define ENTRY_OF(x) (&(x))
+#define GET(des, i) ((des)->heap[i])
+
+DEFINE_DHEAP(_des_heap, des_t, _des_entry_t, ARITY, ENTRY, ENTRY_OF, _des_before, GET, _des_place)
+
+static inline size_t _des_bucket(const des_t *des, uint64_t time) {
+    return (time >> des->shift) & (des->nb - 1);
+}
+
+/* Inserts after the last event that is not later, scanning from the tail. */
+static void _des_link(des_t *des, uint32_t e) {
+    _des_event_t *ev = des->ev, *x = &ev[e];
+    size_t b = _des_bucket(des, x->time);
+    uint32_t after = des->tail[b];
+
+    while (after != NIL && (ev[after].time > x->time || (ev[after].time == x->time && ev[after].seq > x->seq)))
+        after = ev[after].prev;
+
+    x->prev = after;
+    x->next = after == NIL ? des->head[b] : ev[after].next;
+    x->pos = QUEUED;
+
+    if (x->next == NIL)
+        des->tail[b] = e;
+    else
+        ev[x->next].prev = e;
+
+    if (after == NIL)
+        des->head[b] = e;
+    else
+        ev[after].next = e;
+
+    uint64_t day = x->time >> des->shift;
+    if (!des->queued++ || day < des->day)
+        des->day = day;
+}
+
+static void _des_unlink(des_t *des, uint32_t e) {
+    _des_event_t *ev = des->ev, *x = &ev[e];
+    size_t b = _des_bucket(des, x->time);
+
+    if (x->prev == NIL)
+        des->head[b] = x->next;
+    else
+        ev[x->prev].next = x->next;
+
+    if (x->next == NIL)
+        des->tail[b] = x->prev;
+    else
+        ev[x->next].prev = x->prev;
+
+    des->queued--;
+}
+
+static uint32_t _des_cal_min(des_t *des) {
+    uint64_t day = des->day;
+    size_t mask = des->nb - 1;
+
+    for (size_t k = 0; k < des->nb; k++, day++) {
+        uint32_t e = des->head[day & mask];
+
+        if (e != NIL && des->ev[e].time >> des->shift == day) {
+            des->day = day;
+            return e;
+        }
+    }
+
+    uint32_t best = NIL;
+    for (size_t b = 0; b < des->nb; b++) {
+        uint32_t e = des->head[b];
+
+        if (e != NIL && (best == NIL || des->ev[e].time < des->ev[best].time))
+            best = e;
+    }
+
+    des->day = des->ev[best].time >> des->shift;
+    return best;
+}
+
+/*
+ * Moves the events to nb buckets as wide as three times the mean gap between the
+ * first CAL_SAMPLE of them, ignoring gaps over twice the mean (Brown, 1988), rounded
+ * up to a power of two.
+ */
+static void _des_resize(des_t *des, size_t nb) {
+    size_t n = des->queued, s = 0;
+    uint32_t *all = malloc((n ? n : 1) * sizeof(uint32_t));
+
+    while (s < n && s < CAL_SAMPLE) {
+        uint32_t e = _des_cal_min(des);
+        _des_unlink(des, e);
+        all[s++] = e;
+    }
+
+    for (size_t b = 0; b < des->nb; b++)
+        for (uint32_t e = des->head[b]; e != NIL; e = des->ev[e].next)
+            all[s++] = e;
+
+    size_t sample = n < CAL_SAMPLE ? n : CAL_SAMPLE;
+    if (sample > 1) {
+        uint64_t mean = (des->ev[all[sample - 1]].time - des->ev[all[0]].time) / (sample - 1), sum = 0, gaps = 0;
+
+        for (size_t i = 1; i < sample; i++) {
+            uint64_t gap = des->ev[all[i]].time - des->ev[all[i - 1]].time;
+
+            if (gap <= 2 * mean)
+                sum += gap, gaps++;
+        }
+
+        uint64_t width = sum / gaps;
+        /* Days longer than 2^63 would need a shift of 64. */
+        width = width > (1ull << 63) / 3 ? 1ull << 63 : 3 * width;
+        des->shift = width > 1 ? 64 - __builtin_clzll(width - 1) : 0;
+    }
+
+    des->nb = nb;
+    des->head = realloc(des->head, nb * sizeof(uint32_t));
+    des->tail = realloc(des->tail, nb * sizeof(uint32_t));
+    memset(des->head, 0xff, nb * sizeof(uint32_t));
+    memset(des->tail, 0xff, nb * sizeof(uint32_t));
+
+    des->queued = 0;
+    for (size_t i = 0; i < n; i++)
+        _des_link(des, all[i]);
+
+    free(all);
+}
+
+static inline uint32_t _des_top(des_t *des) {
+    return des->flags & DES_CALENDAR ? _des_cal_min(des) : des->heap[0].ev;
+}
+
+/* Takes an event off the list. */
+static void _des_take(des_t *des, uint32_t e) {
+    if (des->flags & DES_CALENDAR) {
+        _des_unlink(des, e);
+        if (des->nb > CAL_MIN && des->queued < des->nb / 2)
+            _des_resize(des, des->nb / 2);
+    } else {
+        _des_heap_fill(des, --des->queued, des->ev[e].pos);
+    }
+}
+
+des_t *des_create(size_t size, unsigned flags) {
+    if (flags & ~DES_CALENDAR) {
+        fprintf(stderr, "des_error: Unknown flags 0x%x\n", flags & ~DES_CALENDAR);
+        abort();
+    }
+
+    des_t *des_ptr = malloc(sizeof(des_t));
+    des_ptr->now = 0;
+    des_ptr->seq = 0;
+    des_ptr->len = 0;
+    des_ptr->queued = 0;
+    des_ptr->cap = 0;
+    des_ptr->flags = flags;
+    des_ptr->running = 0;
+    des_ptr->free = NIL;
+    des_ptr->ev = NULL;
+    des_ptr->heap = NULL;
+    des_ptr->head = des_ptr->tail = NULL;
+    des_ptr->nb = 0;
+    des_ptr->shift = 0;
+    des_ptr->day = 0;
+    des_ptr->batch = NULL;
+    des_ptr->batch_cap = 0;
+
+    _des_pool_grow(des_ptr, size < POOL_MIN ? POOL_MIN : size > MAX_EVENTS ? MAX_EVENTS : size);
+
+    if (flags & DES_CALENDAR)
+        _des_resize(des_ptr, CAL_MIN);
+
+    return des_ptr;
+}
+
+void des_destroy(des_t *des, void (*free_func)(void *)) {
+    if (free_func)
+        for (size_t i = 0; i < des->cap; i++)
+            if (des->ev[i].pos != FREE)
+                free_func(des->ev[i].arg);
+
+    free(des->ev);
+    free(des->heap);
+    free(des->head);
+    free(des->tail);
+    free(des->batch);
+    free(des);
+}
+
+des_id_t des_schedule(des_t *des, uint64_t time, des_handler_t fn, void *arg) {
+    if (!des) {
+        fprintf(stderr, "des_error: Trying to schedule in nullptr\n");
+        abort();
+    }
+
+    if (!fn) {
+        fprintf(stderr, "des_error: Trying to schedule an event without handler\n");
+        abort();
+    }
+
+    if (time < des->now) {
+        fprintf(stderr, "des_error: Event at %llu is before the current time %llu\n",
+                (unsigned long long)time, (unsigned long long)des->now);
+        abort();
+    }
+
+    uint32_t e = _des_alloc(des);
+    _des_event_t *x = &des->ev[e];
+
+    x->time = time;
+    x->seq = des->seq++;
+    x->fn = fn;
+    x->arg = arg;
+
+    if (des->flags & DES_CALENDAR) {
+        _des_link(des, e);
+        if (des->queued > 2 * des->nb)
+            _des_resize(des, 2 * des->nb);
+    } else {
+        _des_heap_sift_up(des, des->queued++, (_des_entry_t){time, x->seq, e});
+    }
+
+    return (des_id_t)des->ev[e].gen << 32 | e;
+}
+
+char des_cancel(des_t *des, des_id_t id) {
+    uint32_t e = (uint32_t)id;
+
+    if (!des || e >= des->cap || des->ev[e].gen != id >> 32 || des->ev[e].pos == FREE)
+        return 0;
+
+    if (des->ev[e].pos != BATCHED)
+        _des_take(des, e);
+
+    _des_release(des, e);
+    return 1;
+}
+
+size_t des_step(des_t *des) {
+    if (!des) {
+        fprintf(stderr, "des_error: Trying to step nullptr\n");
+        abort();
+    }
+
+    if (des->running) {
+        fprintf(stderr, "des_error: Trying to step from an event handler\n");
+        abort();
+    }
+
+    if (!des->queued)
+        return 0;
+
+    uint64_t time = des->ev[_des_top(des)].time;
+    size_t n = 0;
+
+    /* Take the whole timestamp off the list first: handlers see a consistent list. */
+    do {
+        uint32_t e = _des_top(des);
+        if (des->ev[e].time != time)
+            break;
+
+        _des_take(des, e);
+        des->ev[e].pos = BATCHED;
+
+        if (n == des->batch_cap) {
+            des->batch_cap = des->batch_cap ? 2 * des->batch_cap : POOL_MIN;
+            des->batch = realloc(des->batch, des->batch_cap * sizeof(_des_batch_t));
+        }
+        des->batch[n++] = (_des_batch_t){e, des->ev[e].gen};
+    } while (des->queued);
+
+    des->now = time;
+    des->running = 1;
+
+    size_t ran = 0;
+    for (size_t i = 0; i < n; i++) {
+        _des_batch_t b = des->batch[i];
+        _des_event_t *x = &des->ev[b.ev];
+
+        /* Cancelled by an earlier handler of the batch. */
+        if (x->gen != b.gen)
+            continue;
+
+        des_handler_t fn = x->fn;
+        void *arg = x->arg;
+
+        _des_release(des, b.ev);
+        fn(des, arg);
+        ran++;
+    }
+
+    des->running = 0;
+    return ran;
+}
+
+size_t des_run(des_t *des, uint64_t until) {
+    size_t ran = 0;
+
+    while (des_next(des) <= until && des->queued)
+        ran += des_step(des);
+
+    return ran;
+}
+
+uint64_t des_now(des_t *des) {
+    return des->now;
+}
+
+uint64_t des_next(des_t *des) {
+    if (!des) {
+        fprintf(stderr, "des_error: Trying to peek in nullptr\n");
+        abort();
+    }
+
+    return des->queued ? des->ev[_des_top(des)].time : DES_NEVER;
+}
+
+size_t des_len(des_t *des) {
+    return des->len;
+}
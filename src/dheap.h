@@ -0,0 +1,83 @@
+#ifndef DHEAP_H
+#define DHEAP_H
+
+#include <stddef.h>
+
+/*
+ * Sift loops of the d-ary heaps kept inside modules (des, graph, median, topk),
+ * generated once per heap layout. A heap is described by:
+ *
+ * - CTX: the type its functions take a pointer to,
+ * - ITEM: the type of an element moved in and out of the heap,
+ * - D: the arity, a power of two,
+ * - KEY(h, i) and ITEM_KEY(x): the key at heap index i and the key of an item,
+ * - LESS(a, b): whether key a belongs above key b,
+ * - GET(h, i): the item at heap index i,
+ * - PLACE(h, i, x): stores item x at heap index i, updating any back-pointer.
+ *
+ * The children of heap index i are D * i + 1 .. D * i + D. The item being sifted is
+ * held out of the heap and placed once, at its final index. Ties go to the first
+ * child, as with a plain scan.
+ */
+#define DEFINE_DHEAP(PREFIX, CTX, ITEM, D, KEY, ITEM_KEY, LESS, GET, PLACE) \
+    static inline void PREFIX##_sift_up(CTX *h, size_t i, ITEM x) { \
+        while (i > 0) { \
+            size_t up = (i - 1) / (D); \
+            if (!LESS(ITEM_KEY(x), KEY(h, up))) \
+                break; \
+            \
+            PLACE(h, i, GET(h, up)); \
+            i = up; \
+        } \
+        \
+        PLACE(h, i, x); \
+    } \
+    \
+    /* The first index of the smallest child group starting at c. A full group of four is a branchless tournament. */ \
+    static inline size_t PREFIX##_child(CTX *h, size_t len, size_t c) { \
+        if ((D) == 4 && c + 4 <= len) { \
+            size_t lo = c + LESS(KEY(h, c + 1), KEY(h, c)), hi = c + 2 + LESS(KEY(h, c + 3), KEY(h, c + 2)); \
+            return LESS(KEY(h, hi), KEY(h, lo)) ? hi : lo; \
+        } \
+        \
+        size_t best = c, end = c + (D) < len ? c + (D) : len; \
+        for (size_t j = c + 1; j < end; j++) \
+            if (LESS(KEY(h, j), KEY(h, best))) \
+                best = j; \
+        \
+        return best; \
+    } \
+    \
+    static inline void PREFIX##_sift_down(CTX *h, size_t len, size_t i, ITEM x) { \
+        size_t c; \
+        \
+        while ((c = (D) * i + 1) < len) { \
+            size_t best = PREFIX##_child(h, len, c); \
+            if (!LESS(KEY(h, best), ITEM_KEY(x))) \
+                break; \
+            \
+            PLACE(h, i, GET(h, best)); \
+            i = best; \
+        } \
+        \
+        PLACE(h, i, x); \
+    } \
+    \
+    static inline void PREFIX##_heapify(CTX *h, size_t len) { \
+        for (size_t i = len > 1 ? (len - 2) / (D) + 1 : 0; i-- > 0;) \
+            PREFIX##_sift_down(h, len, i, GET(h, i)); \
+    } \
+    \
+    /* Refills index i after the heap shrank to len items, with the item left at index len. */ \
+    static inline void PREFIX##_fill(CTX *h, size_t len, size_t i) { \
+        if (i == len) \
+            return; \
+        \
+        ITEM x = GET(h, len); \
+        if (i && LESS(ITEM_KEY(x), KEY(h, (i - 1) / (D)))) \
+            PREFIX##_sift_up(h, i, x); \
+        else \
+            PREFIX##_sift_down(h, len, i, x); \
+    }
+
+#endif
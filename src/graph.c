@@ -0,0 +1,616 @@
+#include "utils.h"
+#include "graph.h"
+#include "dheap.h"
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#define ARITY 4
+#define CACHE_LINE 64
+#define SETTLED UINT32_MAX
+#define MAX_THREADS 256
+#define LIST_MIN 64
+
+#define LOAD(p) __atomic_load_n(p, __ATOMIC_RELAXED)
+#define STORE(p, v) __atomic_store_n(p, v, __ATOMIC_RELAXED)
+
+/*
+ * `seen[v] == epoch` tells that `dist`, `parent` and `pos` of v were written by the
+ * current query, so starting a query only bumps `epoch`. `pos[v]` is v's index in
+ * the frontier, or SETTLED.
+ *
+ * The frontier is a 4-ary heap of nodes with their keys in a separate array, shifted
+ * by ARITY - 1 slots so that the keys of every sibling group share a cache line: the
+ * children of heap index i are keys[ARITY * (i + 1) .. ARITY * (i + 1) + ARITY - 1].
+ */
+struct _graph_search_t {
+    uint32_t            nodes;
+    uint32_t            epoch;
+    size_t              settled;
+    size_t              len;
+    uint64_t            *dist;
+    uint32_t            *parent;
+    uint32_t            *seen;
+    uint32_t            *pos;
+    uint64_t            *keys;
+    uint32_t            *heap;
+    struct _graph_par   *par;
+};
+
+typedef struct {
+    uint64_t            key;
+    uint32_t            v;
+} _graph_item_t;
+
+#define KEY(gs, i) ((gs)->keys[(i) + ARITY - 1])
+#define ITEM_KEY(x) ((x).key)
+#define LESS(a, b) ((a) < (b))
+#define GET(gs, i) ((_graph_item_t){KEY(gs, i), (gs)->heap[i]})
+
+static inline void _graph_place(graph_search_t *gs, size_t i, _graph_item_t x) {
+    KEY(gs, i) = x.key;
+    gs->heap[i] = x.v;
+    gs->pos[x.v] = (uint32_t)i;
+}
+
+DEFINE_DHEAP(_graph_frontier, graph_search_t, _graph_item_t, ARITY, KEY, ITEM_KEY, LESS, GET, _graph_place)
+
+static uint32_t _graph_pop(graph_search_t *gs) {
+    uint32_t top = gs->heap[0];
+
+    if (--gs->len)
+        _graph_frontier_sift_down(gs, gs->len, 0, GET(gs, gs->len));
+
+    gs->pos[top] = SETTLED;
+    return top;
+}
+
+static void _graph_begin(graph_search_t *gs, const graph_t *g, uint32_t source) {
+    if (!gs || !g) {
+        fprintf(stderr, "graph_error: Trying to search with nullptr\n");
+        abort();
+    }
+
+    if (g->nodes > gs->nodes) {
+        fprintf(stderr, "graph_error: Graph has %u nodes, the search was created for %u\n", g->nodes, gs->nodes);
+        abort();
+    }
+
+    if (source >= g->nodes) {
+        fprintf(stderr, "graph_error: Node %u is not in the graph\n", source);
+        abort();
+    }
+
+    if (!++gs->epoch) {
+        memset(gs->seen, 0, gs->nodes * sizeof(uint32_t));
+        gs->epoch = 1;
+    }
+
+    gs->settled = 0;
+    gs->len = 0;
+}
+
+static char _graph_search(graph_search_t *gs, const graph_t *g, uint32_t source, uint32_t target,
+                          uint64_t (*h)(uint32_t, void *), void *arg) {
+    _graph_begin(gs, g, source);
+
+    gs->seen[source] = gs->epoch;
+    gs->dist[source] = 0;
+    gs->parent[source] = GRAPH_NONE;
+    gs->len = 1;
+    _graph_place(gs, 0, (_graph_item_t){h ? h(source, arg) : 0, source});
+
+    while (gs->len) {
+        uint32_t v = _graph_pop(gs);
+        uint64_t d = gs->dist[v];
+
+        gs->settled++;
+        if (v == target)
+            return 1;
+
+        for (size_t e = g->offsets[v]; e < g->offsets[v + 1]; e++) {
+            uint32_t u = g->targets[e];
+            uint64_t nd = d + g->weights[e];
+
+            if (gs->seen[u] != gs->epoch) {
+                gs->seen[u] = gs->epoch;
+                gs->dist[u] = nd;
+                gs->parent[u] = v;
+                _graph_frontier_sift_up(gs, gs->len++, (_graph_item_t){nd + (h ? h(u, arg) : 0), u});
+            } else if (gs->pos[u] != SETTLED && nd < gs->dist[u]) {
+                size_t i = gs->pos[u];
+
+                /* The key is dist + h(u): keep the heuristic part, it does not change. */
+                _graph_frontier_sift_up(gs, i, (_graph_item_t){KEY(gs, i) - gs->dist[u] + nd, u});
+                gs->dist[u] = nd;
+                gs->parent[u] = v;
+            } else if (nd == gs->dist[u] && v < gs->parent[u] && gs->pos[u] != SETTLED) {
+                /* Ties go to the smallest predecessor, as in graph_delta_stepping(). */
+                gs->parent[u] = v;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Delta stepping.
+ *
+ * Nodes are owned by thread `node % threads`, and only the owner writes a node's
+ * `seen`, `dist`, `parent` and stamps. Tentative distances are kept in buckets of
+ * width `delta`, cyclic over `nb` slots since a relaxation never lands more than
+ * the heaviest edge past the current bucket. Every bucket is emptied in rounds:
+ * the frontier's light edges (weight <= delta) turn into requests, written to one
+ * buffer per owner and applied by the owners after a barrier, which may refill the
+ * frontier of the same bucket. Once the bucket stays empty, the heavy edges of all
+ * nodes it held are relaxed the same way, then every thread moves to the smallest
+ * non-empty bucket of any owner. Readers of other owners' distances only filter
+ * requests, a stale (larger) value never drops one.
+ *
+ * Requests are also sent when they tie the best distance so that owners can keep the
+ * smallest predecessor, which matches the parents of graph_dijkstra() on graphs with
+ * positive weights. Zero weight edges only send improvements.
+ */
+typedef struct {
+    uint32_t            node;
+    uint32_t            from;
+    uint64_t            dist;
+} _graph_req_t;
+
+typedef struct {
+    size_t              len;
+    size_t              cap;
+    void                *items;
+} _graph_list_t;
+
+typedef struct {
+    pthread_mutex_t     lock;
+    pthread_cond_t      cond;
+    unsigned            threads;
+    unsigned            waiting;
+    unsigned            round;
+} _graph_barrier_t;
+
+typedef struct {
+    _graph_list_t       *out;
+    _graph_list_t       *buckets;
+    size_t              nb;
+    size_t              nb_cap;
+    _graph_list_t       front;
+    _graph_list_t       next;
+    _graph_list_t       removed;
+    size_t              count;
+    size_t              expanded;
+    uint64_t            min_bucket;
+    uint64_t            max_weight;
+    uint64_t            sum_weight;
+    pthread_t           thread;
+} _graph_worker_t;
+
+struct _graph_par {
+    unsigned            threads;
+    _graph_worker_t     *workers;
+    uint32_t            *mark;
+    uint32_t            *removed_mark;
+    _graph_barrier_t    barrier;
+    graph_search_t      *gs;
+    const graph_t       *g;
+    uint32_t            source;
+    uint64_t            delta;
+};
+
+typedef struct {
+    struct _graph_par   *par;
+    unsigned            id;
+} _graph_arg_t;
+
+/* pthread_barrier_t is optional in POSIX and missing on macOS. */
+static void _graph_wait(_graph_barrier_t *b) {
+    pthread_mutex_lock(&b->lock);
+
+    unsigned round = b->round;
+    if (++b->waiting == b->threads) {
+        b->waiting = 0;
+        b->round++;
+        pthread_cond_broadcast(&b->cond);
+    } else {
+        while (round == b->round)
+            pthread_cond_wait(&b->cond, &b->lock);
+    }
+
+    pthread_mutex_unlock(&b->lock);
+}
+
+static inline void _graph_list_push(_graph_list_t *l, const void *item, size_t size) {
+    if (l->len == l->cap) {
+        l->cap = l->cap ? 2 * l->cap : LIST_MIN;
+        l->items = realloc(l->items, l->cap * size);
+    }
+
+    memcpy((char *)l->items + l->len++ * size, item, size);
+}
+
+static void _graph_par_free(struct _graph_par *par) {
+    if (!par)
+        return;
+
+    for (unsigned t = 0; t < par->threads; t++) {
+        _graph_worker_t *w = &par->workers[t];
+
+        for (unsigned o = 0; o < par->threads; o++)
+            free(w->out[o].items);
+        for (size_t b = 0; b < w->nb_cap; b++)
+            free(w->buckets[b].items);
+
+        free(w->out);
+        free(w->buckets);
+        free(w->front.items);
+        free(w->next.items);
+        free(w->removed.items);
+    }
+
+    free(par->workers);
+    free(par->mark);
+    free(par->removed_mark);
+    free(par);
+}
+
+static struct _graph_par *_graph_par_get(graph_search_t *gs, unsigned threads) {
+    if (gs->par && gs->par->threads == threads)
+        return gs->par;
+
+    _graph_par_free(gs->par);
+
+    struct _graph_par *par = malloc(sizeof(struct _graph_par));
+    par->threads = threads;
+    par->workers = calloc(threads, sizeof(_graph_worker_t));
+    par->mark = malloc((gs->nodes ? gs->nodes : 1) * sizeof(uint32_t));
+    par->removed_mark = malloc((gs->nodes ? gs->nodes : 1) * sizeof(uint32_t));
+
+    for (unsigned t = 0; t < threads; t++)
+        par->workers[t].out = calloc(threads, sizeof(_graph_list_t));
+
+    gs->par = par;
+    return par;
+}
+
+/* Applies the requests sent to this owner, queueing the nodes they improved. */
+static void _graph_apply(struct _graph_par *par, unsigned id, uint64_t delta, uint64_t bucket, uint32_t stamp) {
+    graph_search_t *gs = par->gs;
+    _graph_worker_t *self = &par->workers[id];
+    uint32_t epoch = gs->epoch;
+    size_t nb = self->nb;
+
+    for (unsigned s = 0; s < par->threads; s++) {
+        const _graph_list_t *in = &par->workers[s].out[id];
+        const _graph_req_t *r = in->items;
+
+        for (size_t k = 0; k < in->len; k++, r++) {
+            uint32_t u = r->node;
+
+            if (gs->seen[u] == epoch && r->dist >= gs->dist[u]) {
+                if (r->dist == gs->dist[u] && r->from < gs->parent[u])
+                    gs->parent[u] = r->from;
+                continue;
+            }
+
+            STORE(&gs->dist[u], r->dist);
+            STORE(&gs->seen[u], epoch);
+            gs->parent[u] = r->from;
+
+            uint64_t b = r->dist / delta;
+            if (b != bucket)
+                _graph_list_push(&self->buckets[b % nb], &u, sizeof(uint32_t));
+            else if (par->mark[u] != stamp) {
+                par->mark[u] = stamp;
+                _graph_list_push(&self->next, &u, sizeof(uint32_t));
+            }
+        }
+    }
+}
+
+/* Turns the edges of `nodes` with weights in [lo, hi] into requests to their owners. */
+static void _graph_request(struct _graph_par *par, unsigned id, const _graph_list_t *nodes, uint64_t lo, uint64_t hi) {
+    const graph_t *g = par->g;
+    graph_search_t *gs = par->gs;
+    _graph_worker_t *self = &par->workers[id];
+    const uint32_t *v = nodes->items;
+    uint32_t epoch = gs->epoch;
+
+    for (unsigned o = 0; o < par->threads; o++)
+        self->out[o].len = 0;
+
+    for (size_t k = 0; k < nodes->len; k++) {
+        uint64_t d = gs->dist[v[k]];
+
+        for (size_t e = g->offsets[v[k]]; e < g->offsets[v[k] + 1]; e++) {
+            uint64_t w = g->weights[e];
+            if (w < lo || w > hi)
+                continue;
+
+            uint32_t u = g->targets[e];
+            _graph_req_t r = {u, v[k], d + w};
+
+            /* Zero weight ties would let two nodes take each other as parent. */
+            if (LOAD(&gs->seen[u]) != epoch || r.dist + !w <= LOAD(&gs->dist[u]))
+                _graph_list_push(&self->out[u % par->threads], &r, sizeof(_graph_req_t));
+        }
+    }
+}
+
+static void *_graph_worker(void *arg) {
+    struct _graph_par *par = ((_graph_arg_t *)arg)->par;
+    unsigned id = ((_graph_arg_t *)arg)->id, threads = par->threads;
+    _graph_worker_t *self = &par->workers[id];
+    const graph_t *g = par->g;
+    graph_search_t *gs = par->gs;
+    size_t lo = (size_t)g->nodes * id / threads, hi = (size_t)g->nodes * (id + 1) / threads;
+    uint64_t max_weight = 0, sum_weight = 0;
+
+    /* Stamps restart with every query: clear this thread's share of them. */
+    memset(par->mark + lo, 0, (hi - lo) * sizeof(uint32_t));
+    memset(par->removed_mark + lo, 0, (hi - lo) * sizeof(uint32_t));
+
+    for (size_t e = g->offsets[lo]; e < g->offsets[hi]; e++) {
+        max_weight = g->weights[e] > max_weight ? g->weights[e] : max_weight;
+        sum_weight += g->weights[e];
+    }
+
+    self->max_weight = max_weight;
+    self->sum_weight = sum_weight;
+    _graph_wait(&par->barrier);
+
+    max_weight = sum_weight = 0;
+    for (unsigned t = 0; t < threads; t++) {
+        max_weight = par->workers[t].max_weight > max_weight ? par->workers[t].max_weight : max_weight;
+        sum_weight += par->workers[t].sum_weight;
+    }
+
+    /* Without a given width, buckets are as wide as the mean edge. */
+    uint64_t delta = par->delta;
+    if (!delta) {
+        size_t edges = g->offsets[g->nodes];
+        delta = edges ? (sum_weight + edges - 1) / edges : 1;
+        delta = delta ? delta : 1;
+    }
+
+    size_t nb = max_weight / delta + 2;
+    if (nb > self->nb_cap) {
+        self->buckets = realloc(self->buckets, nb * sizeof(_graph_list_t));
+        memset(self->buckets + self->nb_cap, 0, (nb - self->nb_cap) * sizeof(_graph_list_t));
+        self->nb_cap = nb;
+    }
+
+    for (size_t b = 0; b < nb; b++)
+        self->buckets[b].len = 0;
+
+    self->nb = nb;
+    self->expanded = 0;
+    self->front.len = self->next.len = self->removed.len = 0;
+
+    if (par->source % threads == id) {
+        uint32_t u = par->source;
+
+        STORE(&gs->dist[u], 0);
+        STORE(&gs->seen[u], gs->epoch);
+        gs->parent[u] = GRAPH_NONE;
+        _graph_list_push(&self->buckets[0], &u, sizeof(uint32_t));
+    }
+
+    uint64_t bucket = 0;
+    uint32_t stamp = 0;
+
+    for (;;) {
+        /* Smallest non-empty bucket of this owner, then of all owners. */
+        self->min_bucket = UINT64_MAX;
+        for (size_t k = 0; k < nb; k++) {
+            if (self->buckets[(bucket + k) % nb].len) {
+                self->min_bucket = bucket + k;
+                break;
+            }
+        }
+
+        _graph_wait(&par->barrier);
+
+        bucket = UINT64_MAX;
+        for (unsigned t = 0; t < threads; t++)
+            bucket = par->workers[t].min_bucket < bucket ? par->workers[t].min_bucket : bucket;
+
+        if (bucket == UINT64_MAX)
+            break;
+
+        uint32_t removed_stamp = ++stamp;
+        _graph_list_t *slot = &self->buckets[bucket % nb];
+        const uint32_t *held = slot->items;
+
+        /* Entries whose distance improved into another bucket since are stale. */
+        stamp++;
+        self->front.len = 0;
+        for (size_t k = 0; k < slot->len; k++) {
+            uint32_t u = held[k];
+
+            if (gs->dist[u] / delta == bucket && par->mark[u] != stamp) {
+                par->mark[u] = stamp;
+                _graph_list_push(&self->front, &u, sizeof(uint32_t));
+            }
+        }
+        slot->len = 0;
+
+        for (;;) {
+            const uint32_t *v = self->front.items;
+
+            for (size_t k = 0; k < self->front.len; k++) {
+                if (par->removed_mark[v[k]] != removed_stamp) {
+                    par->removed_mark[v[k]] = removed_stamp;
+                    _graph_list_push(&self->removed, &v[k], sizeof(uint32_t));
+                }
+            }
+
+            self->expanded += self->front.len;
+            _graph_request(par, id, &self->front, 0, delta);
+            _graph_wait(&par->barrier);
+
+            self->next.len = 0;
+            _graph_apply(par, id, delta, bucket, ++stamp);
+
+            _graph_list_t swap = self->front;
+            self->front = self->next;
+            self->next = swap;
+            self->count = self->front.len;
+            _graph_wait(&par->barrier);
+
+            size_t total = 0;
+            for (unsigned t = 0; t < threads; t++)
+                total += par->workers[t].count;
+
+            if (!total)
+                break;
+        }
+
+        /* Distances in this bucket are final: relax the heavy edges once. */
+        _graph_request(par, id, &self->removed, delta + 1, UINT64_MAX);
+        _graph_wait(&par->barrier);
+
+        _graph_apply(par, id, delta, bucket, ++stamp);
+        self->removed.len = 0;
+    }
+
+    return NULL;
+}
+
+graph_search_t *graph_search_create(uint32_t nodes) {
+    if (nodes == GRAPH_NONE) {
+        fprintf(stderr, "graph_error: A graph holds fewer than %u nodes\n", GRAPH_NONE);
+        abort();
+    }
+
+    size_t n = nodes ? nodes : 1;
+    size_t bytes = ((n + ARITY - 1) * sizeof(uint64_t) + CACHE_LINE - 1) & ~(size_t)(CACHE_LINE - 1);
+
+    graph_search_t *gs = malloc(sizeof(graph_search_t));
+    gs->nodes = nodes;
+    gs->epoch = 0;
+    gs->settled = 0;
+    gs->len = 0;
+    gs->dist = malloc(n * sizeof(uint64_t));
+    gs->parent = malloc(n * sizeof(uint32_t));
+    gs->seen = calloc(n, sizeof(uint32_t));
+    gs->pos = malloc(n * sizeof(uint32_t));
+    gs->heap = malloc(n * sizeof(uint32_t));
+    gs->keys = aligned_alloc(CACHE_LINE, bytes);
+    gs->par = NULL;
+
+    return gs;
+}
+
+void graph_search_destroy(graph_search_t *gs) {
+    free(gs->dist);
+    free(gs->parent);
+    free(gs->seen);
+    free(gs->pos);
+    free(gs->heap);
+    free(gs->keys);
+    _graph_par_free(gs->par);
+    free(gs);
+}
+
+void graph_dijkstra(graph_search_t *gs, const graph_t *g, uint32_t source) {
+    _graph_search(gs, g, source, GRAPH_NONE, NULL, NULL);
+}
+
+char graph_astar(graph_search_t *gs, const graph_t *g, uint32_t source, uint32_t target,
+                 uint64_t (*h)(uint32_t node, void *arg), void *arg) {
+    if (g && target >= g->nodes) {
+        fprintf(stderr, "graph_error: Node %u is not in the graph\n", target);
+        abort();
+    }
+
+    return _graph_search(gs, g, source, target, h, arg);
+}
+
+void graph_delta_stepping(graph_search_t *gs, const graph_t *g, uint32_t source, uint64_t delta, unsigned threads) {
+    _graph_begin(gs, g, source);
+
+    if (!threads) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = online > 0 ? (unsigned)online : 1;
+    }
+
+    threads = threads < MAX_THREADS ? threads : MAX_THREADS;
+
+    struct _graph_par *par = _graph_par_get(gs, threads);
+    _graph_arg_t args[MAX_THREADS];
+
+    par->gs = gs;
+    par->g = g;
+    par->source = source;
+    par->delta = delta;
+    par->barrier = (_graph_barrier_t){PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, threads, 0, 0};
+
+    for (unsigned t = 0; t < threads; t++)
+        args[t] = (_graph_arg_t){par, t};
+
+    for (unsigned t = 1; t < threads; t++) {
+        if (pthread_create(&par->workers[t].thread, NULL, _graph_worker, &args[t])) {
+            fprintf(stderr, "graph_error: Could not start thread %u of %u\n", t, threads);
+            abort();
+        }
+    }
+
+    _graph_worker(&args[0]);
+
+    for (unsigned t = 1; t < threads; t++)
+        pthread_join(par->workers[t].thread, NULL);
+
+    for (unsigned t = 0; t < threads; t++)
+        gs->settled += par->workers[t].expanded;
+}
+
+uint64_t graph_dist(graph_search_t *gs, uint32_t node) {
+    if (!gs) {
+        fprintf(stderr, "graph_error: Trying to read distance from nullptr\n");
+        abort();
+    }
+
+    return node < gs->nodes && gs->seen[node] == gs->epoch ? gs->dist[node] : GRAPH_INF;
+}
+
+uint32_t graph_parent(graph_search_t *gs, uint32_t node) {
+    if (!gs) {
+        fprintf(stderr, "graph_error: Trying to read parent from nullptr\n");
+        abort();
+    }
+
+    return node < gs->nodes && gs->seen[node] == gs->epoch ? gs->parent[node] : GRAPH_NONE;
+}
+
+size_t graph_path(graph_search_t *gs, uint32_t node, uint32_t *out, size_t cap) {
+    if (graph_dist(gs, node) == GRAPH_INF)
+        return 0;
+
+    size_t len = 0;
+    for (uint32_t v = node; v != GRAPH_NONE; v = gs->parent[v])
+        len++;
+
+    if (out) {
+        size_t i = len;
+        for (uint32_t v = node; v != GRAPH_NONE; v = gs->parent[v])
+            if (--i < cap)
+                out[i] = v;
+    }
+
+    return len;
+}
+
+size_t graph_settled(graph_search_t *gs) {
+    if (!gs) {
+        fprintf(stderr, "graph_error: Trying to get settled count from nullptr\n");
+        abort();
+    }
+
+    return gs->settled;
+}
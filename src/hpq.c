@@ -0,0 +1,261 @@
+#include "utils.h"
+#include "hpq.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define EMPTY SIZE_MAX
+#define UP(i) (((i) - 1) >> 1)
+#define LEFT(i) (2 * (i) + 1)
+
+typedef struct {
+    uint64_t            prio;
+    uint64_t            hash;
+    void                *key;
+    size_t              slot;
+} _hpq_entry_t;
+
+/*
+ * `heap` is a binary min-heap on prio. `index` is a linear probing table, at most
+ * half full, holding the heap position of every key; each entry remembers its slot
+ * so that moving it in the heap only rewrites that slot.
+ */
+struct _hpq_t {
+    size_t              len;
+    size_t              size;
+    size_t              mask;
+    uint64_t            (*hash)(const void *);
+    int                 (*equal)(const void *, const void *);
+    _hpq_entry_t        *heap;
+    size_t              *index;
+};
+
+static inline void _hpq_place(hpq_t *hpq, size_t pos, const _hpq_entry_t *e) {
+    hpq->heap[pos] = *e;
+    hpq->index[e->slot] = pos;
+}
+
+static void _hpq_sift_up(hpq_t *hpq, size_t pos) {
+    _hpq_entry_t e = hpq->heap[pos];
+
+    while (pos > 0 && e.prio < hpq->heap[UP(pos)].prio) {
+        _hpq_place(hpq, pos, &hpq->heap[UP(pos)]);
+        pos = UP(pos);
+    }
+
+    _hpq_place(hpq, pos, &e);
+}
+
+static void _hpq_sift_down(hpq_t *hpq, size_t pos) {
+    _hpq_entry_t e = hpq->heap[pos];
+    size_t c;
+
+    while ((c = LEFT(pos)) < hpq->len) {
+        c += c + 1 < hpq->len && hpq->heap[c + 1].prio < hpq->heap[c].prio;
+        if (hpq->heap[c].prio >= e.prio)
+            break;
+
+        _hpq_place(hpq, pos, &hpq->heap[c]);
+        pos = c;
+    }
+
+    _hpq_place(hpq, pos, &e);
+}
+
+/* Slot holding `key`, or the empty slot where it would go. */
+static size_t _hpq_find(hpq_t *hpq, const void *key, uint64_t h) {
+    size_t i = h & hpq->mask;
+
+    for (; hpq->index[i] != EMPTY; i = (i + 1) & hpq->mask) {
+        const _hpq_entry_t *e = &hpq->heap[hpq->index[i]];
+        if (e->hash == h && hpq->equal(e->key, key))
+            break;
+    }
+
+    return i;
+}
+
+/* Backward shift deletion: pulls later entries of the probe run into the hole. */
+static void _hpq_unindex(hpq_t *hpq, size_t i) {
+    for (size_t j = (i + 1) & hpq->mask; hpq->index[j] != EMPTY; j = (j + 1) & hpq->mask) {
+        size_t home = hpq->heap[hpq->index[j]].hash & hpq->mask;
+
+        /* Entry j may move to i only if its home is not within (i, j]. */
+        if (((j - home) & hpq->mask) >= ((j - i) & hpq->mask)) {
+            hpq->index[i] = hpq->index[j];
+            hpq->heap[hpq->index[i]].slot = i;
+            i = j;
+        }
+    }
+
+    hpq->index[i] = EMPTY;
+}
+
+/* Removes the entry at heap position pos and returns its key. */
+static void *_hpq_take(hpq_t *hpq, size_t pos) {
+    _hpq_entry_t e = hpq->heap[pos];
+
+    _hpq_unindex(hpq, e.slot);
+
+    if (pos != --hpq->len) {
+        _hpq_place(hpq, pos, &hpq->heap[hpq->len]);
+        if (pos > 0 && hpq->heap[pos].prio < hpq->heap[UP(pos)].prio)
+            _hpq_sift_up(hpq, pos);
+        else
+            _hpq_sift_down(hpq, pos);
+    }
+
+    return e.key;
+}
+
+hpq_t *hpq_create(size_t size, uint64_t (*hash)(const void *), int (*equal)(const void *, const void *)) {
+    if (!hash || !equal) {
+        fprintf(stderr, "hpq_error: Hash and equality functions must not be nullptr\n");
+        abort();
+    }
+
+    size_t slots = 8;
+    while (slots < 2 * size)
+        slots <<= 1;
+
+    hpq_t *hpq_ptr = malloc(sizeof(hpq_t));
+    hpq_ptr->len = 0;
+    hpq_ptr->size = size;
+    hpq_ptr->mask = slots - 1;
+    hpq_ptr->hash = hash;
+    hpq_ptr->equal = equal;
+    hpq_ptr->heap = malloc((size ? size : 1) * sizeof(_hpq_entry_t));
+    hpq_ptr->index = malloc(slots * sizeof(size_t));
+
+    for (size_t i = 0; i < slots; i++)
+        hpq_ptr->index[i] = EMPTY;
+
+    return hpq_ptr;
+}
+
+void hpq_destroy(hpq_t *hpq, void (*free_func)(void *)) {
+    if (free_func)
+        for (size_t i = 0; i < hpq->len; i++)
+            free_func(hpq->heap[i].key);
+
+    free(hpq->heap);
+    free(hpq->index);
+    free(hpq);
+}
+
+char hpq_upsert(hpq_t *hpq, void *key, uint64_t prio) {
+    if (!hpq) {
+        fprintf(stderr, "hpq_error: Trying to insert to nullptr\n");
+        abort();
+    }
+
+    uint64_t h = hpq->hash(key);
+    size_t slot = _hpq_find(hpq, key, h);
+
+    if (hpq->index[slot] != EMPTY) {
+        size_t pos = hpq->index[slot];
+        uint64_t old = hpq->heap[pos].prio;
+
+        hpq->heap[pos].prio = prio;
+        if (prio < old)
+            _hpq_sift_up(hpq, pos);
+        else if (prio > old)
+            _hpq_sift_down(hpq, pos);
+
+        return 0;
+    }
+
+    if (hpq->len + 1 > hpq->size) {
+        fprintf(stderr, "hpq_error: New length %zu is greater than hpq size %zu\n", hpq->len + 1, hpq->size);
+        abort();
+    }
+
+    hpq->heap[hpq->len] = (_hpq_entry_t){prio, h, key, slot};
+    hpq->index[slot] = hpq->len;
+    _hpq_sift_up(hpq, hpq->len++);
+
+    return 1;
+}
+
+char hpq_contains(hpq_t *hpq, const void *key, uint64_t *prio) {
+    if (!hpq) {
+        fprintf(stderr, "hpq_error: Trying to search in nullptr\n");
+        abort();
+    }
+
+    size_t pos = hpq->index[_hpq_find(hpq, key, hpq->hash(key))];
+    if (pos == EMPTY)
+        return 0;
+
+    if (prio)
+        *prio = hpq->heap[pos].prio;
+
+    return 1;
+}
+
+void *hpq_erase(hpq_t *hpq, const void *key) {
+    if (!hpq) {
+        fprintf(stderr, "hpq_error: Trying to erase from nullptr\n");
+        abort();
+    }
+
+    size_t pos = hpq->index[_hpq_find(hpq, key, hpq->hash(key))];
+
+    return pos == EMPTY ? NULL : _hpq_take(hpq, pos);
+}
+
+char hpq_is_empty(hpq_t *hpq) {
+    return !hpq->len;
+}
+
+void *hpq_peek(hpq_t *hpq, uint64_t *prio) {
+    if (!hpq) {
+        fprintf(stderr, "hpq_error: Trying to peek in nullptr\n");
+        abort();
+    }
+
+    if (!hpq->len) {
+        fprintf(stderr, "hpq_error: Trying to access element in empty hpq\n");
+        abort();
+    }
+
+    if (prio)
+        *prio = hpq->heap[0].prio;
+
+    return hpq->heap[0].key;
+}
+
+void *hpq_remove(hpq_t *hpq, uint64_t *prio) {
+    if (!hpq) {
+        fprintf(stderr, "hpq_error: Trying to remove from nullptr\n");
+        abort();
+    }
+
+    if (!hpq->len) {
+        fprintf(stderr, "hpq_error: Trying to remove element from empty hpq\n");
+        abort();
+    }
+
+    if (prio)
+        *prio = hpq->heap[0].prio;
+
+    return _hpq_take(hpq, 0);
+}
+
+size_t hpq_len(hpq_t *hpq) {
+    if (!hpq) {
+        fprintf(stderr, "hpq_error: Trying to get len from nullptr\n");
+        abort();
+    }
+
+    return hpq->len;
+}
+
+size_t hpq_size(hpq_t *hpq) {
+    if (!hpq) {
+        fprintf(stderr, "hpq_error: Trying to get size from nullptr\n");
+        abort();
+    }
+
+    return hpq->size;
+}
@@ -0,0 +1,188 @@
+#include "kern.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define KERN_X86 1
+#endif
+
+#define ALWAYS_INLINE inline __attribute__((always_inline))
+
+static ALWAYS_INLINE size_t _argmin_scalar(const uint64_t *keys, size_t n) {
+    size_t m = 0;
+    for (size_t i = 1; i < n; i++)
+        m = keys[i] < keys[m] ? i : m;
+    return m;
+}
+
+/*
+ * Generic heap loops. They are always inlined into the per-ISA entry points
+ * below, so the child selection they are given is inlined with the right target.
+ */
+static ALWAYS_INLINE void _sift_down(uint64_t *keys, void **vals, size_t len, size_t d, size_t i,
+                                     size_t (*argmin)(const uint64_t *, size_t)) {
+    uint64_t x = keys[i];
+    void *v = vals[i];
+    size_t c;
+
+    while ((c = d * i + 1) < len) {
+        size_t m = c + argmin(keys + c, len - c < d ? len - c : d);
+        if (keys[m] >= x)
+            break;
+
+        keys[i] = keys[m];
+        vals[i] = vals[m];
+        i = m;
+    }
+
+    keys[i] = x;
+    vals[i] = v;
+}
+
+#define DEFINE_HEAP(SUFFIX, TARGET, ARGMIN) \
+    TARGET static void _sift_down_##SUFFIX(uint64_t *keys, void **vals, size_t len, size_t d, size_t i) { \
+        _sift_down(keys, vals, len, d, i, ARGMIN); \
+    } \
+    TARGET static void _heapify_##SUFFIX(uint64_t *keys, void **vals, size_t len, size_t d) { \
+        for (size_t i = len > 1 ? (len - 2) / d + 1 : 0; i-- > 0;) \
+            _sift_down(keys, vals, len, d, i, ARGMIN); \
+    }
+
+static size_t _argmin_u64_scalar(const uint64_t *keys, size_t n) {
+    return _argmin_scalar(keys, n);
+}
+
+static size_t _count_lt_u64_scalar(const uint64_t *keys, size_t n, uint64_t x) {
+    size_t c = 0;
+    for (size_t i = 0; i < n; i++)
+        c += keys[i] < x;
+    return c;
+}
+
+DEFINE_HEAP(scalar, , _argmin_scalar)
+
+static const kern_t _kern_scalar = {
+    "scalar", _argmin_u64_scalar, _count_lt_u64_scalar, _sift_down_scalar, _heapify_scalar,
+};
+
+#ifdef KERN_X86
+#define AVX2 __attribute__((target("avx2")))
+#define AVX512 __attribute__((target("avx512f,avx512vl")))
+
+/* AVX2 only has signed 64-bit compares: flip the sign bit to compare unsigned. */
+AVX2 static inline __m256i _min_epu64_avx2(__m256i a, __m256i b) {
+    const __m256i bias = _mm256_set1_epi64x((long long)0x8000000000000000ULL);
+    __m256i gt = _mm256_cmpgt_epi64(_mm256_xor_si256(a, bias), _mm256_xor_si256(b, bias));
+    return _mm256_blendv_epi8(a, b, gt);
+}
+
+/* A single 4-wide group is not worth the two passes, the scalar loop wins there. */
+AVX2 static ALWAYS_INLINE size_t _argmin_avx2(const uint64_t *keys, size_t n) {
+    if (n < 8 || n & 3)
+        return _argmin_scalar(keys, n);
+
+    __m256i m = _mm256_loadu_si256((const __m256i *)keys);
+    for (size_t i = 4; i < n; i += 4)
+        m = _min_epu64_avx2(m, _mm256_loadu_si256((const __m256i *)(keys + i)));
+
+    m = _min_epu64_avx2(m, _mm256_permute4x64_epi64(m, _MM_SHUFFLE(2, 3, 0, 1)));
+    m = _min_epu64_avx2(m, _mm256_permute4x64_epi64(m, _MM_SHUFFLE(1, 0, 3, 2)));
+
+    for (size_t i = 0;; i += 4) {
+        __m256i eq = _mm256_cmpeq_epi64(m, _mm256_loadu_si256((const __m256i *)(keys + i)));
+        unsigned mask = (unsigned)_mm256_movemask_pd(_mm256_castsi256_pd(eq));
+        if (mask)
+            return i + __builtin_ctz(mask);
+    }
+}
+
+AVX2 static size_t _argmin_u64_avx2(const uint64_t *keys, size_t n) {
+    return _argmin_avx2(keys, n);
+}
+
+AVX2 static size_t _count_lt_u64_avx2(const uint64_t *keys, size_t n, uint64_t x) {
+    const __m256i bias = _mm256_set1_epi64x((long long)0x8000000000000000ULL);
+    __m256i vx = _mm256_xor_si256(_mm256_set1_epi64x((long long)x), bias);
+    size_t c = 0, i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        __m256i k = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(keys + i)), bias);
+        c += __builtin_popcount((unsigned)_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(vx, k))));
+    }
+    for (; i < n; i++)
+        c += keys[i] < x;
+
+    return c;
+}
+
+DEFINE_HEAP(avx2, AVX2, _argmin_avx2)
+
+static const kern_t _kern_avx2 = {
+    "avx2", _argmin_u64_avx2, _count_lt_u64_avx2, _sift_down_avx2, _heapify_avx2,
+};
+
+AVX512 static ALWAYS_INLINE size_t _argmin_avx512(const uint64_t *keys, size_t n) {
+    if (n < 8)
+        return _argmin_scalar(keys, n);
+
+    __m512i m = _mm512_set1_epi64(-1);
+    for (size_t i = 0; i < n; i += 8) {
+        __mmask8 live = n - i >= 8 ? 0xff : (__mmask8)((1u << (n - i)) - 1);
+        m = _mm512_min_epu64(m, _mm512_mask_loadu_epi64(_mm512_set1_epi64(-1), live, keys + i));
+    }
+
+    __m512i min = _mm512_set1_epi64((long long)_mm512_reduce_min_epu64(m));
+    for (size_t i = 0;; i += 8) {
+        __mmask8 live = n - i >= 8 ? 0xff : (__mmask8)((1u << (n - i)) - 1);
+        __mmask8 eq = _mm512_mask_cmpeq_epu64_mask(live, min, _mm512_maskz_loadu_epi64(live, keys + i));
+        if (eq)
+            return i + __builtin_ctz(eq);
+    }
+}
+
+AVX512 static size_t _argmin_u64_avx512(const uint64_t *keys, size_t n) {
+    return _argmin_avx512(keys, n);
+}
+
+AVX512 static size_t _count_lt_u64_avx512(const uint64_t *keys, size_t n, uint64_t x) {
+    __m512i vx = _mm512_set1_epi64((long long)x);
+    size_t c = 0, i = 0;
+
+    for (; i + 8 <= n; i += 8)
+        c += __builtin_popcount(_mm512_cmplt_epu64_mask(_mm512_loadu_si512(keys + i), vx));
+    if (i < n) {
+        __mmask8 live = (__mmask8)((1u << (n - i)) - 1);
+        c += __builtin_popcount(_mm512_mask_cmplt_epu64_mask(live, _mm512_maskz_loadu_epi64(live, keys + i), vx));
+    }
+
+    return c;
+}
+
+DEFINE_HEAP(avx512, AVX512, _argmin_avx512)
+
+static const kern_t _kern_avx512 = {
+    "avx512", _argmin_u64_avx512, _count_lt_u64_avx512, _sift_down_avx512, _heapify_avx512,
+};
+#endif
+
+const kern_t *_kern = &_kern_scalar;
+
+__attribute__((constructor)) static void _kern_select(void) {
+    const char *force = getenv("GUILIB_ISA");
+    (void)force;
+
+#ifdef KERN_X86
+    __builtin_cpu_init();
+
+    int avx2 = __builtin_cpu_supports("avx2");
+    int avx512 = avx2 && __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl");
+
+    if (force && !strcmp(force, "scalar"))
+        avx2 = avx512 = 0;
+    else if (force && !strcmp(force, "avx2"))
+        avx512 = 0;
+
+    _kern = avx512 ? &_kern_avx512 : avx2 ? &_kern_avx2 : &_kern_scalar;
+#endif
+}
@@ -0,0 +1,32 @@
+#ifndef KERN_H
+#define KERN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Hot kernels over 64-bit keys, built once per instruction set and chosen at
+ * load time from CPUID. Setting GUILIB_ISA=scalar (or avx2, avx512) in the
+ * environment forces a variant; requests the CPU cannot run fall back to the
+ * best supported one.
+ *
+ * Keyed d-ary heaps keep their keys in a separate array shifted by d - 1 slots,
+ * so that the children of every node start on a d-aligned index: the children
+ * of heap index i are keys[d * (i + 1) .. d * (i + 1) + d - 1].
+ */
+
+typedef struct {
+    const char          *isa;
+    /* Index of the smallest of keys[0 .. n - 1], first one on ties. n > 0. */
+    size_t              (*argmin_u64)(const uint64_t *keys, size_t n);
+    /* Number of keys[0 .. n - 1] strictly smaller than x. */
+    size_t              (*count_lt_u64)(const uint64_t *keys, size_t n, uint64_t x);
+    /* Sifts heap index i of a d-ary heap of len entries down. Moves vals along. */
+    void                (*sift_down_u64)(uint64_t *keys, void **vals, size_t len, size_t d, size_t i);
+    /* Turns keys/vals[0 .. len - 1] (heap indices) into a d-ary heap. */
+    void                (*heapify_u64)(uint64_t *keys, void **vals, size_t len, size_t d);
+} kern_t;
+
+extern const kern_t *_kern;
+
+#endif
@@ -0,0 +1,209 @@
+#include "utils.h"
+#include "kpq.h"
+#include "kern.h"
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define DEFAULT_ARITY 8
+#define MAX_ARITY 64
+#define CACHE_LINE 64
+
+struct _kpq_t {
+    size_t              len;
+    size_t              size;
+    size_t              arity;
+    uint64_t            *keys;
+    void                **vals;
+    uint64_t            *keys_mem;
+};
+
+/* Keys are shifted by arity - 1 slots so that every sibling group starts d-aligned. */
+static void _kpq_alloc(kpq_t *kpq, size_t size, size_t arity) {
+    size_t bytes = ((size + arity - 1) * sizeof(uint64_t) + CACHE_LINE - 1) & ~(size_t)(CACHE_LINE - 1);
+
+    kpq->keys_mem = aligned_alloc(CACHE_LINE, bytes ? bytes : CACHE_LINE);
+    kpq->keys = kpq->keys_mem + arity - 1;
+    kpq->vals = malloc((size ? size : 1) * sizeof(void *));
+    kpq->size = size;
+    kpq->arity = arity;
+    kpq->len = 0;
+}
+
+static void _kpq_sift_up(kpq_t *kpq, size_t i) {
+    uint64_t key = kpq->keys[i];
+    void *val = kpq->vals[i];
+
+    while (i > 0) {
+        size_t up = (i - 1) / kpq->arity;
+        if (kpq->keys[up] <= key)
+            break;
+
+        kpq->keys[i] = kpq->keys[up];
+        kpq->vals[i] = kpq->vals[up];
+        i = up;
+    }
+
+    kpq->keys[i] = key;
+    kpq->vals[i] = val;
+}
+
+kpq_t *kpq_create(size_t size, unsigned arity) {
+    if (!arity)
+        arity = DEFAULT_ARITY;
+
+    if (arity < 2 || arity > MAX_ARITY) {
+        fprintf(stderr, "kpq_error: Arity %u is not between 2 and %d\n", arity, MAX_ARITY);
+        abort();
+    }
+
+    kpq_t *kpq_ptr = malloc(sizeof(kpq_t));
+    _kpq_alloc(kpq_ptr, size, arity);
+
+    return kpq_ptr;
+}
+
+kpq_t *kpq_copy(kpq_t *source_kpq) {
+    if (!source_kpq) {
+        fprintf(stderr, "kpq_error: Trying to copy from nullptr\n");
+        abort();
+    }
+
+    kpq_t *kpq_ptr = malloc(sizeof(kpq_t));
+    _kpq_alloc(kpq_ptr, source_kpq->size, source_kpq->arity);
+    kpq_ptr->len = source_kpq->len;
+
+    memcpy(kpq_ptr->keys, source_kpq->keys, source_kpq->len * sizeof(uint64_t));
+    memcpy(kpq_ptr->vals, source_kpq->vals, source_kpq->len * sizeof(void *));
+
+    return kpq_ptr;
+}
+
+void kpq_destroy(kpq_t *kpq, void (*free_func)(void *)) {
+    if (free_func)
+        for (size_t i = 0; i < kpq->len; i++)
+            free_func(kpq->vals[i]);
+
+    free(kpq->keys_mem);
+    free(kpq->vals);
+    free(kpq);
+}
+
+void kpq_insert(kpq_t *kpq, uint64_t key, void *i) {
+    if (!kpq) {
+        fprintf(stderr, "kpq_error: Trying to insert to nullptr\n");
+        abort();
+    }
+
+    if (kpq->len + 1 > kpq->size) {
+        fprintf(stderr, "kpq_error: New length %zu is greater than kpq size %zu\n", kpq->len + 1, kpq->size);
+        abort();
+    }
+
+    kpq->keys[kpq->len] = key;
+    kpq->vals[kpq->len] = i;
+    _kpq_sift_up(kpq, kpq->len++);
+}
+
+void kpq_insert_n(kpq_t *kpq, const uint64_t *keys, void *const *items, size_t n) {
+    if (!kpq) {
+        fprintf(stderr, "kpq_error: Trying to insert to nullptr\n");
+        abort();
+    }
+
+    if (kpq->len + n > kpq->size) {
+        fprintf(stderr, "kpq_error: New length %zu is greater than kpq size %zu\n", kpq->len + n, kpq->size);
+        abort();
+    }
+
+    size_t old_len = kpq->len;
+    memcpy(kpq->keys + old_len, keys, n * sizeof(uint64_t));
+    memcpy(kpq->vals + old_len, items, n * sizeof(void *));
+    kpq->len += n;
+
+    /* A rebuild touches every node once, n sift-ups touch log(len) nodes each. */
+    if (n >= old_len / 2) {
+        _kern->heapify_u64(kpq->keys, kpq->vals, kpq->len, kpq->arity);
+        return;
+    }
+
+    for (size_t j = old_len; j < kpq->len; j++)
+        _kpq_sift_up(kpq, j);
+}
+
+char kpq_is_empty(kpq_t *kpq) {
+    return !kpq->len;
+}
+
+const void *kpq_peek(kpq_t *kpq, uint64_t *key) {
+    if (!kpq) {
+        fprintf(stderr, "kpq_error: Trying to peek in nullptr\n");
+        abort();
+    }
+
+    if (!kpq->len) {
+        fprintf(stderr, "kpq_error: Trying to access element in empty kpq\n");
+        abort();
+    }
+
+    if (key)
+        *key = kpq->keys[0];
+
+    return kpq->vals[0];
+}
+
+const void *kpq_remove(kpq_t *kpq, uint64_t *key) {
+    if (!kpq) {
+        fprintf(stderr, "kpq_error: Trying to remove from nullptr\n");
+        abort();
+    }
+
+    if (!kpq->len) {
+        fprintf(stderr, "kpq_error: Trying to remove element from empty kpq\n");
+        abort();
+    }
+
+    const void *top = kpq->vals[0];
+    if (key)
+        *key = kpq->keys[0];
+
+    if (--kpq->len) {
+        kpq->keys[0] = kpq->keys[kpq->len];
+        kpq->vals[0] = kpq->vals[kpq->len];
+        _kern->sift_down_u64(kpq->keys, kpq->vals, kpq->len, kpq->arity, 0);
+    }
+
+    return top;
+}
+
+size_t kpq_rank(kpq_t *kpq, uint64_t key) {
+    if (!kpq) {
+        fprintf(stderr, "kpq_error: Trying to rank in nullptr\n");
+        abort();
+    }
+
+    return _kern->count_lt_u64(kpq->keys, kpq->len, key);
+}
+
+size_t kpq_len(kpq_t *kpq) {
+    if (!kpq) {
+        fprintf(stderr, "kpq_error: Trying to get len from nullptr\n");
+        abort();
+    }
+
+    return kpq->len;
+}
+
+size_t kpq_size(kpq_t *kpq) {
+    if (!kpq) {
+        fprintf(stderr, "kpq_error: Trying to get size from nullptr\n");
+        abort();
+    }
+
+    return kpq->size;
+}
+
+const char *kpq_isa(void) {
+    return _kern->isa;
+}
@@ -0,0 +1,384 @@
+#include "utils.h"
+#include "median.h"
+#include "dheap.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define ARITY 4
+#define LOW 0
+#define HIGH 1
+#define HEAP_MIN 16
+#define MAX_WINDOW ((size_t)1 << 31)
+
+#define SLOT(h, i) ((h)->slots ? (h)->slots[i] : 0)
+
+typedef struct {
+    double              key;
+    uint32_t            slot;
+} _median_item_t;
+
+/*
+ * heaps[LOW] holds the lower samples negated, so that both heaps are min-heaps and
+ * -heaps[LOW].keys[0] is the largest lower sample. Windowed trackers also keep, for
+ * every heap index, the ring position of its sample in `slots`, and for every ring
+ * position its heap index times two plus its side in `where`, shared by both heaps.
+ */
+typedef struct {
+    size_t              len;
+    size_t              cap;
+    double              *keys;
+    uint32_t            *slots;
+    size_t              *where;
+    int                 side;
+} _median_heap_t;
+
+struct _median_t {
+    double              q;
+    size_t              window;
+    size_t              head;
+    size_t              len;
+    size_t              *where;
+    _median_heap_t      heaps[2];
+};
+
+static inline void _median_place(_median_heap_t *h, size_t i, _median_item_t x) {
+    h->keys[i] = x.key;
+    if (h->slots) {
+        h->slots[i] = x.slot;
+        h->where[x.slot] = i << 1 | h->side;
+    }
+}
+
+#define KEY(h, i) ((h)->keys[i])
+#define ITEM_KEY(x) ((x).key)
+#define LESS(a, b) ((a) < (b))
+#define GET(h, i) ((_median_item_t){(h)->keys[i], SLOT(h, i)})
+
+DEFINE_DHEAP(_median_heap, _median_heap_t, _median_item_t, ARITY, KEY, ITEM_KEY, LESS, GET, _median_place)
+
+static void _median_reserve(median_t *m, int side, size_t cap) {
+    _median_heap_t *h = &m->heaps[side];
+
+    if (cap <= h->cap)
+        return;
+
+    h->cap = cap > 2 * h->cap ? cap : 2 * h->cap;
+    h->keys = realloc(h->keys, h->cap * sizeof(double));
+}
+
+static inline void _median_push(median_t *m, int side, double key, uint32_t slot) {
+    _median_heap_t *h = &m->heaps[side];
+
+    if (h->len == h->cap)
+        _median_reserve(m, side, h->len + 1);
+
+    _median_heap_sift_up(h, h->len++, (_median_item_t){key, slot});
+}
+
+static inline void _median_erase(median_t *m, int side, size_t i) {
+    _median_heap_t *h = &m->heaps[side];
+
+    _median_heap_fill(h, --h->len, i);
+}
+
+/* Moves the top of one heap to the other. */
+static inline void _median_move(median_t *m, int from) {
+    _median_heap_t *h = &m->heaps[from];
+    double key = h->keys[0];
+    uint32_t slot = SLOT(h, 0);
+
+    _median_erase(m, from, 0);
+    _median_push(m, !from, -key, slot);
+}
+
+/* Number of lower samples: the rank of the quantile plus one. */
+static inline size_t _median_target(const median_t *m, size_t n) {
+    return n ? (size_t)(m->q * (double)(n - 1)) + 1 : 0;
+}
+
+static void _median_rebalance(median_t *m) {
+    size_t target = _median_target(m, m->len);
+
+    while (m->heaps[LOW].len > target)
+        _median_move(m, LOW);
+    while (m->heaps[LOW].len < target)
+        _median_move(m, HIGH);
+}
+
+/* Files a sample on the side it belongs to, leaving the balance to the caller. */
+static inline void _median_file(median_t *m, double x, uint32_t slot) {
+    const _median_heap_t *low = &m->heaps[LOW], *high = &m->heaps[HIGH];
+    char lower = low->len ? x <= -low->keys[0] : !high->len || x <= high->keys[0];
+
+    if (lower)
+        _median_push(m, LOW, -x, slot);
+    else
+        _median_push(m, HIGH, x, slot);
+
+    m->len++;
+}
+
+/* Drops the oldest sample: the ring holds the `len` positions before `head`. */
+static inline void _median_evict(median_t *m) {
+    size_t w = m->where[(m->head + m->window - m->len) % m->window];
+
+    _median_erase(m, w & 1, w >> 1);
+    m->len--;
+}
+
+/* Next ring position, evicting its sample if the window is full. */
+static inline uint32_t _median_slot(median_t *m) {
+    if (!m->window)
+        return 0;
+
+    if (m->len == m->window)
+        _median_evict(m);
+
+    uint32_t slot = (uint32_t)m->head;
+    m->head = m->head + 1 == m->window ? 0 : m->head + 1;
+    return slot;
+}
+
+static inline void _median_check(double x) {
+    if (x != x) {
+        fprintf(stderr, "median_error: Trying to add a NaN sample\n");
+        abort();
+    }
+}
+
+/* Moves the k smallest values (and their slots) in front of the others. */
+static void _median_select(double *v, uint32_t *s, size_t n, size_t k) {
+    ptrdiff_t lo = 0, hi = (ptrdiff_t)n - 1, kk = (ptrdiff_t)k;
+
+    while (lo < hi) {
+        double pivot = v[kk];
+        ptrdiff_t i = lo, j = hi;
+
+        do {
+            while (v[i] < pivot)
+                i++;
+            while (pivot < v[j])
+                j--;
+
+            if (i <= j) {
+                double t = v[i];
+                v[i] = v[j], v[j] = t;
+                if (s) {
+                    uint32_t u = s[i];
+                    s[i] = s[j], s[j] = u;
+                }
+                i++, j--;
+            }
+        } while (i <= j);
+
+        if (j < kk)
+            lo = i;
+        if (kk < i)
+            hi = j;
+    }
+}
+
+static void _median_heapify(median_t *m, int side) {
+    _median_heap_t *h = &m->heaps[side];
+
+    _median_heap_heapify(h, h->len);
+
+    /* Leaves are not placed by the sifts. */
+    if (h->slots)
+        for (size_t i = 0; i < h->len; i++)
+            m->where[h->slots[i]] = i << 1 | side;
+}
+
+/* Splits all n samples around the quantile and heapifies both sides in O(n). */
+static void _median_rebuild(median_t *m, double *v, uint32_t *s, size_t n) {
+    size_t target = _median_target(m, n);
+
+    if (target < n)
+        _median_select(v, s, n, target);
+
+    _median_reserve(m, LOW, target);
+    _median_reserve(m, HIGH, n - target);
+
+    for (size_t i = 0; i < n; i++) {
+        _median_heap_t *h = &m->heaps[i >= target];
+        size_t j = i < target ? i : i - target;
+
+        h->keys[j] = i < target ? -v[i] : v[i];
+        if (s)
+            h->slots[j] = s[i];
+    }
+
+    m->heaps[LOW].len = target;
+    m->heaps[HIGH].len = n - target;
+    m->len = n;
+
+    _median_heapify(m, LOW);
+    _median_heapify(m, HIGH);
+}
+
+median_t *median_create_ex(size_t window, double q) {
+    if (!(q >= 0 && q <= 1)) {
+        fprintf(stderr, "median_error: Quantile %g is not between 0 and 1\n", q);
+        abort();
+    }
+
+    if (window >= MAX_WINDOW) {
+        fprintf(stderr, "median_error: Window %zu is not below %zu\n", window, MAX_WINDOW);
+        abort();
+    }
+
+    size_t cap = window ? window : HEAP_MIN;
+
+    median_t *m_ptr = malloc(sizeof(median_t));
+    m_ptr->q = q;
+    m_ptr->window = window;
+    m_ptr->head = 0;
+    m_ptr->len = 0;
+    m_ptr->where = window ? malloc(window * sizeof(size_t)) : NULL;
+
+    for (int side = LOW; side <= HIGH; side++) {
+        m_ptr->heaps[side].len = 0;
+        m_ptr->heaps[side].cap = cap;
+        m_ptr->heaps[side].keys = malloc(cap * sizeof(double));
+        m_ptr->heaps[side].slots = window ? malloc(cap * sizeof(uint32_t)) : NULL;
+        m_ptr->heaps[side].where = m_ptr->where;
+        m_ptr->heaps[side].side = side;
+    }
+
+    return m_ptr;
+}
+
+median_t *median_create(size_t window) {
+    return median_create_ex(window, 0.5);
+}
+
+void median_destroy(median_t *m) {
+    for (int side = LOW; side <= HIGH; side++) {
+        free(m->heaps[side].keys);
+        free(m->heaps[side].slots);
+    }
+
+    free(m->where);
+    free(m);
+}
+
+void median_add(median_t *m, double x) {
+    if (!m) {
+        fprintf(stderr, "median_error: Trying to add to nullptr\n");
+        abort();
+    }
+
+    _median_check(x);
+
+    uint32_t slot = _median_slot(m);
+    _median_heap_t *low = &m->heaps[LOW], *high = &m->heaps[HIGH];
+    size_t target = _median_target(m, m->len + 1);
+
+    /*
+     * When the sample belongs to the side that must not grow, it replaces that side's
+     * top, which moves over: one sift down instead of a push, a pop and a push.
+     */
+    if (low->len == target && low->len && x < -low->keys[0]) {
+        double top = -low->keys[0];
+        uint32_t top_slot = SLOT(low, 0);
+
+        _median_heap_sift_down(low, low->len, 0, (_median_item_t){-x, slot});
+        _median_push(m, HIGH, top, top_slot);
+        m->len++;
+    } else if (low->len + 1 == target && high->len && x > high->keys[0]) {
+        double top = high->keys[0];
+        uint32_t top_slot = SLOT(high, 0);
+
+        _median_heap_sift_down(high, high->len, 0, (_median_item_t){x, slot});
+        _median_push(m, LOW, -top, top_slot);
+        m->len++;
+    } else {
+        _median_file(m, x, slot);
+        _median_rebalance(m);
+    }
+}
+
+void median_add_n(median_t *m, const double *xs, size_t n) {
+    if (!m) {
+        fprintf(stderr, "median_error: Trying to add to nullptr\n");
+        abort();
+    }
+
+    for (size_t i = 0; i < n; i++)
+        _median_check(xs[i]);
+
+    /* Only the last `window` samples of a large batch survive it. */
+    if (m->window && n >= m->window) {
+        xs += n - m->window;
+        n = m->window;
+        m->len = m->heaps[LOW].len = m->heaps[HIGH].len = 0;
+        m->head = 0;
+    }
+
+    if (n < m->len || !n) {
+        for (size_t i = 0; i < n; i++)
+            _median_file(m, xs[i], _median_slot(m));
+
+        _median_rebalance(m);
+        return;
+    }
+
+    /* Make room in the window, then gather the survivors and the batch. */
+    size_t keep = m->window && m->len + n > m->window ? m->window - n : m->len;
+    while (m->len > keep)
+        _median_evict(m);
+
+    size_t total = m->len + n;
+    double *v = malloc(total * sizeof(double));
+    uint32_t *s = m->window ? malloc(total * sizeof(uint32_t)) : NULL;
+    size_t k = 0;
+
+    for (int side = LOW; side <= HIGH; side++) {
+        const _median_heap_t *h = &m->heaps[side];
+
+        for (size_t i = 0; i < h->len; i++, k++) {
+            v[k] = side == LOW ? -h->keys[i] : h->keys[i];
+            if (s)
+                s[k] = h->slots[i];
+        }
+    }
+
+    for (size_t i = 0; i < n; i++, k++) {
+        v[k] = xs[i];
+        if (s) {
+            s[k] = (uint32_t)m->head;
+            m->head = m->head + 1 == m->window ? 0 : m->head + 1;
+        }
+    }
+
+    _median_rebuild(m, v, s, total);
+    free(v);
+    free(s);
+}
+
+double median_get(median_t *m) {
+    if (!m) {
+        fprintf(stderr, "median_error: Trying to read nullptr\n");
+        abort();
+    }
+
+    if (!m->len) {
+        fprintf(stderr, "median_error: Trying to read the quantile of no samples\n");
+        abort();
+    }
+
+    double lower = -m->heaps[LOW].keys[0];
+    double frac = m->q * (double)(m->len - 1) - (double)(m->heaps[LOW].len - 1);
+
+    if (frac > 0 && m->heaps[HIGH].len)
+        return lower + frac * (m->heaps[HIGH].keys[0] - lower);
+
+    return lower;
+}
+
+size_t median_len(median_t *m) {
+    return m->len;
+}
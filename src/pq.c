@@ -1,30 +1,122 @@
 #include "utils.h"
 #include "pq.h"
+#include "pq_impl.h"
+#include "probes.h"
+#include <stdarg.h>
 #include <stddef.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
 
 #define QUEUE(A, B, C) (A[B++] = C)
 #define DEQUEUE(A, B) (B--, A[0])
 
 #define MAX(A, B) ((A) > (B) ? (A) : (B))
+#define MIN(A, B) ((A) < (B) ? (A) : (B))
 #define UP(i) ((i - 1) >> 1)
 #define LEFT(i) (2 * i + 1)
 #define RIGHT(i) (LEFT(i) + 1)
 
-typedef struct {
-    int                 copies;
-    const void          *val;
-} _pq_node_t;
+#ifdef PQ_STATS
+#define STAT(pq, expr) ((void)(TAIL(pq)->stats.expr))
+#else
+#define STAT(pq, expr) ((void)0)
+#endif
 
-struct _pq_t {
-    size_t              len;
-    size_t              size;
-    int                 (*compare)(const void *, const void *);
-    _pq_node_t          **arr;
+#define COMPARE(pq, a, b) (STAT(pq, compares++), TAIL(pq)->compare(a, b))
+#define DEPTH_BUCKET(d) ((d) < PQ_STATS_DEPTHS ? (d) : PQ_STATS_DEPTHS - 1)
+
+#ifdef PQ_TRACE
+#define TRACE(pq, op, val) (TAIL(pq)->trace ? _trace(pq, op, val) : (void)0)
+#define TRACE_REC_SIZE 12
+#define TRACE_BUF_RECS 4096
+#else
+#define TRACE(pq, op, val) ((void)0)
+#endif
+
+#define SLOW_TRACE 1u
+#define SLOW_MIGRATE 2u
+#define SLOW_PENDING 4u
+#define SLOW_WORK (SLOW_MIGRATE | SLOW_PENDING)
+#define MIN_BUDGET 8
+
+#define SORTED_HI 32
+#define SORTED_LO 16
+#define WIDE_HI (1 << 16)
+#define WIDE_LO (1 << 15)
+#define ADAPT_EPOCH 1024
+
+#define BHEAP_PAGE 4096
+#define BHEAP_SLOTS (BHEAP_PAGE / sizeof(_pq_node_t *))
+#define BHEAP_LEVELS 9
+#define BH(pq, i) ((pq)->arr[_bh_phys(TAIL(pq)->bheap, i)])
+
+/*
+ * Page-blocked (B-heap) layout. The logical heap is cut into subtrees of
+ * BHEAP_LEVELS levels (511 nodes), each stored in BFS order in its own page, pages
+ * being laid out in BFS order of the subtrees. The top subtree is shortened so that
+ * the leaves of the capacity end on the last level of the bottom pages, which keeps
+ * the partially filled bottom pages, and thus the wasted slots, to a minimum.
+ *
+ * For logical node v = idx + 1 on level l, the page holding it is rooted at
+ * v >> shift[l] and the physical slot is off[l] + (v >> shift[l]) * BHEAP_SLOTS + the
+ * low shift[l] bits of v, all page offsets of the level being folded into off[l].
+ */
+struct _pq_bheap {
+    size_t              slots;
+    size_t              off[64];
+    unsigned char       shift[64];
 };
 
+extern inline char pq_is_empty(pq_t *pq);
+extern inline const void *pq_peek(pq_t *pq);
+extern inline size_t pq_len(pq_t *pq);
+extern inline size_t pq_size(pq_t *pq);
+extern inline const void *pq_peek_unchecked(pq_t *pq);
+extern inline size_t pq_len_unchecked(pq_t *pq);
+extern inline size_t pq_size_unchecked(pq_t *pq);
+extern inline int pq_try_peek(pq_t *pq, const void **out);
+
+void _pq_fatal(const char *fmt, ...) {
+    va_list args;
+
+    va_start(args, fmt);
+    fprintf(stderr, "pq_error: ");
+    vfprintf(stderr, fmt, args);
+    fprintf(stderr, "\n");
+    va_end(args);
+    abort();
+}
+
+#ifdef PQ_TRACE
+static uint64_t _trace_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void _trace_flush(_pq_tail_t *t) {
+    fwrite(t->trace_buf, TRACE_REC_SIZE, t->trace_len, t->trace);
+    t->trace_len = 0;
+}
+
+static void _trace(pq_t *pq, enum pq_trace_op op, const void *val) {
+    _pq_tail_t *t = TAIL(pq);
+    uint64_t now = _trace_now(), delta = now - t->trace_last;
+    uint64_t key = t->trace_key ? t->trace_key(val) : (uintptr_t)val * 0x9e3779b97f4a7c15ULL;
+    uint32_t meta = (uint32_t)((delta > 0x3fffffff ? 0x3fffffff : delta) << 2) | op;
+    unsigned char *rec = t->trace_buf + t->trace_len * TRACE_REC_SIZE;
+
+    memcpy(rec, &key, sizeof(key));
+    memcpy(rec + sizeof(key), &meta, sizeof(meta));
+    t->trace_last = now;
+
+    if (++t->trace_len == TRACE_BUF_RECS)
+        _trace_flush(t);
+}
+#endif
+
 void _sift_down(pq_t *pq, size_t idx, char is_left) {
     size_t child_idx = is_left ? LEFT(idx) : RIGHT(idx);
 
@@ -32,6 +124,7 @@ void _sift_down(pq_t *pq, size_t idx, char is_left) {
     pq->arr[idx] = pq->arr[child_idx];
 
     pq->arr[child_idx] = tmp;
+    STAT(pq, swaps++);
 }
 
 void _sift_up(pq_t *pq, size_t i) {
@@ -39,164 +132,1016 @@ void _sift_up(pq_t *pq, size_t i) {
     pq->arr[i] = pq->arr[UP(i)];
 
     pq->arr[UP(i)] = tmp;
+    STAT(pq, swaps++);
 }
 
-pq_t *pq_create(size_t size, int (*func)(const void *, const void *)) {
-    if (!func) {
-        fprintf(stderr, "pq_error: Compare function must not be nullptr\n");
-        abort();
+static inline size_t _bh_phys(const struct _pq_bheap *bh, size_t idx) {
+    size_t v = idx + 1;
+    unsigned l = 63 - __builtin_clzll(v), sh = bh->shift[l];
+
+    return bh->off[l] + (v >> sh) * BHEAP_SLOTS + (v & (((size_t)1 << sh) - 1));
+}
+
+static struct _pq_bheap *_bh_create(size_t size) {
+    struct _pq_bheap *bh = calloc(1, sizeof(struct _pq_bheap));
+    unsigned levels = 64 - __builtin_clzll(size | 1), top = (levels - 1) % BHEAP_LEVELS + 1;
+    size_t first = 0;
+
+    for (unsigned l = 0; l < levels; l++) {
+        unsigned root = l < top ? 0 : l - (l - top) % BHEAP_LEVELS;
+
+        /* Index of the first page of this page level: skip the pages of the level above. */
+        if (root && root == l)
+            first += root == top ? 1 : (size_t)1 << (root - BHEAP_LEVELS);
+
+        bh->shift[l] = l - root;
+        bh->off[l] = (first - ((size_t)1 << root)) * BHEAP_SLOTS + ((size_t)1 << (l - root)) - 1;
+    }
+
+    /* The bottom pages are filled left to right, but the pages to the right of the
+     * last element still hold the complete level above it. */
+    size_t last = _bh_phys(bh, size ? size - 1 : 0);
+    size_t above = levels > 1 ? _bh_phys(bh, ((size_t)1 << (levels - 1)) - 2) : 0;
+    bh->slots = MAX(last, above) + 1;
+    return bh;
+}
+
+static inline _pq_node_t **_slot(pq_t *pq, size_t idx) {
+    return TAIL(pq)->bheap ? &BH(pq, idx) : &pq->arr[idx];
+}
+
+static void _arr_alloc(pq_t *pq) {
+    if (TAIL(pq)->flags & PQ_BHEAP) {
+        TAIL(pq)->bheap = _bh_create(pq->size);
+        pq->arr = aligned_alloc(BHEAP_PAGE, (TAIL(pq)->bheap->slots + BHEAP_SLOTS - 1) / BHEAP_SLOTS * BHEAP_PAGE);
+    } else {
+        TAIL(pq)->bheap = NULL;
+        pq->arr = malloc(pq->size * sizeof(_pq_node_t *));
+    }
+}
+
+/*
+ * Hole-based sifts over the page-blocked layout. Inside a page the usual implicit
+ * arithmetic applies to the page-local index; the mapping table is only consulted
+ * when a sift crosses into another page. Both return the depth moved.
+ */
+#define PAGE_OF(p) ((p) & ~(BHEAP_SLOTS - 1))
+#define LOCAL_OF(p) ((p) & (BHEAP_SLOTS - 1))
+
+static size_t _bh_sift_up(pq_t *pq, size_t idx, _pq_node_t *x) {
+    const struct _pq_bheap *bh = TAIL(pq)->bheap;
+    _pq_node_t **arr = pq->arr;
+    size_t depth = 0, hole = _bh_phys(bh, idx);
+    unsigned lvl = 63 - __builtin_clzll(idx + 1);
+
+    while (idx > 0) {
+        size_t up = bh->shift[lvl] ? PAGE_OF(hole) + (LOCAL_OF(hole) - 1) / 2 : _bh_phys(bh, UP(idx));
+        if (COMPARE(pq, x->val, arr[up]->val) >= 0)
+            break;
+
+        arr[hole] = arr[up];
+        STAT(pq, swaps++);
+        hole = up;
+        idx = UP(idx);
+        lvl--;
+        depth++;
+    }
+
+    arr[hole] = x;
+    return depth;
+}
+
+static size_t _bh_sift_down(pq_t *pq, _pq_node_t *x) {
+    const struct _pq_bheap *bh = TAIL(pq)->bheap;
+    _pq_node_t **arr = pq->arr;
+    size_t len = pq->len, idx = 0, depth = 0, hole = 0, l;
+    unsigned lvl = 0;
+
+    while ((l = LEFT(idx)) < len) {
+        /* Siblings share a page, except page roots, which start adjacent pages. */
+        size_t a, b;
+        if (bh->shift[++lvl]) {
+            a = PAGE_OF(hole) + 2 * LOCAL_OF(hole) + 1;
+            b = a + 1;
+        } else {
+            a = _bh_phys(bh, l);
+            b = a + BHEAP_SLOTS;
+        }
+
+        char right = l + 1 < len && COMPARE(pq, arr[b]->val, arr[a]->val) < 0;
+        size_t c = right ? b : a;
+
+        if (COMPARE(pq, arr[c]->val, x->val) >= 0)
+            break;
+
+        arr[hole] = arr[c];
+        STAT(pq, swaps++);
+        hole = c;
+        idx = l + right;
+        depth++;
+    }
+
+    arr[hole] = x;
+    return depth;
+}
+
+/*
+ * Sift-down used by PQ_LARGE queues: `x` moves down from the root through a hole
+ * instead of being swapped level by level. Each level runs a three stage prefetch
+ * pipeline: elements of the grandchildren, nodes of the great-grandchildren and the
+ * pointer block below them, so that by the time a level is compared its nodes and
+ * elements are already on their way. The smaller child is selected arithmetically
+ * rather than through a branch. Returns the depth reached.
+ */
+static size_t _sift_down_large(pq_t *pq, _pq_node_t *x, size_t *last) {
+    _pq_node_t **arr = pq->arr;
+    size_t len = pq->len, idx = 0, depth = 0, l;
+
+    while ((l = LEFT(idx)) + 1 < len) {
+        size_t g = LEFT(l), gg = LEFT(g);
+
+        if (gg + 7 < len) {
+            for (int k = 0; k < 4; k++)
+                __builtin_prefetch(arr[g + k]->val);
+            for (int k = 0; k < 8; k++)
+                __builtin_prefetch(arr[gg + k]);
+            if (LEFT(gg) + 15 < len) {
+                __builtin_prefetch(&arr[LEFT(gg)]);
+                __builtin_prefetch(&arr[LEFT(gg) + 8]);
+            }
+        }
+
+        size_t c = l + (COMPARE(pq, arr[l + 1]->val, arr[l]->val) < 0);
+        if (COMPARE(pq, arr[c]->val, x->val) >= 0)
+            break;
+
+        arr[idx] = arr[c];
+        STAT(pq, swaps++);
+        idx = c;
+        depth++;
+    }
+
+    if (l + 1 == len && COMPARE(pq, arr[l]->val, x->val) < 0) {
+        arr[idx] = arr[l];
+        STAT(pq, swaps++);
+        idx = l;
+        depth++;
+    }
+
+    arr[idx] = x;
+    *last = idx;
+    return depth;
+}
+
+/* Hole-based sift-down of a[i] in the binary heap a[0 .. len - 1]. */
+static void _sift_down_at(pq_t *pq, _pq_node_t **a, size_t len, size_t i) {
+    _pq_node_t *x = a[i];
+    size_t c;
+
+    while ((c = LEFT(i)) < len) {
+        c += c + 1 < len && COMPARE(pq, a[c + 1]->val, a[c]->val) < 0;
+        if (COMPARE(pq, a[c]->val, x->val) >= 0)
+            break;
+
+        a[i] = a[c];
+        STAT(pq, swaps++);
+        i = c;
+    }
+
+    a[i] = x;
+}
+
+/* Hole-based sift-up of a[i]. */
+static void _sift_up_at(pq_t *pq, _pq_node_t **a, size_t i) {
+    _pq_node_t *x = a[i];
+
+    for (; i > 0 && COMPARE(pq, x->val, a[UP(i)]->val) < 0; i = UP(i)) {
+        a[i] = a[UP(i)];
+        STAT(pq, swaps++);
+    }
+
+    a[i] = x;
+}
+
+static void _heapify(pq_t *pq, _pq_node_t **a, size_t len) {
+    for (size_t i = len / 2; i-- > 0;)
+        _sift_down_at(pq, a, len, i);
+}
+
+/*
+ * Adaptive shapes (PQ_ADAPTIVE).
+ *
+ * `arity` is 0 while the queue is a sorted array, which is also a heap of every
+ * arity, and 2, 4 or 8 otherwise. Sorted arrays become binary heaps when they reach
+ * SORTED_HI elements and binary heaps sort themselves back below SORTED_LO. Every
+ * ADAPT_EPOCH operations queues of WIDE_HI elements or more pick a 4-ary heap, or an
+ * 8-ary one when inserts dominate, and shrink back to binary below WIDE_LO. Heap to
+ * heap conversions rebuild the array, so they also wait for `len` operations since
+ * the previous switch.
+ */
+static size_t _dsift_up(pq_t *pq, size_t i, _pq_node_t *x) {
+    _pq_node_t **a = pq->arr;
+    unsigned s = __builtin_ctz(TAIL(pq)->arity);
+    size_t depth = 0;
+
+    for (; i > 0; depth++) {
+        size_t p = (i - 1) >> s;
+        if (COMPARE(pq, x->val, a[p]->val) >= 0)
+            break;
+
+        a[i] = a[p];
+        STAT(pq, swaps++);
+        i = p;
+    }
+
+    a[i] = x;
+    return depth;
+}
+
+static size_t _dsift_down(pq_t *pq, _pq_node_t **a, size_t len, size_t i) {
+    _pq_node_t *x = a[i];
+    unsigned s = __builtin_ctz(TAIL(pq)->arity);
+    size_t c, depth = 0;
+
+    for (; (c = (i << s) + 1) < len; depth++) {
+        size_t end = MIN(c + TAIL(pq)->arity, len), best = c;
+
+        for (size_t j = c + 1; j < end; j++)
+            if (COMPARE(pq, a[j]->val, a[best]->val) < 0)
+                best = j;
+
+        if (COMPARE(pq, a[best]->val, x->val) >= 0)
+            break;
+
+        a[i] = a[best];
+        STAT(pq, swaps++);
+        i = best;
+    }
+
+    a[i] = x;
+    return depth;
+}
+
+static void _reshape(pq_t *pq, unsigned arity);
+
+/* Rebuilds the heap in the current shape. */
+static void _heapify_shape(pq_t *pq) {
+    /* A sorted array already is a heap. */
+    if (!TAIL(pq)->arity)
+        _reshape(pq, 2);
+
+    if (TAIL(pq)->arity == 2) {
+        _heapify(pq, pq->arr, pq->len);
+        return;
+    }
+
+    if (pq->len > 1)
+        for (size_t i = ((pq->len - 2) >> __builtin_ctz(TAIL(pq)->arity)) + 1; i-- > 0;)
+            _dsift_down(pq, pq->arr, pq->len, i);
+}
+
+static void _reshape(pq_t *pq, unsigned arity) {
+    PROBE3(pq_switch, pq, TAIL(pq)->arity, arity);
+    STAT(pq, switches++);
+
+    TAIL(pq)->adapt_since = 0;
+    if (!arity) {
+        /* Insertion sort: only reached below SORTED_LO elements. */
+        for (size_t i = 1; i < pq->len; i++) {
+            _pq_node_t *x = pq->arr[i];
+            size_t j = i;
+
+            for (; j > 0 && COMPARE(pq, x->val, pq->arr[j - 1]->val) < 0; j--)
+                pq->arr[j] = pq->arr[j - 1];
+            pq->arr[j] = x;
+        }
+    } else if (TAIL(pq)->arity) {
+        TAIL(pq)->arity = arity;
+        _heapify_shape(pq);
+    }
+
+    TAIL(pq)->arity = arity;
+}
+
+static void _adapt_eval(pq_t *pq) {
+    _pq_tail_t *t = TAIL(pq);
+    size_t len = pq->len + pq->pending;
+    unsigned arity;
+
+    if (len < (t->arity ? SORTED_LO : SORTED_HI))
+        arity = 0;
+    else if (len < (t->arity > 2 ? WIDE_LO : WIDE_HI))
+        arity = 2;
+    else if (t->arity == 8)
+        arity = 2 * t->adapt_ins >= t->adapt_ops ? 8 : 4;
+    else
+        arity = 3 * t->adapt_ins > 2 * t->adapt_ops ? 8 : 4;
+
+    t->adapt_since += t->adapt_ops;
+    t->adapt_ops = t->adapt_ins = 0;
+
+    if (arity != t->arity && (!arity || !t->arity || t->adapt_since >= len))
+        _reshape(pq, arity);
+}
+
+/* Counts an operation and re-evaluates the shape once per epoch or when a heap gets small. */
+static inline void _adapt(pq_t *pq, char insert) {
+    TAIL(pq)->adapt_ins += insert;
+
+    if (++TAIL(pq)->adapt_ops >= ADAPT_EPOCH || (TAIL(pq)->arity && pq->len < SORTED_LO))
+        _adapt_eval(pq);
+}
+
+/* Inserts into a sorted array or a 4/8-ary heap. Returns the depth it moved. */
+static size_t _push_shaped(pq_t *pq, _pq_node_t *x) {
+    if (TAIL(pq)->arity)
+        return _dsift_up(pq, pq->len++, x);
+
+    size_t lo = 0, hi = pq->len;
+
+    /* Upper bound keeps equal elements in insertion order. */
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+
+        if (COMPARE(pq, x->val, pq->arr[mid]->val) < 0)
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+
+    memmove(pq->arr + lo + 1, pq->arr + lo, (pq->len - lo) * sizeof(_pq_node_t *));
+    pq->arr[lo] = x;
+    pq->len++;
+    STAT(pq, swaps += pq->len - 1 - lo);
+
+    return 0;
+}
+
+/* Removes the top of a sorted array or a 4/8-ary heap. Returns the sift depth. */
+static size_t _pop_shaped(pq_t *pq) {
+    if (!TAIL(pq)->arity) {
+        memmove(pq->arr, pq->arr + 1, pq->len * sizeof(_pq_node_t *));
+        STAT(pq, swaps += pq->len);
+        return 0;
+    }
+
+    pq->arr[0] = pq->arr[pq->len];
+    return _dsift_down(pq, pq->arr, pq->len, 0);
+}
+
+/*
+ * Incremental maintenance.
+ *
+ * Growing a PQ_GROW queue allocates the larger array up front and copies the old
+ * one into it, a budget of slots per operation, while the heap keeps living in the
+ * old array. The migrated slots an operation rewrites afterwards all lie on the path
+ * from the last slot it sifted to the root, so `_resync` copies that path again.
+ * Once every live slot is copied the arrays are swapped. With a budget, growth
+ * starts at 3/4 of the capacity so that it completes before the old array is full.
+ *
+ * Elements that are not in the heap yet live in `pend`: a heap of `pend_heap`
+ * elements followed by an unsorted tail. Batches given to pq_insert_n() and the
+ * inserts of a PQ_LAZY queue are appended to the tail, whose minimum is tracked
+ * in `lazy_min`. Removals first order the tail into the pending heap, then merge
+ * it into the heap a budget of elements per operation, always taking a leaf of the
+ * pending heap so that it stays a heap. Until then peeks compare all three tops.
+ * With a budget a removal could not order a backlog of any length, so PQ_LAZY
+ * inserts skip `pend` and batches are ordered by pq_insert_n() itself.
+ */
+static void _resync(pq_t *pq, size_t idx) {
+    _pq_tail_t *t = TAIL(pq);
+
+    while (idx >= t->migrated) {
+        if (!idx)
+            return;
+        idx = UP(idx);
+    }
+
+    for (;; idx = UP(idx)) {
+        t->grow[idx] = pq->arr[idx];
+        if (!idx)
+            return;
+    }
+}
+
+static void _grow_step(pq_t *pq, size_t work) {
+    _pq_tail_t *t = TAIL(pq);
+    size_t n = MIN(pq->len > t->migrated ? pq->len - t->migrated : 0, work);
+
+    memcpy(t->grow + t->migrated, pq->arr + t->migrated, n * sizeof(_pq_node_t *));
+    t->migrated += n;
+
+    if (t->migrated >= pq->len) {
+        free(pq->arr);
+        pq->arr = t->grow;
+        pq->size = t->grow_size;
+        t->grow = NULL;
+        pq->slow &= ~SLOW_MIGRATE;
+    }
+}
+
+static void _grow_start(pq_t *pq, size_t need) {
+    _pq_tail_t *t = TAIL(pq);
+
+    t->grow_size = MAX(2 * pq->size, 2 * need);
+    t->grow = malloc(t->grow_size * sizeof(_pq_node_t *));
+    t->migrated = 0;
+    pq->slow |= SLOW_MIGRATE;
+    STAT(pq, allocs++);
+    PROBE3(pq_grow, pq, pq->size, t->grow_size);
+
+    if (!t->budget)
+        _grow_step(pq, SIZE_MAX);
+}
+
+/* Makes sure a PQ_GROW queue is (or is becoming) large enough for n more elements. */
+static inline void _reserve(pq_t *pq, size_t n) {
+    size_t need = pq->len + pq->pending + n;
+
+    /* A batch can outgrow the array being filled: finish it and start a larger one. */
+    if (pq->slow & SLOW_MIGRATE && need > TAIL(pq)->grow_size)
+        _grow_step(pq, SIZE_MAX);
+
+    if (!(pq->slow & SLOW_MIGRATE) && (TAIL(pq)->budget ? 4 * need > 3 * pq->size : need > pq->size))
+        _grow_start(pq, need);
+}
+
+/* Sifts a new node up from the end of the heap. Returns the depth it moved. */
+static inline size_t _push(pq_t *pq, _pq_node_t *i_node) {
+    size_t idx = pq->len, depth = 0;
+
+    if (TAIL(pq)->bheap)
+        return _bh_sift_up(pq, pq->len++, i_node);
+
+    if (TAIL(pq)->flags & PQ_ADAPTIVE) {
+        if (!TAIL(pq)->arity && pq->len >= SORTED_HI)
+            _reshape(pq, 2);
+
+        if (TAIL(pq)->arity != 2)
+            return _push_shaped(pq, i_node);
+    }
+
+    QUEUE(pq->arr, pq->len, i_node);
+
+    while (idx > 0 && COMPARE(pq, i_node->val, pq->arr[UP(idx)]->val) < 0) {
+        _sift_up(pq, idx);
+        idx = UP(idx);
+        depth++;
     }
 
-    pq_t *pq_ptr = malloc(sizeof(pq_t));
-    pq_ptr->arr = malloc(size * sizeof(_pq_node_t *));
+    if (pq->slow & SLOW_MIGRATE)
+        _resync(pq, pq->len - 1);
+
+    return depth;
+}
+
+static void _pend_clear(pq_t *pq) {
+    _pq_tail_t *t = TAIL(pq);
+
+    free(t->pend);
+    t->pend = NULL;
+    t->pend_cap = t->pend_heap = 0;
+    pq->slow &= ~SLOW_PENDING;
+}
+
+/* Appends a node to the unsorted tail of `pend`. */
+static inline void _defer(pq_t *pq, _pq_node_t *node) {
+    _pq_tail_t *t = TAIL(pq);
+
+    if (pq->pending == t->pend_cap) {
+        t->pend_cap = MAX(2 * t->pend_cap, 16);
+        t->pend = realloc(t->pend, t->pend_cap * sizeof(_pq_node_t *));
+        STAT(pq, allocs++);
+    }
+
+    if (pq->pending == t->pend_heap || COMPARE(pq, node->val, t->pend[t->lazy_min]->val) < 0)
+        t->lazy_min = pq->pending;
+
+    t->pend[pq->pending++] = node;
+    pq->slow |= SLOW_PENDING;
+}
+
+/* Orders the unsorted tail of `pend` into the pending heap. */
+static void _absorb(pq_t *pq) {
+    _pq_tail_t *t = TAIL(pq);
+
+    if (2 * (pq->pending - t->pend_heap) >= t->pend_heap) {
+        t->pend_heap = pq->pending;
+        _heapify(pq, t->pend, pq->pending);
+        return;
+    }
+
+    while (t->pend_heap < pq->pending)
+        _sift_up_at(pq, t->pend, t->pend_heap++);
+}
+
+/* Moves up to `work` elements of the pending heap into the heap. */
+static void _merge(pq_t *pq, size_t work) {
+    _pq_tail_t *t = TAIL(pq);
+
+    for (; work && t->pend_heap && pq->len < pq->size; work--, pq->pending--)
+        _push(pq, t->pend[--t->pend_heap]);
+
+    if (!pq->pending)
+        _pend_clear(pq);
+}
+
+/* Spends one operation's budget on the pending growth and merge. */
+static void _work(pq_t *pq) {
+    size_t work = TAIL(pq)->budget ? TAIL(pq)->budget : SIZE_MAX;
+
+    if (pq->slow & SLOW_MIGRATE)
+        _grow_step(pq, work);
+
+    /* An unsorted tail sits above the pending heap's leaves until a removal orders it. */
+    if (pq->slow & SLOW_PENDING && TAIL(pq)->pend_heap == pq->pending)
+        _merge(pq, work);
+}
+
+/* Completes all incremental work at once. The order of `pend` does not matter here. */
+static void _settle(pq_t *pq) {
+    if (pq->slow & SLOW_MIGRATE)
+        _grow_step(pq, SIZE_MAX);
+
+    if (!(pq->slow & SLOW_PENDING))
+        return;
+
+    /* A rebuild touches every node once, sift-ups touch log(len) nodes each. Small sorted arrays stay sorted. */
+    if (!TAIL(pq)->bheap && 2 * pq->pending >= pq->len && (TAIL(pq)->arity || pq->len + pq->pending >= SORTED_HI)) {
+        memcpy(pq->arr + pq->len, TAIL(pq)->pend, pq->pending * sizeof(_pq_node_t *));
+        pq->len += pq->pending;
+        _heapify_shape(pq);
+    } else {
+        for (size_t j = 0; j < pq->pending; j++)
+            _push(pq, TAIL(pq)->pend[j]);
+    }
+
+    pq->pending = 0;
+    _pend_clear(pq);
+}
+
+static inline _pq_node_t *_top(pq_t *pq) {
+    _pq_tail_t *t = TAIL(pq);
+    _pq_node_t *top = pq->len ? pq->arr[0] : NULL;
+
+    if (t->pend_heap && (!top || COMPARE(pq, t->pend[0]->val, top->val) < 0))
+        top = t->pend[0];
+
+    if (pq->pending > t->pend_heap && (!top || COMPARE(pq, t->pend[t->lazy_min]->val, top->val) < 0))
+        top = t->pend[t->lazy_min];
+
+    return top;
+}
+
+pq_t *pq_create_ex(size_t size, int (*func)(const void *, const void *), unsigned flags) {
+    /* Checked even with PQ_NO_CHECKS, like every call off the hot path. */
+    if (!func)
+        _pq_fatal("Compare function must not be nullptr");
+
+    if (flags & PQ_BHEAP && flags & (PQ_GROW | PQ_ADAPTIVE))
+        _pq_fatal("PQ_BHEAP cannot be combined with PQ_GROW or PQ_ADAPTIVE");
+
+    if (flags & PQ_GROW && flags & PQ_ADAPTIVE)
+        _pq_fatal("PQ_GROW cannot be combined with PQ_ADAPTIVE");
+
+    _pq_tail_t *t = malloc(sizeof(_pq_tail_t));
+    pq_t *pq_ptr = &t->pq;
     pq_ptr->size = size;
     pq_ptr->len = 0;
+    pq_ptr->pending = 0;
+    pq_ptr->slow = 0;
+    t->flags = flags;
+    t->pend = NULL;
+    t->pend_heap = t->pend_cap = 0;
+    t->grow = NULL;
+    t->budget = 0;
+    t->arity = flags & PQ_ADAPTIVE ? 0 : 2;
+    t->adapt_ops = t->adapt_ins = t->adapt_since = 0;
+    _arr_alloc(pq_ptr);
 
-    pq_ptr->compare = func;
+    t->compare = func;
 
+#ifdef PQ_TRACE
+    t->trace = NULL;
+#endif
+#ifdef PQ_STATS
+    memset(&t->stats, 0, sizeof(pq_stats_t));
+    t->stats.allocs = 2;
+#endif
+
+    PROBE2(pq_create, pq_ptr, size);
     return pq_ptr;
 }
 
+pq_t *pq_create(size_t size, int (*func)(const void *, const void *)) {
+    return pq_create_ex(size, func, 0);
+}
+
 void pq_destroy(pq_t *pq, void (*free_func)(void *)) {
-    for (int i = 0; i < pq->len; i++)
-        if (!--pq->arr[i]->copies) {
+    PROBE2(pq_destroy, pq, pq->len);
+    pq_trace_stop(pq);
+
+    for (size_t i = 0; i < pq->len + pq->pending; i++) {
+        _pq_node_t *node = i < pq->len ? *_slot(pq, i) : TAIL(pq)->pend[i - pq->len];
+
+        if (!--node->copies) {
             if (free_func)
-                free_func((void *)pq->arr[i]->val);
+                free_func((void *)node->val);
 
-            free((void *)pq->arr[i]);
+            free((void *)node);
         }
+    }
 
     free(pq->arr);
+    free(TAIL(pq)->grow);
+    free(TAIL(pq)->pend);
+    free(TAIL(pq)->bheap);
     free(pq);
 }
 
 pq_t *pq_copy(pq_t *source_pq) {
-    if (!source_pq) {
-        fprintf(stderr, "pq_error: Trying to copy from nullptr\n");
-        abort();
-    }
+    if (!source_pq)
+        _pq_fatal("Trying to copy from nullptr");
 
-    pq_t *pq_ptr = malloc(sizeof(pq_t));
-    pq_ptr->arr = malloc(source_pq->size * sizeof(_pq_node_t *));
+    _settle(source_pq);
+
+    _pq_tail_t *src = TAIL(source_pq), *t = malloc(sizeof(_pq_tail_t));
+    pq_t *pq_ptr = &t->pq;
     pq_ptr->size = source_pq->size;
     pq_ptr->len = source_pq->len;
-    pq_ptr->compare = source_pq->compare;
+    pq_ptr->pending = 0;
+    pq_ptr->slow = 0;
+    t->flags = src->flags;
+    t->compare = src->compare;
+    t->pend = NULL;
+    t->pend_heap = t->pend_cap = 0;
+    t->grow = NULL;
+    t->budget = src->budget;
+    t->arity = src->arity;
+    t->adapt_ops = src->adapt_ops;
+    t->adapt_ins = src->adapt_ins;
+    t->adapt_since = src->adapt_since;
+    _arr_alloc(pq_ptr);
 
-    for (size_t i = 0; i < source_pq->len; i++) {
-        pq_ptr->arr[i] = source_pq->arr[i];
-        pq_ptr->arr[i]->copies++;
-    }
-    memcpy(pq_ptr->arr, source_pq->arr, source_pq->size * sizeof(void *));
+    for (size_t i = 0; i < source_pq->len; i++)
+        (*_slot(source_pq, i))->copies++;
+    memcpy(pq_ptr->arr, source_pq->arr, (src->bheap ? src->bheap->slots : source_pq->size) * sizeof(void *));
 
+#ifdef PQ_TRACE
+    t->trace = NULL;
+#endif
+#ifdef PQ_STATS
+    memset(&t->stats, 0, sizeof(pq_stats_t));
+    t->stats.allocs = 2;
+    t->stats.peak_len = pq_ptr->len;
+#endif
+
+    PROBE3(pq_copy, source_pq, pq_ptr, pq_ptr->len);
     return pq_ptr;
 }
 
-char pq_is_empty(pq_t *pq) {
-    return !pq->len;
-}
+static inline void _insert(pq_t *pq, void *i) {
+    _pq_node_t *i_node = malloc(sizeof(_pq_node_t));
+    i_node->copies = 1;
+    i_node->val = i;
+    STAT(pq, allocs++);
 
-void pq_insert(pq_t *pq, void *i) {
-    if (!pq) {
-        fprintf(stderr, "pq_error: Trying to insert to nullptr\n");
-        abort();
+    if (TAIL(pq)->flags & PQ_ADAPTIVE)
+        _adapt(pq, 1);
+
+    if (TAIL(pq)->flags & PQ_GROW)
+        _reserve(pq, 1);
+
+    /* Under a budget a removal could not order the backlog, so inserts are not deferred. */
+    char lazy = TAIL(pq)->flags & PQ_LAZY && !TAIL(pq)->budget;
+
+    if (pq->slow & SLOW_WORK) {
+        _work(pq);
+
+        /* Only reachable while pending elements were merged into a growing queue. */
+        if (pq->len + 1 > pq->size && !lazy)
+            _grow_step(pq, SIZE_MAX);
     }
 
-    if (pq->len + 1 > pq->size) {
-        fprintf(stderr, "pq_error: New length %ld is greater than pq size %ld\n", pq->len + 1, pq->size);
-        abort();
+    if (lazy) {
+        _defer(pq, i_node);
+        STAT(pq, peak_len = MAX(TAIL(pq)->stats.peak_len, pq->len + pq->pending));
+        PROBE3(pq_insert, pq, pq->len + pq->pending, 0);
+        TRACE(pq, PQ_TRACE_INSERT, i);
+        return;
     }
 
-    size_t idx = pq->len;
+    size_t depth = _push(pq, i_node);
 
-    _pq_node_t *i_node = malloc(sizeof(_pq_node_t));
-    i_node->copies = 1;
-    i_node->val = i;
+    STAT(pq, peak_len = MAX(TAIL(pq)->stats.peak_len, pq->len + pq->pending));
+    STAT(pq, sift_up[DEPTH_BUCKET(depth)]++);
+    PROBE3(pq_insert, pq, pq->len, depth);
+    TRACE(pq, PQ_TRACE_INSERT, i);
+    (void)depth;
+}
 
-    QUEUE(pq->arr, pq->len, i_node);
+/* Whether n more elements overflow a queue that cannot grow, counting the event if so. */
+static inline int _full(pq_t *pq, size_t n) {
+    if (pq->len + pq->pending + n <= pq->size || TAIL(pq)->flags & PQ_GROW)
+        return 0;
 
-    while (idx > 0 && pq->compare(i_node->val, pq->arr[UP(idx)]->val) < 0) {
-        _sift_up(pq, idx);
-        idx = UP(idx);
-    }
+    STAT(pq, full_events++);
+    PROBE3(pq_full, pq, pq->len, pq->size);
+    return 1;
+}
+
+void pq_insert(pq_t *pq, void *i) {
+    _PQ_CHECK(!pq, "Trying to insert to nullptr");
+
+    /* Evaluated even with PQ_NO_CHECKS, which keeps full_events and the pq_full probe. */
+    int full = _full(pq, 1);
+    _PQ_CHECK(full, "New length %zu is greater than pq size %zu", pq->len + pq->pending + 1, pq->size);
+    (void)full;
+
+    _insert(pq, i);
+}
+
+void pq_insert_unchecked(pq_t *pq, void *i) {
+    _insert(pq, i);
+}
+
+int pq_try_insert(pq_t *pq, void *i) {
+    if (!pq)
+        return PQ_ENULL;
+
+    if (_full(pq, 1))
+        return PQ_EFULL;
+
+    _insert(pq, i);
+    return PQ_OK;
 }
 
-const void *pq_peek(pq_t *pq) {
-    if (!pq) {
-        fprintf(stderr, "pq_error: Trying to peek in nullptr\n");
-        abort();
+void pq_insert_n(pq_t *pq, void *const *items, size_t n) {
+    /* Checked even with PQ_NO_CHECKS: a batch has no unchecked variant. */
+    if (!pq)
+        _pq_fatal("Trying to insert to nullptr");
+
+    if (_full(pq, n))
+        _pq_fatal("New length %zu is greater than pq size %zu", pq->len + pq->pending + n, pq->size);
+
+    if (!n)
+        return;
+
+    if (TAIL(pq)->flags & PQ_GROW)
+        _reserve(pq, n);
+
+    STAT(pq, allocs += n);
+
+    for (size_t j = 0; j < n; j++) {
+        _pq_node_t *node = malloc(sizeof(_pq_node_t));
+        node->copies = 1;
+        node->val = items[j];
+        _defer(pq, node);
+        TRACE(pq, PQ_TRACE_INSERT, items[j]);
     }
 
-    if (!pq->len) {
-        fprintf(stderr, "pq_error: Trying to access element in empty pq\n");
-        abort();
+    PROBE3(pq_insert_n, pq, pq->len, n);
+
+    /* Without a budget, a lazy queue leaves the batch unsorted until a removal needs it. */
+    if (!(TAIL(pq)->flags & PQ_LAZY) || TAIL(pq)->budget) {
+        if (TAIL(pq)->budget) {
+            _absorb(pq);
+            _work(pq);
+        } else {
+            _settle(pq);
+        }
     }
 
-    return pq->arr[0]->val;
+    STAT(pq, peak_len = MAX(TAIL(pq)->stats.peak_len, pq->len + pq->pending));
 }
 
-const void *pq_remove(pq_t *pq) {
-    if (!pq) {
-        fprintf(stderr, "pq_error: Trying to remove from nullptr\n");
-        abort();
+void pq_set_budget(pq_t *pq, size_t work) {
+    if (!pq)
+        _pq_fatal("Trying to set budget of nullptr");
+
+    TAIL(pq)->budget = work ? MAX(work, MIN_BUDGET) : 0;
+    if (!TAIL(pq)->budget)
+        _settle(pq);
+    else if (pq->pending > TAIL(pq)->pend_heap)
+        _absorb(pq);
+}
+
+const void *_pq_peek(pq_t *pq) {
+    _PQ_CHECK(!pq, "Trying to peek in nullptr");
+    _PQ_CHECK(!pq->len && !pq->pending, "Trying to access element in empty pq");
+
+    const void *top = _top(pq)->val;
+
+    PROBE2(pq_peek, pq, pq->len + pq->pending);
+    TRACE(pq, PQ_TRACE_PEEK, top);
+    return top;
+}
+
+/* Drops a queue's reference to a node, freeing it once no copy of the queue holds it. */
+static inline const void *_release(_pq_node_t *node) {
+    const void *val = node->val;
+
+    if (!--node->copies)
+        free(node);
+
+    return val;
+}
+
+static const void *_remove_pending(pq_t *pq) {
+    _pq_tail_t *t = TAIL(pq);
+    _pq_node_t *top_val = t->pend[0];
+
+    pq->pending--;
+    if (--t->pend_heap) {
+        t->pend[0] = t->pend[t->pend_heap];
+        _sift_down_at(pq, t->pend, t->pend_heap, 0);
+    } else {
+        _pend_clear(pq);
     }
 
-    if (!pq->len) {
-        fprintf(stderr, "pq_error: Trying to remove element from empty pq\n");
-        abort();
+    PROBE3(pq_remove, pq, pq->len + pq->pending, 0);
+    TRACE(pq, PQ_TRACE_REMOVE, top_val->val);
+
+    return _release(top_val);
+}
+
+static inline const void *_remove(pq_t *pq) {
+    if (TAIL(pq)->flags & PQ_ADAPTIVE)
+        _adapt(pq, 0);
+
+    if (pq->slow & SLOW_WORK) {
+        if (pq->pending > TAIL(pq)->pend_heap) {
+            if (TAIL(pq)->budget)
+                _absorb(pq);
+            else
+                _settle(pq);
+        }
+
+        _work(pq);
+
+        if (!pq->len || _top(pq) != pq->arr[0])
+            return _remove_pending(pq);
     }
 
     _pq_node_t *top_val = DEQUEUE(pq->arr, pq->len);
 
     if (!pq->len) {
-        top_val->copies--;
-        return top_val->val;
+        PROBE3(pq_remove, pq, pq->len, 0);
+        TRACE(pq, PQ_TRACE_REMOVE, top_val->val);
+        return _release(top_val);
+    }
+
+    if (TAIL(pq)->flags & PQ_ADAPTIVE && TAIL(pq)->arity != 2) {
+        size_t depth = _pop_shaped(pq);
+
+        STAT(pq, sift_down[DEPTH_BUCKET(depth)]++);
+        PROBE3(pq_remove, pq, pq->len, depth);
+        TRACE(pq, PQ_TRACE_REMOVE, top_val->val);
+        (void)depth;
+
+        return _release(top_val);
+    }
+
+    if (TAIL(pq)->bheap || TAIL(pq)->flags & PQ_LARGE) {
+        size_t last = 0, depth = TAIL(pq)->bheap ? _bh_sift_down(pq, BH(pq, pq->len)) : _sift_down_large(pq, pq->arr[pq->len], &last);
+
+        if (pq->slow & SLOW_MIGRATE)
+            _resync(pq, last);
+
+        STAT(pq, sift_down[DEPTH_BUCKET(depth)]++);
+        PROBE3(pq_remove, pq, pq->len, depth);
+        TRACE(pq, PQ_TRACE_REMOVE, top_val->val);
+        (void)depth;
+
+        return _release(top_val);
     }
 
     pq->arr[0] = pq->arr[pq->len];
 
-    size_t idx = 0;
+    size_t idx = 0, depth = 0;
 
     while (
-            (LEFT(idx) < pq->len && pq->compare(pq->arr[idx]->val, pq->arr[LEFT(idx)]->val) > 0) ||
-            (RIGHT(idx) < pq->len && pq->compare(pq->arr[idx]->val, pq->arr[RIGHT(idx)]->val) > 0)
+            (LEFT(idx) < pq->len && COMPARE(pq, pq->arr[idx]->val, pq->arr[LEFT(idx)]->val) > 0) ||
+            (RIGHT(idx) < pq->len && COMPARE(pq, pq->arr[idx]->val, pq->arr[RIGHT(idx)]->val) > 0)
           ) {
-        char is_left = RIGHT(idx) >= pq->len || pq->compare(pq->arr[LEFT(idx)]->val, pq->arr[RIGHT(idx)]->val) < 0;
+        char is_left = RIGHT(idx) >= pq->len || COMPARE(pq, pq->arr[LEFT(idx)]->val, pq->arr[RIGHT(idx)]->val) < 0;
         _sift_down(pq, idx, is_left);
         idx = is_left ? LEFT(idx) : RIGHT(idx);
+        depth++;
     }
 
-    top_val->copies--;
-    return top_val->val;
+    if (pq->slow & SLOW_MIGRATE)
+        _resync(pq, idx);
+
+    STAT(pq, sift_down[DEPTH_BUCKET(depth)]++);
+    PROBE3(pq_remove, pq, pq->len, depth);
+    TRACE(pq, PQ_TRACE_REMOVE, top_val->val);
+    (void)depth;
+
+    return _release(top_val);
 }
 
-size_t pq_len(pq_t *pq) {
-    if (!pq) {
-        fprintf(stderr, "pq_error: Trying to get len from nullptr\n");
-        abort();
-    }
+const void *pq_remove(pq_t *pq) {
+    _PQ_CHECK(!pq, "Trying to remove from nullptr");
+    _PQ_CHECK(!pq->len && !pq->pending, "Trying to remove element from empty pq");
 
-    return pq->len;
+    return _remove(pq);
 }
 
-size_t pq_size(pq_t *pq) {
-    if (!pq) {
-        fprintf(stderr, "pq_error: Trying to get size from nullptr\n");
-        abort();
-    }
+const void *pq_remove_unchecked(pq_t *pq) {
+    return _remove(pq);
+}
+
+int pq_try_remove(pq_t *pq, const void **out) {
+    if (!pq)
+        return PQ_ENULL;
 
-    return pq->size;
+    if (!pq->len && !pq->pending)
+        return PQ_EEMPTY;
+
+    const void *top = _remove(pq);
+    if (out)
+        *out = top;
+
+    return PQ_OK;
+}
+
+void pq_stats(pq_t *pq, pq_stats_t *out) {
+    if (!pq)
+        _pq_fatal("Trying to get stats from nullptr");
+
+#ifdef PQ_STATS
+    *out = TAIL(pq)->stats;
+#else
+    memset(out, 0, sizeof(pq_stats_t));
+#endif
+}
+
+void pq_stats_reset(pq_t *pq) {
+    if (!pq)
+        _pq_fatal("Trying to reset stats of nullptr");
+
+#ifdef PQ_STATS
+    memset(&TAIL(pq)->stats, 0, sizeof(pq_stats_t));
+    TAIL(pq)->stats.peak_len = pq->len;
+#endif
+}
+
+int pq_trace_start(pq_t *pq, const char *path, uint64_t (*key)(const void *)) {
+    if (!pq)
+        _pq_fatal("Trying to trace nullptr");
+
+#ifdef PQ_TRACE
+    pq_trace_stop(pq);
+
+    FILE *f = fopen(path, "wb");
+    if (!f)
+        return -1;
+
+    uint32_t header[4] = {PQ_TRACE_MAGIC, PQ_TRACE_VERSION, key ? PQ_TRACE_KEYED : 0, 0};
+    fwrite(header, sizeof(header), 1, f);
+
+    _pq_tail_t *t = TAIL(pq);
+
+    t->trace_buf = malloc(TRACE_BUF_RECS * TRACE_REC_SIZE);
+    t->trace_len = 0;
+    t->trace_key = key;
+    t->trace_last = _trace_now();
+    t->trace = f;
+    pq->slow |= SLOW_TRACE;
+    STAT(pq, allocs++);
+
+    return 0;
+#else
+    (void)path;
+    (void)key;
+    return -1;
+#endif
+}
+
+void pq_trace_stop(pq_t *pq) {
+#ifdef PQ_TRACE
+    if (!pq || !TAIL(pq)->trace)
+        return;
+
+    _pq_tail_t *t = TAIL(pq);
+
+    _trace_flush(t);
+    fclose(t->trace);
+    free(t->trace_buf);
+    t->trace = NULL;
+    pq->slow &= ~SLOW_TRACE;
+#else
+    (void)pq;
+#endif
 }
 
 void pq_print(pq_t *pq, const char* (* to_str)(const void *)) {
-    if (!pq) {
-        fprintf(stderr, "pq_error: Trying to print nullptr\n");
-        abort();
-    }
+    if (!pq)
+        _pq_fatal("Trying to print nullptr");
 
-    if (!to_str) {
-        fprintf(stderr, "pq_error: Must provide a print function\n");
-        abort();
-    }
+    if (!to_str)
+        _pq_fatal("Must provide a print function");
 
     pq_t *cp = pq_copy(pq);
 
@@ -0,0 +1,46 @@
+#ifndef PQ_IMPL_H
+#define PQ_IMPL_H
+
+#include "pq.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * A queue as allocated by the library: the public members of pq.h followed by the
+ * private state, which callers never see, so that it can change without breaking
+ * the offsets read by inlined accessors. Only the library and its tests include
+ * this header.
+ */
+typedef struct {
+    pq_t                pq;
+    int                 (*compare)(const void *, const void *);
+    unsigned            flags;
+    struct _pq_bheap    *bheap;
+    _pq_node_t          **pend;
+    size_t              pend_heap;
+    size_t              pend_cap;
+    size_t              lazy_min;
+    _pq_node_t          **grow;
+    size_t              grow_size;
+    size_t              migrated;
+    size_t              budget;
+    unsigned            arity;
+    size_t              adapt_ops;
+    size_t              adapt_ins;
+    size_t              adapt_since;
+#ifdef PQ_STATS
+    pq_stats_t          stats;
+#endif
+#ifdef PQ_TRACE
+    FILE                *trace;
+    uint64_t            (*trace_key)(const void *);
+    uint64_t            trace_last;
+    size_t              trace_len;
+    unsigned char       *trace_buf;
+#endif
+} _pq_tail_t;
+
+#define TAIL(pq) ((_pq_tail_t *)(pq))
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef PROBES_H
+#define PROBES_H
+
+/*
+ * Static tracepoints (USDT) for bpftrace/perf/systemtap, provider "guilib".
+ *
+ * Probes are emitted through <sys/sdt.h> when it is available and compile to
+ * nothing otherwise, or when GUILIB_NO_SDT is defined. An unattached probe is a
+ * single nop in the instruction stream.
+ */
+
+#if !defined(GUILIB_NO_SDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define GUILIB_SDT 1
+#endif
+#endif
+
+#ifdef GUILIB_SDT
+#define PROBE2(name, a, b) DTRACE_PROBE2(guilib, name, a, b)
+#define PROBE3(name, a, b, c) DTRACE_PROBE3(guilib, name, a, b, c)
+#else
+#define PROBE2(name, a, b) ((void)0)
+#define PROBE3(name, a, b, c) ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,198 @@
+#include "utils.h"
+#include "spq.h"
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define PREFIX_LEN 8
+#define UP(i) (((i) - 1) >> 1)
+#define LEFT(i) (2 * (i) + 1)
+
+typedef struct {
+    uint64_t            prefix;
+    const char          *key;
+    void                *val;
+} _spq_entry_t;
+
+struct _spq_t {
+    size_t              len;
+    size_t              size;
+    size_t              fallbacks;
+    _spq_entry_t        *heap;
+};
+
+/*
+ * First PREFIX_LEN bytes of s, zero padded, most significant byte first: comparing
+ * two prefixes as integers orders them like strcmp() orders the strings' heads.
+ */
+static inline uint64_t _spq_prefix(const char *s) {
+    uint64_t p = 0;
+
+    for (int i = 0; i < PREFIX_LEN && s[i]; i++)
+        p |= (uint64_t)(unsigned char)s[i] << (8 * (PREFIX_LEN - 1 - i));
+
+    return p;
+}
+
+static inline char _spq_less(spq_t *spq, const _spq_entry_t *a, const _spq_entry_t *b) {
+    if (a->prefix != b->prefix)
+        return a->prefix < b->prefix;
+
+    /* A zero last byte means both strings ended inside the prefix: they are equal. */
+    if (!(a->prefix & 0xff))
+        return 0;
+
+    spq->fallbacks++;
+    return strcmp(a->key + PREFIX_LEN, b->key + PREFIX_LEN) < 0;
+}
+
+static void _spq_sift_up(spq_t *spq, size_t pos) {
+    _spq_entry_t e = spq->heap[pos];
+
+    while (pos > 0 && _spq_less(spq, &e, &spq->heap[UP(pos)])) {
+        spq->heap[pos] = spq->heap[UP(pos)];
+        pos = UP(pos);
+    }
+
+    spq->heap[pos] = e;
+}
+
+static void _spq_sift_down(spq_t *spq, size_t pos) {
+    _spq_entry_t e = spq->heap[pos];
+    size_t c;
+
+    while ((c = LEFT(pos)) < spq->len) {
+        c += c + 1 < spq->len && _spq_less(spq, &spq->heap[c + 1], &spq->heap[c]);
+        if (!_spq_less(spq, &spq->heap[c], &e))
+            break;
+
+        spq->heap[pos] = spq->heap[c];
+        pos = c;
+    }
+
+    spq->heap[pos] = e;
+}
+
+spq_t *spq_create(size_t size) {
+    spq_t *spq_ptr = malloc(sizeof(spq_t));
+    spq_ptr->len = 0;
+    spq_ptr->size = size;
+    spq_ptr->fallbacks = 0;
+    spq_ptr->heap = malloc((size ? size : 1) * sizeof(_spq_entry_t));
+
+    return spq_ptr;
+}
+
+spq_t *spq_copy(spq_t *source_spq) {
+    if (!source_spq) {
+        fprintf(stderr, "spq_error: Trying to copy from nullptr\n");
+        abort();
+    }
+
+    spq_t *spq_ptr = spq_create(source_spq->size);
+    spq_ptr->len = source_spq->len;
+    memcpy(spq_ptr->heap, source_spq->heap, source_spq->len * sizeof(_spq_entry_t));
+
+    return spq_ptr;
+}
+
+void spq_destroy(spq_t *spq, void (*free_func)(void *)) {
+    if (free_func)
+        for (size_t i = 0; i < spq->len; i++)
+            free_func(spq->heap[i].val);
+
+    free(spq->heap);
+    free(spq);
+}
+
+void spq_insert(spq_t *spq, const char *key, void *i) {
+    if (!spq) {
+        fprintf(stderr, "spq_error: Trying to insert to nullptr\n");
+        abort();
+    }
+
+    if (!key) {
+        fprintf(stderr, "spq_error: Key must not be nullptr\n");
+        abort();
+    }
+
+    if (spq->len + 1 > spq->size) {
+        fprintf(stderr, "spq_error: New length %zu is greater than spq size %zu\n", spq->len + 1, spq->size);
+        abort();
+    }
+
+    spq->heap[spq->len] = (_spq_entry_t){_spq_prefix(key), key, i};
+    _spq_sift_up(spq, spq->len++);
+}
+
+char spq_is_empty(spq_t *spq) {
+    return !spq->len;
+}
+
+void *spq_peek(spq_t *spq, const char **key) {
+    if (!spq) {
+        fprintf(stderr, "spq_error: Trying to peek in nullptr\n");
+        abort();
+    }
+
+    if (!spq->len) {
+        fprintf(stderr, "spq_error: Trying to access element in empty spq\n");
+        abort();
+    }
+
+    if (key)
+        *key = spq->heap[0].key;
+
+    return spq->heap[0].val;
+}
+
+void *spq_remove(spq_t *spq, const char **key) {
+    if (!spq) {
+        fprintf(stderr, "spq_error: Trying to remove from nullptr\n");
+        abort();
+    }
+
+    if (!spq->len) {
+        fprintf(stderr, "spq_error: Trying to remove element from empty spq\n");
+        abort();
+    }
+
+    _spq_entry_t top = spq->heap[0];
+    if (key)
+        *key = top.key;
+
+    if (--spq->len) {
+        spq->heap[0] = spq->heap[spq->len];
+        _spq_sift_down(spq, 0);
+    }
+
+    return top.val;
+}
+
+size_t spq_len(spq_t *spq) {
+    if (!spq) {
+        fprintf(stderr, "spq_error: Trying to get len from nullptr\n");
+        abort();
+    }
+
+    return spq->len;
+}
+
+size_t spq_size(spq_t *spq) {
+    if (!spq) {
+        fprintf(stderr, "spq_error: Trying to get size from nullptr\n");
+        abort();
+    }
+
+    return spq->size;
+}
+
+size_t spq_fallbacks(spq_t *spq) {
+    if (!spq) {
+        fprintf(stderr, "spq_error: Trying to get fallbacks from nullptr\n");
+        abort();
+    }
+
+    return spq->fallbacks;
+}
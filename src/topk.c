@@ -0,0 +1,326 @@
+#include "utils.h"
+#include "topk.h"
+#include "dheap.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define ARITY 2
+#define RESERVE_MIN 64
+
+typedef struct {
+    double              score;
+    uint64_t            seq;
+    uint64_t            time;
+    uint64_t            id;
+} _topk_entry_t;
+
+/*
+ * `top` is a min-heap (worst item at the root) of the current top, `reserve` a
+ * max-heap of its first `heaped` items followed by items appended unsorted, which
+ * is only heaped for a refill and left sorted oldest first by compaction. Every
+ * reserve item ranks below every top item. `oldest` is at most the time of every
+ * top item. `band` and `spare` are k-item buffers for compaction and snapshots.
+ */
+struct _topk_t {
+    size_t              k;
+    uint64_t            window;
+    uint64_t            now;
+    uint64_t            seq;
+    uint64_t            oldest;
+    _topk_entry_t       *top;
+    size_t              len;
+    _topk_entry_t       *reserve;
+    size_t              held;
+    size_t              heaped;
+    size_t              cap;
+    size_t              compact_at;
+    _topk_entry_t       *band;
+    _topk_entry_t       *spare;
+};
+
+static inline int _topk_better(const _topk_entry_t *a, const _topk_entry_t *b) {
+    return a->score > b->score || (a->score == b->score && a->seq > b->seq);
+}
+
+static inline int _topk_live(const topk_t *tk, uint64_t time) {
+    return tk->now - time < tk->window;
+}
+
+static inline int _topk_worse(const _topk_entry_t *a, const _topk_entry_t *b) {
+    return _topk_better(b, a);
+}
+
+#define ENTRY(h, i) (&(h)[i])
+#define ENTRY_OF(x) (&(x))
+#define GET(h, i) ((h)[i])
+#define PUT(h, i, x) ((h)[i] = (x))
+
+/* Min-heaps keep the worst item at the root, max-heaps the best. */
+DEFINE_DHEAP(_topk_min, _topk_entry_t, _topk_entry_t, ARITY, ENTRY, ENTRY_OF, _topk_worse, GET, PUT)
+DEFINE_DHEAP(_topk_max, _topk_entry_t, _topk_entry_t, ARITY, ENTRY, ENTRY_OF, _topk_better, GET, PUT)
+
+static inline void _topk_defer(topk_t *tk, const _topk_entry_t *e) {
+    if (tk->held == tk->cap) {
+        tk->cap *= 2;
+        tk->reserve = realloc(tk->reserve, tk->cap * sizeof(_topk_entry_t));
+    }
+
+    tk->reserve[tk->held++] = *e;
+}
+
+/* Orders the unsorted tail of the reserve. */
+static void _topk_absorb(topk_t *tk) {
+    if (2 * (tk->held - tk->heaped) >= tk->heaped) {
+        _topk_max_heapify(tk->reserve, tk->held);
+    } else {
+        for (size_t i = tk->heaped; i < tk->held; i++)
+            _topk_max_sift_up(tk->reserve, i, tk->reserve[i]);
+    }
+
+    tk->heaped = tk->held;
+}
+
+static inline void _topk_push(topk_t *tk, const _topk_entry_t *e) {
+    _topk_min_sift_up(tk->top, tk->len++, *e);
+
+    if (tk->len == 1 || e->time < tk->oldest)
+        tk->oldest = e->time;
+}
+
+/* Fills the top back up with the best live reserve items, dropping expired ones. */
+static void _topk_refill(topk_t *tk) {
+    if (tk->heaped < tk->held)
+        _topk_absorb(tk);
+
+    while (tk->len < tk->k && tk->held) {
+        _topk_entry_t best = tk->reserve[0];
+
+        tk->heaped = --tk->held;
+        _topk_max_fill(tk->reserve, tk->held, 0);
+
+        if (_topk_live(tk, best.time))
+            _topk_push(tk, &best);
+    }
+}
+
+static void _topk_expire(topk_t *tk) {
+    if (!tk->len || _topk_live(tk, tk->oldest))
+        return;
+
+    size_t len = 0;
+    uint64_t oldest = tk->now;
+
+    for (size_t i = 0; i < tk->len; i++) {
+        if (_topk_live(tk, tk->top[i].time)) {
+            oldest = tk->top[i].time < oldest ? tk->top[i].time : oldest;
+            tk->top[len++] = tk->top[i];
+        }
+    }
+
+    tk->oldest = oldest;
+    if (len < tk->len) {
+        tk->len = len;
+        _topk_min_heapify(tk->top, len);
+        _topk_refill(tk);
+    }
+}
+
+static int _topk_older(const void *a, const void *b) {
+    uint64_t x = ((const _topk_entry_t *)a)->seq, y = ((const _topk_entry_t *)b)->seq;
+    return (x > y) - (x < y);
+}
+
+/*
+ * Sorts the reserve oldest first. Compaction leaves it sorted and most items are
+ * appended newest, so unless a refill heaped it, only the few items pushed out of
+ * the top are out of place: they are set aside in `band`, sorted and merged back.
+ */
+static void _topk_order(topk_t *tk) {
+    _topk_entry_t *r = tk->reserve;
+    size_t run = 0;
+
+    if (!tk->heaped) {
+        for (size_t i = 0; i < tk->held; i++) {
+            if (run && r[i].seq < r[run - 1].seq)
+                continue;
+
+            _topk_entry_t x = r[i];
+            r[i] = r[run];
+            r[run++] = x;
+        }
+    }
+
+    size_t d = tk->held - run;
+    if (tk->heaped || d > tk->k) {
+        qsort(r, tk->held, sizeof(_topk_entry_t), _topk_older);
+        return;
+    }
+
+    memcpy(tk->band, r + run, d * sizeof(_topk_entry_t));
+    qsort(tk->band, d, sizeof(_topk_entry_t), _topk_older);
+
+    for (size_t w = tk->held; d;)
+        r[--w] = run && r[run - 1].seq > tk->band[d - 1].seq ? r[--run] : tk->band[--d];
+}
+
+/* Adds an item to the k best seen so far, kept in `band` as a min-heap. */
+static inline void _topk_band(topk_t *tk, size_t *n, const _topk_entry_t *e) {
+    if (*n < tk->k) {
+        _topk_min_sift_up(tk->band, (*n)++, *e);
+    } else if (_topk_better(e, &tk->band[0])) {
+        _topk_min_sift_down(tk->band, *n, 0, *e);
+    }
+}
+
+/*
+ * Drops the expired reserve items and those outranked by k more recent items, which
+ * expire no earlier. Sweeps the top and the reserve from the most recent item on,
+ * keeping the k best items seen so far in `band`. Survivors stay oldest first.
+ */
+static void _topk_compact(topk_t *tk) {
+    memcpy(tk->spare, tk->top, tk->len * sizeof(_topk_entry_t));
+    qsort(tk->spare, tk->len, sizeof(_topk_entry_t), _topk_older);
+    _topk_order(tk);
+
+    size_t t = tk->len, w = tk->held, n = 0;
+
+    for (size_t r = tk->held; r-- > 0;) {
+        const _topk_entry_t *e = &tk->reserve[r];
+
+        while (t > 0 && tk->spare[t - 1].seq > e->seq)
+            _topk_band(tk, &n, &tk->spare[--t]);
+
+        if (!_topk_live(tk, e->time) || (n == tk->k && !_topk_better(e, &tk->band[0])))
+            continue;
+
+        _topk_band(tk, &n, e);
+        tk->reserve[--w] = *e;
+    }
+
+    size_t kept = tk->held - w;
+    memmove(tk->reserve, tk->reserve + w, kept * sizeof(_topk_entry_t));
+    tk->held = kept;
+    tk->heaped = 0;
+
+    tk->compact_at = 4 * kept > RESERVE_MIN + 2 * tk->k ? 4 * kept : RESERVE_MIN + 2 * tk->k;
+}
+
+static void _topk_advance(topk_t *tk, uint64_t now) {
+    if (now < tk->now) {
+        fprintf(stderr, "topk_error: Time %llu is before the current time %llu\n",
+                (unsigned long long)now, (unsigned long long)tk->now);
+        abort();
+    }
+
+    tk->now = now;
+    _topk_expire(tk);
+}
+
+topk_t *topk_create(size_t k, uint64_t window) {
+    if (!k || !window) {
+        fprintf(stderr, "topk_error: Tracking the top %zu over a window of %llu\n", k, (unsigned long long)window);
+        abort();
+    }
+
+    topk_t *tk_ptr = malloc(sizeof(topk_t));
+    tk_ptr->k = k;
+    tk_ptr->window = window;
+    tk_ptr->now = 0;
+    tk_ptr->seq = 0;
+    tk_ptr->oldest = 0;
+    tk_ptr->top = malloc(k * sizeof(_topk_entry_t));
+    tk_ptr->len = 0;
+    tk_ptr->cap = RESERVE_MIN + 2 * k;
+    tk_ptr->reserve = malloc(tk_ptr->cap * sizeof(_topk_entry_t));
+    tk_ptr->held = tk_ptr->heaped = 0;
+    tk_ptr->compact_at = tk_ptr->cap;
+    tk_ptr->band = malloc(k * sizeof(_topk_entry_t));
+    tk_ptr->spare = malloc(k * sizeof(_topk_entry_t));
+
+    return tk_ptr;
+}
+
+void topk_destroy(topk_t *tk) {
+    free(tk->top);
+    free(tk->reserve);
+    free(tk->band);
+    free(tk->spare);
+    free(tk);
+}
+
+void topk_add(topk_t *tk, uint64_t time, double score, uint64_t id) {
+    if (!tk) {
+        fprintf(stderr, "topk_error: Trying to add to nullptr\n");
+        abort();
+    }
+
+    if (score != score) {
+        fprintf(stderr, "topk_error: Trying to add a NaN score\n");
+        abort();
+    }
+
+    if (time != tk->now)
+        _topk_advance(tk, time);
+
+    _topk_entry_t e = {score, tk->seq++, time, id};
+
+    if (tk->len < tk->k) {
+        _topk_push(tk, &e);
+        return;
+    }
+
+    /* Ties go to the newer item, so matching the worst is enough. */
+    if (score >= tk->top[0].score) {
+        _topk_defer(tk, &tk->top[0]);
+        _topk_min_sift_down(tk->top, tk->len, 0, e);
+    } else {
+        _topk_defer(tk, &e);
+    }
+
+    if (tk->held >= tk->compact_at)
+        _topk_compact(tk);
+}
+
+void topk_advance(topk_t *tk, uint64_t now) {
+    if (!tk) {
+        fprintf(stderr, "topk_error: Trying to advance nullptr\n");
+        abort();
+    }
+
+    _topk_advance(tk, now);
+}
+
+size_t topk_snapshot(topk_t *tk, topk_item_t *out, size_t cap) {
+    if (!tk) {
+        fprintf(stderr, "topk_error: Trying to read nullptr\n");
+        abort();
+    }
+
+    /* Heapsort of a copy of the min-heap: the worst items go to the back first. */
+    size_t len = tk->len;
+    memcpy(tk->spare, tk->top, len * sizeof(_topk_entry_t));
+
+    for (size_t end = len; end > 1; end--) {
+        _topk_entry_t worst = tk->spare[0];
+
+        _topk_min_sift_down(tk->spare, end - 1, 0, tk->spare[end - 1]);
+        tk->spare[end - 1] = worst;
+    }
+
+    size_t n = cap < len ? cap : len;
+    for (size_t i = 0; i < n; i++)
+        out[i] = (topk_item_t){tk->spare[i].score, tk->spare[i].time, tk->spare[i].id};
+
+    return n;
+}
+
+size_t topk_len(topk_t *tk) {
+    return tk->len;
+}
+
+size_t topk_held(topk_t *tk) {
+    return tk->len + tk->held;
+}
@@ -0,0 +1,201 @@
+#include "utils.h"
+#include "veb.h"
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define WORD_SHIFT 6
+#define WORD_BITS (1 << WORD_SHIFT)
+#define WORD_MASK (WORD_BITS - 1)
+#define MAX_UNIVERSE (1ULL << 32)
+#define MAX_LEVELS 6
+
+#define BIT(x) (1ULL << ((x) & WORD_MASK))
+
+/*
+ * bits[0] holds one bit per key. Bit i of bits[l + 1] is set when word i of
+ * bits[l] is not zero. The top level is a single word.
+ */
+struct _veb_t {
+    size_t              len;
+    uint64_t            universe;
+    unsigned            levels;
+    size_t              words[MAX_LEVELS];
+    uint64_t            *bits[MAX_LEVELS];
+};
+
+static void _veb_alloc(veb_t *veb, uint64_t universe) {
+    size_t n = (universe + WORD_MASK) >> WORD_SHIFT;
+
+    veb->len = 0;
+    veb->universe = universe;
+    veb->levels = 0;
+
+    do {
+        veb->words[veb->levels] = n;
+        veb->bits[veb->levels++] = calloc(n, sizeof(uint64_t));
+        n = (n + WORD_MASK) >> WORD_SHIFT;
+    } while (veb->words[veb->levels - 1] > 1);
+}
+
+/* Smallest key below the set bit `i` of level `l`. */
+static inline uint64_t _veb_descend(const veb_t *veb, unsigned l, uint64_t i) {
+    while (l--)
+        i = (i << WORD_SHIFT) | __builtin_ctzll(veb->bits[l][i]);
+    return i;
+}
+
+veb_t *veb_create(uint64_t universe) {
+    if (!universe || universe > MAX_UNIVERSE) {
+        fprintf(stderr, "veb_error: Universe %llu is not between 1 and 2^32\n", (unsigned long long)universe);
+        abort();
+    }
+
+    veb_t *veb_ptr = malloc(sizeof(veb_t));
+    _veb_alloc(veb_ptr, universe);
+
+    return veb_ptr;
+}
+
+veb_t *veb_copy(veb_t *source_veb) {
+    if (!source_veb) {
+        fprintf(stderr, "veb_error: Trying to copy from nullptr\n");
+        abort();
+    }
+
+    veb_t *veb_ptr = malloc(sizeof(veb_t));
+    _veb_alloc(veb_ptr, source_veb->universe);
+    veb_ptr->len = source_veb->len;
+
+    for (unsigned l = 0; l < source_veb->levels; l++)
+        memcpy(veb_ptr->bits[l], source_veb->bits[l], source_veb->words[l] * sizeof(uint64_t));
+
+    return veb_ptr;
+}
+
+void veb_destroy(veb_t *veb) {
+    for (unsigned l = 0; l < veb->levels; l++)
+        free(veb->bits[l]);
+
+    free(veb);
+}
+
+char veb_insert(veb_t *veb, uint32_t key) {
+    if (!veb) {
+        fprintf(stderr, "veb_error: Trying to insert to nullptr\n");
+        abort();
+    }
+
+    if (key >= veb->universe) {
+        fprintf(stderr, "veb_error: Key %u is out of universe %llu\n", key, (unsigned long long)veb->universe);
+        abort();
+    }
+
+    uint64_t x = key, *w = &veb->bits[0][x >> WORD_SHIFT];
+    if (*w & BIT(x))
+        return 0;
+
+    /* Ancestors only need updating while the words below were empty. */
+    for (unsigned l = 0; l < veb->levels; l++, x >>= WORD_SHIFT) {
+        w = &veb->bits[l][x >> WORD_SHIFT];
+        uint64_t was = *w;
+        *w = was | BIT(x);
+        if (was)
+            break;
+    }
+
+    veb->len++;
+    return 1;
+}
+
+char veb_erase(veb_t *veb, uint32_t key) {
+    if (!veb) {
+        fprintf(stderr, "veb_error: Trying to erase from nullptr\n");
+        abort();
+    }
+
+    if (key >= veb->universe || !(veb->bits[0][key >> WORD_SHIFT] & BIT(key)))
+        return 0;
+
+    uint64_t x = key;
+    for (unsigned l = 0; l < veb->levels; l++, x >>= WORD_SHIFT)
+        if ((veb->bits[l][x >> WORD_SHIFT] &= ~BIT(x)))
+            break;
+
+    veb->len--;
+    return 1;
+}
+
+char veb_contains(veb_t *veb, uint32_t key) {
+    return key < veb->universe && (veb->bits[0][key >> WORD_SHIFT] & BIT(key)) != 0;
+}
+
+char veb_is_empty(veb_t *veb) {
+    return !veb->len;
+}
+
+uint32_t veb_peek(veb_t *veb) {
+    if (!veb) {
+        fprintf(stderr, "veb_error: Trying to peek in nullptr\n");
+        abort();
+    }
+
+    if (!veb->len) {
+        fprintf(stderr, "veb_error: Trying to access element in empty veb\n");
+        abort();
+    }
+
+    return (uint32_t)_veb_descend(veb, veb->levels, 0);
+}
+
+uint32_t veb_remove(veb_t *veb) {
+    uint32_t key = veb_peek(veb);
+
+    veb_erase(veb, key);
+    return key;
+}
+
+char veb_succ(veb_t *veb, uint32_t key, uint32_t *out) {
+    if (!veb) {
+        fprintf(stderr, "veb_error: Trying to search in nullptr\n");
+        abort();
+    }
+
+    /* Climb until a word holds a bit at or after y, then take the smallest key below it. */
+    uint64_t y = (uint64_t)key + 1;
+
+    for (unsigned l = 0; l < veb->levels; l++) {
+        uint64_t i = y >> WORD_SHIFT;
+        if (i >= veb->words[l])
+            return 0;
+
+        uint64_t m = veb->bits[l][i] & (~0ULL << (y & WORD_MASK));
+        if (m) {
+            *out = (uint32_t)_veb_descend(veb, l, (i << WORD_SHIFT) | __builtin_ctzll(m));
+            return 1;
+        }
+
+        y = i + 1;
+    }
+
+    return 0;
+}
+
+size_t veb_len(veb_t *veb) {
+    if (!veb) {
+        fprintf(stderr, "veb_error: Trying to get len from nullptr\n");
+        abort();
+    }
+
+    return veb->len;
+}
+
+uint64_t veb_universe(veb_t *veb) {
+    if (!veb) {
+        fprintf(stderr, "veb_error: Trying to get universe from nullptr\n");
+        abort();
+    }
+
+    return veb->universe;
+}
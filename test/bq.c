@@ -0,0 +1,181 @@
+#include "bq.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Randomized tests of bq_t against a sorted array of the queued elements, kept in
+ * priority order and in insertion order among equal priorities. Each peek and
+ * removal must return the front of the array, ties included. Priorities favor the
+ * first and last bucket and the buckets on either side of a bitmap word boundary,
+ * and queues are drained to empty and refilled, so that buckets and bitmap words
+ * keep going from empty to full and back.
+ */
+
+#define CHECK(cond, ...) do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: ", __FILE__, __LINE__); \
+            fprintf(stderr, __VA_ARGS__); \
+            fprintf(stderr, "\n"); \
+            exit(1); \
+        } \
+    } while (0)
+
+#define ITEMS 2048
+
+typedef struct {
+    bq_node_t           node;
+    unsigned            prio;
+    size_t              seq;
+} item_t;
+
+typedef struct {
+    item_t              **arr;
+    size_t              len;
+} model_t;
+
+static uint64_t rng_state = 0xbb67ae8584caa73bULL;
+
+static uint64_t rng(void) {
+    uint64_t z = (rng_state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/* The first and last priority, either side of a 64 bit word, a narrow band or anything. */
+static unsigned rand_prio(unsigned prios) {
+    unsigned word = 64 * (unsigned)(rng() % (prios / 64 + 1)), p;
+
+    switch (rng() % 5) {
+        case 0:
+            return rng() & 1 ? 0 : prios - 1;
+        case 1:
+            p = word + (unsigned)(rng() % 2);
+            return p ? (p <= prios ? p - 1 : prios - 1) : 0;
+        case 2:
+            return (unsigned)(rng() % (prios < 4 ? prios : 4));
+        default:
+            return (unsigned)(rng() % prios);
+    }
+}
+
+/* Inserts after every element of the same or a smaller priority. */
+static void model_push(model_t *m, item_t *it) {
+    size_t lo = 0, hi = m->len;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if (m->arr[mid]->prio <= it->prio)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    memmove(&m->arr[lo + 1], &m->arr[lo], (m->len - lo) * sizeof(item_t *));
+    m->arr[lo] = it;
+    m->len++;
+}
+
+static item_t *model_pop(model_t *m) {
+    item_t *it = m->arr[0];
+
+    memmove(&m->arr[0], &m->arr[1], --m->len * sizeof(item_t *));
+    return it;
+}
+
+static void check_top(bq_t *bq, const model_t *m, int remove) {
+    unsigned prio = ~0u;
+    bq_node_t *node = remove ? bq_remove(bq, &prio) : bq_peek(bq, &prio);
+    item_t *got = BQ_ENTRY(node, item_t, node), *want = m->arr[0];
+
+    CHECK(got == want, "%s returned priority %u #%zu, model front is priority %u #%zu", remove ? "remove" : "peek",
+          got->prio, got->seq, want->prio, want->seq);
+    CHECK(prio == want->prio, "%s reported priority %u for an element of priority %u", remove ? "remove" : "peek",
+          prio, want->prio);
+}
+
+static size_t freed;
+
+static void count_free(bq_node_t *node) {
+    item_t *it = BQ_ENTRY(node, item_t, node);
+
+    it->prio = ~0u;
+    freed++;
+}
+
+static void test_model(void) {
+    static const unsigned prios[] = {1, 2, 63, 64, 65, 128, 129, 1000, BQ_MAX_PRIOS};
+    item_t *items = malloc(ITEMS * sizeof(item_t));
+    size_t ties = 0, refills = 0, edges = 0, seq = 0;
+
+    for (size_t p = 0; p < sizeof(prios) / sizeof(*prios); p++) {
+        bq_t *bq = bq_create(prios[p]);
+        model_t m = {malloc(ITEMS * sizeof(item_t *)), 0};
+        item_t **spare = malloc(ITEMS * sizeof(item_t *));
+        size_t spares = ITEMS;
+
+        CHECK(bq_prios(bq) == prios[p], "bq_prios() is %u, created with %u", bq_prios(bq), prios[p]);
+        for (size_t i = 0; i < ITEMS; i++)
+            spare[i] = &items[i];
+
+        for (int step = 0; step < 100000; step++) {
+            uint64_t r = rng() % 100;
+
+            if ((r < 48 || !m.len) && spares) {
+                item_t *it = spare[--spares];
+
+                it->prio = rand_prio(prios[p]);
+                it->seq = seq++;
+                bq_insert(bq, &it->node, it->prio);
+                model_push(&m, it);
+            } else if (r < 88 && m.len) {
+                item_t *want = m.arr[0];
+
+                ties += m.len > 1 && m.arr[1]->prio == want->prio;
+                edges += want->prio == prios[p] - 1 || want->prio % 64 == 63 || (want->prio && want->prio % 64 == 0);
+
+                check_top(bq, &m, 1);
+                spare[spares++] = model_pop(&m);
+            } else if (m.len) {
+                check_top(bq, &m, 0);
+            }
+
+            CHECK(bq_len(bq) == m.len, "len %zu, model has %zu", bq_len(bq), m.len);
+            CHECK(bq_is_empty(bq) == !m.len, "bq_is_empty() is %d with %zu elements", bq_is_empty(bq), m.len);
+
+            /* Now and then drain completely, emptying every bucket and bitmap word. */
+            if (rng() % 5000 == 0) {
+                while (m.len) {
+                    check_top(bq, &m, 1);
+                    spare[spares++] = model_pop(&m);
+                }
+                CHECK(bq_is_empty(bq), "queue not empty after draining the model");
+                refills++;
+            }
+        }
+
+        /* Destroyed non-empty, free_func sees every queued node once and nothing else. */
+        freed = 0;
+        bq_destroy(bq, count_free);
+        CHECK(freed == m.len, "destroy freed %zu of %zu nodes", freed, m.len);
+        for (size_t i = 0; i < m.len; i++)
+            CHECK(m.arr[i]->prio == ~0u, "destroy skipped a node");
+
+        free(spare);
+        free(m.arr);
+    }
+
+    free(items);
+    CHECK(ties && refills && edges, "no tie (%zu), refill (%zu) or removal at a boundary bucket (%zu)", ties, refills,
+          edges);
+}
+
+int main(void) {
+    test_model();
+
+    printf("bq: ok\n");
+    return 0;
+}
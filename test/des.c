@@ -0,0 +1,258 @@
+#include "des.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Randomized tests of des_t, one simulation on each backend driven by the same
+ * random choices. Every scheduled event is mirrored by a record of its timestamp,
+ * its order of scheduling and whether it is pending. Events must run in timestamp
+ * order, in scheduling order within a timestamp, only while pending, and not in the
+ * des_step() that scheduled them; des_cancel() must succeed exactly on pending
+ * events, including those of the running batch. Handlers schedule and cancel
+ * events too. Bursts of thousands of events with skewed timestamps make the
+ * calendar grow and shrink. In the end the calendar must have run the same events
+ * in the same order as the heap.
+ */
+
+#define CHECK(cond, ...) do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: ", __FILE__, __LINE__); \
+            fprintf(stderr, __VA_ARGS__); \
+            fprintf(stderr, "\n"); \
+            exit(1); \
+        } \
+    } while (0)
+
+#define EVENTS 300000
+#define BURST 5000
+
+typedef struct world world_t;
+
+typedef struct {
+    world_t             *w;
+    uint64_t            time;
+    size_t              num;
+    size_t              step;
+    des_id_t            id;
+    char                pending;
+    char                fired;
+} record_t;
+
+typedef struct {
+    size_t              batches;
+    size_t              batch_cancels;
+    size_t              stale_fired;
+    size_t              stale_cancelled;
+    size_t              same_time;
+} seen_t;
+
+/*
+ * A simulation and its records. `step` counts the calls to des_step(), so that the
+ * events scheduled during the running one are those of the current count.
+ */
+struct world {
+    des_t               *des;
+    uint64_t            rng;
+    record_t            *recs;
+    size_t              len;
+    size_t              pending;
+    size_t              *log;
+    size_t              ran;
+    size_t              step;
+    char                running;
+    uint64_t            next;
+    uint64_t            last_time;
+    size_t              last_num;
+    seen_t              seen;
+};
+
+static uint64_t rng(world_t *w) {
+    uint64_t z = (w->rng += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/* The same timestamp, a few units on, evenly spread, or a power of two away. */
+static uint64_t rand_delay(world_t *w) {
+    switch (rng(w) % 5) {
+        case 0:
+            return 0;
+        case 1:
+            return rng(w) % 4;
+        case 2:
+            return rng(w) % 1000;
+        case 3:
+            return (uint64_t)1 << rng(w) % 40;
+        default:
+            return rng(w) % 50 ? rng(w) % 100000 : (uint64_t)1 << 50;
+    }
+}
+
+static void handler(des_t *des, void *arg);
+
+static void schedule(world_t *w, uint64_t time) {
+    record_t *r = &w->recs[w->len];
+
+    *r = (record_t){w, time, w->len, w->step, DES_NONE, 1, 0};
+    r->id = des_schedule(w->des, time, handler, r);
+    w->len++;
+    w->pending++;
+}
+
+/* Cancels an event picked among all those ever scheduled, pending or not. */
+static void cancel(world_t *w) {
+    record_t *r = &w->recs[rng(w) % w->len];
+    char want = r->pending, got = des_cancel(w->des, r->id);
+
+    CHECK(got == want, "cancel of event %zu returned %d, it is %s", r->num, got, want ? "pending" : "stale");
+
+    if (want) {
+        /* Taken off the list by the running step but not run yet. */
+        w->seen.batch_cancels += w->running && r->time == w->next && r->step < w->step;
+        r->pending = 0;
+        w->pending--;
+    } else if (r->fired) {
+        w->seen.stale_fired++;
+    } else {
+        w->seen.stale_cancelled++;
+    }
+}
+
+static void handler(des_t *des, void *arg) {
+    record_t *r = arg;
+    world_t *w = r->w;
+
+    CHECK(r->pending, "event %zu ran but is not pending", r->num);
+    CHECK(r->step < w->step, "event %zu ran in the step that scheduled it", r->num);
+    CHECK(r->time == des_now(des) && r->time == w->next, "event %zu of time %llu ran at %llu, next was %llu",
+          r->num, (unsigned long long)r->time, (unsigned long long)des_now(des), (unsigned long long)w->next);
+    CHECK(!w->ran || r->time > w->last_time || r->num > w->last_num,
+          "event %zu of time %llu ran after event %zu of time %llu", r->num, (unsigned long long)r->time,
+          w->last_num, (unsigned long long)w->last_time);
+
+    r->pending = 0;
+    r->fired = 1;
+    w->pending--;
+    w->log[w->ran++] = r->num;
+    w->last_time = r->time;
+    w->last_num = r->num;
+
+    /* Handlers schedule, at their own timestamp too, and cancel. */
+    uint64_t x = rng(w) % 100;
+    if (x < 35 && w->len < EVENTS) {
+        uint64_t delay = rand_delay(w);
+
+        w->seen.same_time += !delay;
+        schedule(w, des_now(des) + delay);
+    } else if (x < 50) {
+        cancel(w);
+    }
+}
+
+static void check_len(world_t *w) {
+    CHECK(des_len(w->des) == w->pending, "len %zu, %zu events pending", des_len(w->des), w->pending);
+}
+
+/* Runs the next timestamp. */
+static void step(world_t *w) {
+    size_t before = w->ran;
+
+    w->next = des_next(w->des);
+    w->step++;
+    w->running = 1;
+
+    size_t ran = des_step(w->des);
+
+    w->running = 0;
+    CHECK(ran == w->ran - before, "step reported %zu events, %zu ran", ran, w->ran - before);
+    CHECK(w->next == DES_NEVER ? !ran : des_now(w->des) == w->next, "step to %llu left the clock at %llu",
+          (unsigned long long)w->next, (unsigned long long)des_now(w->des));
+    w->seen.batches += ran > 1;
+    check_len(w);
+}
+
+/* Schedules, cancels and steps at random, with bursts that are then run to the end. */
+static void simulate(world_t *w) {
+    while (w->len < EVENTS - BURST) {
+        uint64_t x = rng(w) % 100;
+
+        if (x < 40) {
+            schedule(w, des_now(w->des) + rand_delay(w));
+        } else if (x < 50) {
+            cancel(w);
+        } else if (x < 99) {
+            step(w);
+        } else {
+            size_t n = rng(w) % BURST;
+
+            for (size_t i = 0; i < n; i++)
+                schedule(w, des_now(w->des) + rand_delay(w));
+            check_len(w);
+
+            while (w->pending)
+                step(w);
+            CHECK(des_next(w->des) == DES_NEVER, "next is %llu with no event pending",
+                  (unsigned long long)des_next(w->des));
+        }
+
+        check_len(w);
+    }
+}
+
+static size_t freed;
+
+static void count_free(void *arg) {
+    record_t *r = arg;
+
+    CHECK(r->pending, "destroy freed event %zu, which is not pending", r->num);
+    freed++;
+}
+
+static void test_backends(void) {
+    static const size_t sizes[] = {1, 100, 10000};
+    world_t worlds[2];
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(*sizes); s++) {
+        for (int b = 0; b < 2; b++) {
+            world_t *w = &worlds[b];
+
+            memset(w, 0, sizeof(world_t));
+            w->des = des_create(sizes[s], b ? DES_CALENDAR : 0);
+            w->rng = 0x1f83d9abfb41bd6bULL + s;
+            w->recs = malloc(EVENTS * sizeof(record_t));
+            w->log = malloc(EVENTS * sizeof(size_t));
+
+            /* An event at time 0 first, so that cancel() always has one to pick. */
+            schedule(w, 0);
+            simulate(w);
+
+            CHECK(w->seen.batches && w->seen.batch_cancels && w->seen.stale_fired && w->seen.stale_cancelled &&
+                  w->seen.same_time,
+                  "backend %d: no batch (%zu), cancel within one (%zu), stale cancel of a fired (%zu) or cancelled "
+                  "event (%zu), or event scheduled at its handler's time (%zu)", b, w->seen.batches,
+                  w->seen.batch_cancels, w->seen.stale_fired, w->seen.stale_cancelled, w->seen.same_time);
+
+            freed = 0;
+            des_destroy(w->des, count_free);
+            CHECK(freed == w->pending, "destroy freed %zu of %zu pending events", freed, w->pending);
+        }
+
+        CHECK(worlds[0].ran == worlds[1].ran && !memcmp(worlds[0].log, worlds[1].log, worlds[0].ran * sizeof(size_t)),
+              "the calendar ran %zu events, not the %zu the heap ran in the same order", worlds[1].ran, worlds[0].ran);
+
+        for (int b = 0; b < 2; b++) {
+            free(worlds[b].recs);
+            free(worlds[b].log);
+        }
+    }
+}
+
+int main(void) {
+    test_backends();
+
+    printf("des: ok\n");
+    return 0;
+}
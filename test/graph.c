@@ -0,0 +1,161 @@
+#include "graph.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * Randomized tests of graph_delta_stepping() against graph_dijkstra() on random
+ * directed graphs with multi-edges and self loops, over thread counts and bucket
+ * widths, reusing one search context for every run on a graph. Distances must be
+ * equal everywhere. Parents must be equal when every weight is positive; with zero
+ * weights they must still form a shortest path tree rooted at the source.
+ */
+
+#define CHECK(cond, ...) do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: ", __FILE__, __LINE__); \
+            fprintf(stderr, __VA_ARGS__); \
+            fprintf(stderr, "\n"); \
+            exit(1); \
+        } \
+    } while (0)
+
+enum { WEIGHTS_POSITIVE, WEIGHTS_ZERO, WEIGHTS_BINARY, WEIGHT_KINDS };
+
+static uint64_t rng_state = 0x6a09e667f3bcc909ULL;
+
+static uint64_t rng(void) {
+    uint64_t z = (rng_state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static uint32_t weight(int kind) {
+    switch (kind) {
+        case WEIGHTS_POSITIVE:
+            return 1 + rng() % 100;
+        case WEIGHTS_ZERO:
+            return rng() % 10 < 3 ? 0 : rng() % 50;
+        default:
+            return rng() & 1;
+    }
+}
+
+static graph_t graph_random(uint32_t nodes, size_t edges, int kind) {
+    size_t *offsets = calloc(nodes + 1, sizeof(size_t));
+    uint32_t *targets = malloc((edges ? edges : 1) * sizeof(uint32_t));
+    uint32_t *weights = malloc((edges ? edges : 1) * sizeof(uint32_t));
+
+    /* Sorted random tails give each node a random out-degree. */
+    for (size_t e = 0; e < edges; e++)
+        offsets[1 + rng() % nodes]++;
+    for (uint32_t v = 0; v < nodes; v++)
+        offsets[v + 1] += offsets[v];
+
+    for (size_t e = 0; e < edges; e++) {
+        targets[e] = rng() % nodes;
+        weights[e] = weight(kind);
+    }
+
+    return (graph_t){nodes, offsets, targets, weights};
+}
+
+static void graph_free(graph_t *g) {
+    free((void *)g->offsets);
+    free((void *)g->targets);
+    free((void *)g->weights);
+}
+
+/* Whether some edge from `from` to `to` has exactly the given weight. */
+static int has_edge(const graph_t *g, uint32_t from, uint32_t to, uint64_t w) {
+    for (size_t e = g->offsets[from]; e < g->offsets[from + 1]; e++)
+        if (g->targets[e] == to && g->weights[e] == w)
+            return 1;
+
+    return 0;
+}
+
+static void check_run(const graph_t *g, int kind, uint32_t source, const uint64_t *dist, const uint32_t *parent,
+                      graph_search_t *ps, uint64_t delta, unsigned threads) {
+    for (uint32_t v = 0; v < g->nodes; v++) {
+        uint64_t d = graph_dist(ps, v);
+        uint32_t p = graph_parent(ps, v);
+
+        CHECK(d == dist[v], "node %u of %u: distance %llu, dijkstra %llu (source %u, delta %llu, %u threads)", v,
+              g->nodes, (unsigned long long)d, (unsigned long long)dist[v], source, (unsigned long long)delta,
+              threads);
+
+        if (kind == WEIGHTS_POSITIVE || v == source || d == GRAPH_INF) {
+            CHECK(p == parent[v], "node %u of %u: parent %u, dijkstra %u (source %u, delta %llu, %u threads)", v,
+                  g->nodes, p, parent[v], source, (unsigned long long)delta, threads);
+            continue;
+        }
+
+        CHECK(p < g->nodes && graph_dist(ps, p) != GRAPH_INF && has_edge(g, p, v, d - graph_dist(ps, p)),
+              "node %u of %u: parent %u is not on a shortest path (source %u, delta %llu, %u threads)", v, g->nodes,
+              p, source, (unsigned long long)delta, threads);
+    }
+
+    /* Every path leads back to the source without a cycle. */
+    for (uint32_t v = 0; v < g->nodes; v++) {
+        uint32_t u = v;
+
+        for (uint32_t hops = 0; u != GRAPH_NONE && u != source; hops++) {
+            CHECK(hops < g->nodes, "node %u: parent cycle (source %u, delta %llu, %u threads)", v, source,
+                  (unsigned long long)delta, threads);
+            u = graph_parent(ps, u);
+        }
+
+        CHECK((u == source) == (dist[v] != GRAPH_INF), "node %u: path does not end at source %u", v, source);
+    }
+}
+
+static void test_delta_stepping(void) {
+    static const unsigned threads[] = {1, 2, 3, 4, 8};
+    size_t runs = 0, zero_runs = 0;
+
+    for (int round = 0; round < 60; round++) {
+        int kind = round % WEIGHT_KINDS;
+        uint32_t nodes = 1 + (round % 10 == 9 ? rng() % 40000 : rng() % 2000);
+        graph_t g = graph_random(nodes, rng() % (6 * (size_t)nodes + 1), kind);
+        graph_search_t *gs = graph_search_create(nodes), *ps = graph_search_create(nodes);
+        uint64_t *dist = malloc(nodes * sizeof(uint64_t));
+        uint32_t *parent = malloc(nodes * sizeof(uint32_t));
+
+        for (int query = 0; query < 2; query++) {
+            uint32_t source = rng() % nodes;
+            uint64_t deltas[] = {0, 1, 1 + rng() % 200, (uint64_t)1 << 40};
+
+            graph_dijkstra(gs, &g, source);
+            for (uint32_t v = 0; v < nodes; v++) {
+                dist[v] = graph_dist(gs, v);
+                parent[v] = graph_parent(gs, v);
+            }
+
+            for (size_t d = 0; d < sizeof(deltas) / sizeof(*deltas); d++) {
+                for (size_t t = 0; t < sizeof(threads) / sizeof(*threads); t++) {
+                    graph_delta_stepping(ps, &g, source, deltas[d], threads[t]);
+                    check_run(&g, kind, source, dist, parent, ps, deltas[d], threads[t]);
+                    runs++;
+                    zero_runs += kind != WEIGHTS_POSITIVE;
+                }
+            }
+        }
+
+        free(parent);
+        free(dist);
+        graph_search_destroy(ps);
+        graph_search_destroy(gs);
+        graph_free(&g);
+    }
+
+    CHECK(runs && zero_runs, "no runs (%zu) or none with zero weights (%zu)", runs, zero_runs);
+}
+
+int main(void) {
+    test_delta_stepping();
+
+    printf("graph: ok\n");
+    return 0;
+}
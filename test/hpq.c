@@ -0,0 +1,217 @@
+#include "hpq.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * Randomized tests of hpq_t against a map from each key to its priority and the
+ * pointer it was first queued with. Upserts, lookups and erases must agree with the
+ * map, and each peek and removal must return a key of the smallest priority it
+ * holds, with its original pointer even after an upsert through an equal copy of
+ * the key. The hash functions range from well mixed to constant, which makes every
+ * key collide and wrap around the end of the table, and erases target the root of
+ * the heap and its last slot as well as random keys.
+ */
+
+#define CHECK(cond, ...) do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: ", __FILE__, __LINE__); \
+            fprintf(stderr, __VA_ARGS__); \
+            fprintf(stderr, "\n"); \
+            exit(1); \
+        } \
+    } while (0)
+
+#define KEYS 512
+#define NONE UINT64_MAX
+
+enum { HASH_MIXED, HASH_CLUSTERED, HASH_CONSTANT, HASHES };
+
+typedef struct {
+    uint32_t            id;
+} item_t;
+
+typedef struct {
+    uint64_t            prio[KEYS];
+    item_t              *ptr[KEYS];
+    size_t              len;
+} model_t;
+
+static uint64_t rng_state = 0xa54ff53a5f1d36f1ULL;
+static int hash_kind;
+static item_t keys[KEYS], aliases[KEYS];
+
+static uint64_t rng(void) {
+    uint64_t z = (rng_state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/* Few distinct priorities, so that ties are common. */
+static uint64_t rand_prio(void) {
+    return 1 + rng() % 200;
+}
+
+/* Constant hashes land every key on the last slot of the table, whatever its size. */
+static uint64_t key_hash(const void *p) {
+    uint64_t id = ((const item_t *)p)->id;
+
+    switch (hash_kind) {
+        case HASH_MIXED:
+            return id * 0x9e3779b97f4a7c15ULL;
+        case HASH_CLUSTERED:
+            return ~(id & 7);
+        default:
+            return ~0ULL;
+    }
+}
+
+static int key_equal(const void *a, const void *b) {
+    return ((const item_t *)a)->id == ((const item_t *)b)->id;
+}
+
+static uint64_t model_min(const model_t *m) {
+    uint64_t min = NONE;
+
+    for (size_t k = 0; k < KEYS; k++)
+        if (m->prio[k] < min)
+            min = m->prio[k];
+
+    return min;
+}
+
+static uint64_t model_max(const model_t *m) {
+    uint64_t max = 0;
+
+    for (size_t k = 0; k < KEYS; k++)
+        if (m->prio[k] != NONE && m->prio[k] > max)
+            max = m->prio[k];
+
+    return max;
+}
+
+/* Upserts through the key itself or through an equal copy of it. */
+static void upsert(hpq_t *hpq, model_t *m, uint32_t id, uint64_t prio) {
+    item_t *key = rng() & 1 ? &keys[id] : &aliases[id];
+    char fresh = m->prio[id] == NONE;
+
+    CHECK(hpq_upsert(hpq, key, prio) == fresh, "upsert of key %u returned %d, model %s it", id, !fresh,
+          fresh ? "lacks" : "has");
+
+    if (fresh) {
+        m->ptr[id] = key;
+        m->len++;
+    }
+    m->prio[id] = prio;
+}
+
+static void erase(hpq_t *hpq, model_t *m, uint32_t id) {
+    item_t *got = hpq_erase(hpq, rng() & 1 ? &keys[id] : &aliases[id]);
+    item_t *want = m->prio[id] == NONE ? NULL : m->ptr[id];
+
+    CHECK(got == want, "erase of key %u returned %p, model has %p", id, (void *)got, (void *)want);
+
+    if (want) {
+        m->prio[id] = NONE;
+        m->len--;
+    }
+}
+
+static void check_top(hpq_t *hpq, model_t *m, int remove) {
+    uint64_t want = model_min(m), prio = NONE;
+    item_t *got = remove ? hpq_remove(hpq, &prio) : hpq_peek(hpq, &prio);
+
+    CHECK(prio == want, "%s reported priority %llu, model minimum is %llu", remove ? "remove" : "peek",
+          (unsigned long long)prio, (unsigned long long)want);
+    CHECK(m->prio[got->id] == want, "%s returned key %u of priority %llu, model minimum is %llu",
+          remove ? "remove" : "peek", got->id, (unsigned long long)m->prio[got->id], (unsigned long long)want);
+    CHECK(got == m->ptr[got->id], "%s returned a copy of key %u instead of the queued pointer",
+          remove ? "remove" : "peek", got->id);
+
+    if (remove) {
+        m->prio[got->id] = NONE;
+        m->len--;
+    }
+}
+
+static size_t freed;
+
+static void count_free(void *p) {
+    (void)p;
+    freed++;
+}
+
+static void test_model(void) {
+    static const size_t sizes[] = {1, 2, 7, 64, KEYS};
+    size_t updates = 0, root_erases = 0, last_erases = 0, misses = 0;
+
+    for (uint32_t k = 0; k < KEYS; k++)
+        keys[k].id = aliases[k].id = k;
+
+    for (hash_kind = 0; hash_kind < HASHES; hash_kind++) {
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(*sizes); s++) {
+            hpq_t *hpq = hpq_create(sizes[s], key_hash, key_equal);
+            model_t m = {.len = 0};
+            uint32_t ids = sizes[s] < 32 ? 2 * (uint32_t)sizes[s] : KEYS;
+
+            for (size_t k = 0; k < KEYS; k++)
+                m.prio[k] = NONE;
+
+            for (int step = 0; step < 20000; step++) {
+                uint64_t r = rng() % 100, prio = NONE;
+                uint32_t id = (uint32_t)(rng() % ids);
+
+                if (r < 40) {
+                    /* New keys only while there is room. */
+                    if (m.prio[id] != NONE || m.len < sizes[s]) {
+                        updates += m.prio[id] != NONE;
+                        upsert(hpq, &m, id, rand_prio());
+                    }
+                } else if (r < 55) {
+                    misses += m.prio[id] == NONE;
+                    erase(hpq, &m, id);
+                } else if (r < 62 && m.len) {
+                    /* The root. */
+                    item_t *top = hpq_peek(hpq, NULL);
+                    erase(hpq, &m, top->id);
+                    root_erases++;
+                } else if (r < 69 && m.len < sizes[s] && m.prio[id] == NONE) {
+                    /* A new key above every other stays in the last slot of the heap. */
+                    upsert(hpq, &m, id, model_max(&m) + 1);
+                    erase(hpq, &m, id);
+                    last_erases++;
+                } else if (r < 80 && m.len) {
+                    check_top(hpq, &m, 1);
+                } else if (r < 90 && m.len) {
+                    check_top(hpq, &m, 0);
+                } else {
+                    char found = hpq_contains(hpq, rng() & 1 ? &keys[id] : &aliases[id], &prio);
+
+                    CHECK(found == (m.prio[id] != NONE), "contains of key %u is %d, model disagrees", id, found);
+                    CHECK(!found || prio == m.prio[id], "key %u has priority %llu, model has %llu", id,
+                          (unsigned long long)prio, (unsigned long long)m.prio[id]);
+                }
+
+                CHECK(hpq_len(hpq) == m.len, "len %zu, model has %zu", hpq_len(hpq), m.len);
+                CHECK(hpq_is_empty(hpq) == !m.len, "hpq_is_empty() is %d with %zu keys", hpq_is_empty(hpq), m.len);
+            }
+
+            /* Destroyed non-empty, free_func sees every queued key once. */
+            freed = 0;
+            hpq_destroy(hpq, count_free);
+            CHECK(freed == m.len, "destroy freed %zu of %zu keys", freed, m.len);
+        }
+    }
+
+    CHECK(updates && root_erases && last_erases && misses,
+          "no update (%zu), erase of the root (%zu), of the last slot (%zu) or of a missing key (%zu)", updates,
+          root_erases, last_erases, misses);
+}
+
+int main(void) {
+    test_model();
+
+    printf("hpq: ok\n");
+    return 0;
+}
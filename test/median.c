@@ -0,0 +1,150 @@
+#include "median.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Randomized tests of median_t against sorting the samples it should track: all of
+ * them, or the last `window` ones. After every median_add() or median_add_n() the
+ * quantile must equal the interpolation between the two samples around its rank in
+ * the sorted copy. Samples come from a small range, so that duplicates are common,
+ * and batches range from single samples to more than the tracker or the window
+ * holds.
+ */
+
+#define CHECK(cond, ...) do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: ", __FILE__, __LINE__); \
+            fprintf(stderr, __VA_ARGS__); \
+            fprintf(stderr, "\n"); \
+            exit(1); \
+        } \
+    } while (0)
+
+#define MIN(A, B) ((A) < (B) ? (A) : (B))
+#define BATCH 512
+
+typedef struct {
+    double              *all;
+    size_t              len;
+    double              *sorted;
+} model_t;
+
+typedef struct {
+    size_t              even;
+    size_t              ties;
+    size_t              evictions;
+    size_t              selects;
+} seen_t;
+
+static uint64_t rng_state = 0x510e527fade682d1ULL;
+
+static uint64_t rng(void) {
+    uint64_t z = (rng_state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/* Halves from -50 to 50, with runs of one value now and then. */
+static double rand_sample(void) {
+    static double run;
+
+    if (rng() % 20 == 0)
+        run = (double)((int)(rng() % 201) - 100) / 2;
+
+    return rng() % 4 ? (double)((int)(rng() % 201) - 100) / 2 : run;
+}
+
+static int double_cmp(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* The documented interpolation between the samples of rank floor(q * (n - 1)) and the next. */
+static double model_quantile(model_t *model, size_t window, double q, seen_t *seen) {
+    size_t n = window ? MIN(model->len, window) : model->len;
+
+    memcpy(model->sorted, model->all + model->len - n, n * sizeof(double));
+    qsort(model->sorted, n, sizeof(double), double_cmp);
+
+    double r = q * (double)(n - 1);
+    size_t lo = (size_t)r;
+    double frac = r - (double)lo, x = model->sorted[lo];
+
+    seen->ties += lo + 1 < n && model->sorted[lo + 1] == x;
+    return frac > 0 && lo + 1 < n ? x + frac * (model->sorted[lo + 1] - x) : x;
+}
+
+static void check(median_t *m, model_t *model, size_t window, double q, seen_t *seen) {
+    size_t n = window ? MIN(model->len, window) : model->len;
+    double want = model_quantile(model, window, q, seen), got = median_get(m);
+
+    CHECK(median_len(m) == n, "len %zu, model has %zu (window %zu)", median_len(m), n, window);
+    CHECK(got == want, "quantile %g of %zu samples is %.17g, sorting gives %.17g (window %zu)", q, n, got, want,
+          window);
+    seen->even += n % 2 == 0 && q == 0.5;
+}
+
+static void test_model(void) {
+    static const size_t windows[] = {0, 1, 2, 3, 4, 7, 64, 1000};
+    static const double qs[] = {0.5, 0, 1, 0.25, 0.9, 0.3};
+    double *batch = malloc(BATCH * sizeof(double));
+    seen_t seen = {0};
+
+    for (size_t w = 0; w < sizeof(windows) / sizeof(*windows); w++) {
+        for (size_t k = 0; k < sizeof(qs) / sizeof(*qs); k++) {
+            size_t window = windows[w], steps = window ? 3000 : 300;
+            median_t *m = k ? median_create_ex(window, qs[k]) : median_create(window);
+            model_t model = {malloc(steps * BATCH * sizeof(double)), 0, malloc(steps * BATCH * sizeof(double))};
+
+            for (size_t step = 0; step < steps; step++) {
+                size_t held = median_len(m);
+
+                if (rng() % 3) {
+                    double x = rand_sample();
+
+                    seen.evictions += window && held == window;
+                    median_add(m, x);
+                    model.all[model.len++] = x;
+                } else {
+                    /* Small, around what is held, or beyond the window. */
+                    size_t sizes[] = {1 + rng() % 4, held, held + 1 + rng() % 8, window + rng() % 3};
+                    size_t n = sizes[rng() % 4];
+
+                    if (n > BATCH)
+                        n = BATCH;
+
+                    for (size_t i = 0; i < n; i++)
+                        batch[i] = rand_sample();
+
+                    seen.evictions += window && held + n > window;
+                    seen.selects += n && n >= held;
+                    median_add_n(m, batch, n);
+                    memcpy(model.all + model.len, batch, n * sizeof(double));
+                    model.len += n;
+                }
+
+                if (model.len)
+                    check(m, &model, window, qs[k], &seen);
+            }
+
+            median_destroy(m);
+            free(model.sorted);
+            free(model.all);
+        }
+    }
+
+    free(batch);
+    CHECK(seen.even && seen.ties && seen.evictions && seen.selects,
+          "no median of an even count (%zu), tie (%zu), eviction (%zu) or batch by selection (%zu)", seen.even,
+          seen.ties, seen.evictions, seen.selects);
+}
+
+int main(void) {
+    test_model();
+
+    printf("median: ok\n");
+    return 0;
+}
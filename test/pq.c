@@ -0,0 +1,611 @@
+#include "pq.h"
+#include "pq_impl.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Randomized tests of pq_t against a reference model. Keys are stored in the
+ * element pointer itself and every operation is mirrored on a count of each key,
+ * scanned upwards for the minimum. Each peek and removal must return the model's
+ * minimum and the lengths must agree after every step. Each test also counts how
+ * often it hit the state it is about (a growth, a merge, an unsorted buffer or a
+ * change of representation), so that a change of thresholds cannot silently make
+ * it test nothing.
+ */
+
+#define CHECK(cond, ...) do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: ", __FILE__, __LINE__); \
+            fprintf(stderr, __VA_ARGS__); \
+            fprintf(stderr, "\n"); \
+            exit(1); \
+        } \
+    } while (0)
+
+#define MIN(A, B) ((A) < (B) ? (A) : (B))
+#define KEY(p) ((uint64_t)(uintptr_t)(p))
+#define ELEM(k) ((void *)(uintptr_t)(k))
+
+#define KEYS (1 << 16)
+
+typedef struct {
+    size_t              *counts;
+    size_t              len;
+    uint64_t            min;
+} model_t;
+
+static uint64_t rng_state = 0x9e3779b97f4a7c15ULL;
+
+static uint64_t rng(void) {
+    uint64_t z = (rng_state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/* Small key range, so that equal keys are common. */
+static uint64_t rand_key(void) {
+    return 1 + rng() % 1000;
+}
+
+static int key_cmp(const void *a, const void *b) {
+    uint64_t ka = KEY(a), kb = KEY(b);
+    return (ka > kb) - (ka < kb);
+}
+
+static model_t model_create(void) {
+    return (model_t){calloc(KEYS + 1, sizeof(size_t)), 0, KEYS};
+}
+
+static void model_destroy(model_t *m) {
+    free(m->counts);
+}
+
+static void model_push(model_t *m, uint64_t key) {
+    m->counts[key]++;
+    m->len++;
+
+    if (key < m->min)
+        m->min = key;
+}
+
+/* `min` never exceeds the smallest key held, so the scan only moves up. */
+static uint64_t model_min(model_t *m) {
+    while (!m->counts[m->min])
+        m->min++;
+
+    return m->min;
+}
+
+static void insert(pq_t *pq, model_t *m, uint64_t key) {
+    pq_insert(pq, ELEM(key));
+    model_push(m, key);
+    CHECK(pq_len(pq) == m->len, "len %zu after insert, model has %zu", pq_len(pq), m->len);
+}
+
+static void insert_n(pq_t *pq, model_t *m, size_t n) {
+    void **items = malloc((n ? n : 1) * sizeof(void *));
+
+    for (size_t j = 0; j < n; j++) {
+        items[j] = ELEM(rand_key());
+        model_push(m, KEY(items[j]));
+    }
+
+    pq_insert_n(pq, items, n);
+    CHECK(pq_len(pq) == m->len, "len %zu after a batch of %zu, model has %zu", pq_len(pq), n, m->len);
+    free(items);
+}
+
+static void peek(pq_t *pq, model_t *m) {
+    uint64_t want = model_min(m), got = KEY(pq_peek(pq));
+    CHECK(got == want, "peek returned %llu, model minimum is %llu", (unsigned long long)got, (unsigned long long)want);
+}
+
+static void remove_min(pq_t *pq, model_t *m) {
+    uint64_t want = model_min(m), got = KEY(pq_remove(pq));
+
+    m->counts[want]--;
+    m->len--;
+
+    CHECK(got == want, "remove returned %llu, model minimum is %llu", (unsigned long long)got, (unsigned long long)want);
+    CHECK(pq_len(pq) == m->len, "len %zu after remove, model has %zu", pq_len(pq), m->len);
+}
+
+/* Copies the queue and drains the copy, which must not disturb the original. */
+static void check_copy(pq_t *pq, const model_t *m) {
+    pq_t *cp = pq_copy(pq);
+    model_t mc = model_create();
+
+    memcpy(mc.counts, m->counts, (KEYS + 1) * sizeof(size_t));
+    mc.len = m->len;
+    mc.min = m->min;
+    while (mc.len)
+        remove_min(cp, &mc);
+    CHECK(pq_is_empty(cp), "copy not empty after draining the model");
+
+    pq_destroy(cp, NULL);
+    model_destroy(&mc);
+}
+
+static void drain(pq_t *pq, model_t *m) {
+    while (m->len)
+        remove_min(pq, m);
+    CHECK(pq_is_empty(pq), "queue not empty after draining the model");
+}
+
+typedef struct {
+    size_t              migrating;
+    size_t              merging;
+    size_t              unsorted;
+} seen_t;
+
+/*
+ * Runs random inserts, batches, removals, peeks and copies, and toggles the budget
+ * between 0 and `budget` now and then. Queues that cannot grow are never overfilled.
+ */
+static void fuzz(pq_t *pq, model_t *m, int steps, size_t budget, seen_t *seen) {
+    size_t room = TAIL(pq)->flags & PQ_GROW ? SIZE_MAX : pq_size(pq);
+
+    for (int step = 0; step < steps; step++) {
+        uint64_t r = rng() % 100;
+
+        seen->migrating += TAIL(pq)->grow != NULL;
+        seen->merging += pq->pending != 0;
+        seen->unsorted += pq->pending > TAIL(pq)->pend_heap;
+
+        if ((r < 45 || !m->len) && m->len < room) {
+            insert(pq, m, rand_key());
+        } else if (r < 75 && m->len) {
+            remove_min(pq, m);
+        } else if (r < 90 && m->len) {
+            peek(pq, m);
+        } else if (r < 97) {
+            /* At, just above and well above half of the queue, or small. */
+            size_t len = m->len, n[] = {len / 2, len / 2 + 1, len + 3, 1 + rng() % 8}, k = n[rng() % 4];
+            insert_n(pq, m, MIN(k, room - len));
+        } else if (r < 99) {
+            check_copy(pq, m);
+        } else {
+            pq_set_budget(pq, TAIL(pq)->budget ? 0 : budget);
+        }
+
+        /* Keep the queue in the low thousands so that it keeps growing from small arrays. */
+        if (m->len > 4000)
+            while (m->len > 100)
+                remove_min(pq, m);
+    }
+}
+
+/*
+ * PQ_GROW queues and pq_insert_n() batches under small budgets: inserts, removals
+ * and peeks land in the middle of migrations and merges, batches are sized around
+ * half of the queue, and the budget is dropped and set again mid-job.
+ */
+static void test_grow(void) {
+    static const size_t budgets[] = {0, 8, 13, 64};
+    static const size_t sizes[] = {1, 4, 100};
+    seen_t seen = {0};
+
+    for (size_t b = 0; b < sizeof(budgets) / sizeof(*budgets); b++) {
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(*sizes); s++) {
+            pq_t *pq = pq_create_ex(sizes[s], key_cmp, PQ_GROW);
+            model_t m = model_create();
+
+            pq_set_budget(pq, budgets[b]);
+            fuzz(pq, &m, 20000, budgets[b], &seen);
+
+            drain(pq, &m);
+            pq_destroy(pq, NULL);
+            model_destroy(&m);
+        }
+    }
+
+    CHECK(seen.migrating && seen.merging, "no operation ran mid-growth (%zu) or mid-merge (%zu)", seen.migrating,
+          seen.merging);
+}
+
+/* Batches into fixed-size queues, filling them exactly. */
+static void test_batch(void) {
+    static const size_t budgets[] = {0, 8, 50};
+    size_t merging = 0;
+
+    for (size_t b = 0; b < sizeof(budgets) / sizeof(*budgets); b++) {
+        pq_t *pq = pq_create(512, key_cmp);
+        model_t m = model_create();
+
+        pq_set_budget(pq, budgets[b]);
+        for (int round = 0; round < 200; round++) {
+            insert_n(pq, &m, 1 + rng() % (512 - m.len));
+            merging += pq->pending != 0;
+
+            for (size_t k = rng() % (m.len + 1); k > 0; k--) {
+                peek(pq, &m);
+                remove_min(pq, &m);
+                merging += pq->pending != 0;
+            }
+
+            /* Exactly as many as fit. */
+            if (round % 10 == 0) {
+                insert_n(pq, &m, 512 - m.len);
+                CHECK(pq_len(pq) == pq_size(pq), "len %zu of a full queue, size %zu", pq_len(pq), pq_size(pq));
+                check_copy(pq, &m);
+                drain(pq, &m);
+            }
+        }
+
+        drain(pq, &m);
+        pq_destroy(pq, NULL);
+        model_destroy(&m);
+    }
+
+    CHECK(merging, "no operation ran mid-merge");
+}
+
+/*
+ * PQ_LAZY queues: peeks between deferred inserts must see the minimum of the
+ * unsorted tail, including bursts of decreasing keys that keep moving it.
+ */
+static void test_lazy(void) {
+    seen_t seen = {0};
+
+    for (int run = 0; run < 20; run++) {
+        pq_t *pq = pq_create_ex(1024, key_cmp, PQ_LAZY);
+        model_t m = model_create();
+
+        for (int burst = 0; burst < 50; burst++) {
+            uint64_t key = 32 + rand_key();
+
+            for (size_t k = rng() % 32; k > 0 && m.len < 1024; k--) {
+                insert(pq, &m, rng() & 1 ? rand_key() : key--);
+                seen.unsorted += pq->pending > TAIL(pq)->pend_heap;
+                peek(pq, &m);
+            }
+
+            for (size_t k = rng() % 24; k > 0 && m.len; k--)
+                remove_min(pq, &m);
+        }
+
+        fuzz(pq, &m, 2000, 0, &seen);
+        drain(pq, &m);
+        pq_destroy(pq, NULL);
+        model_destroy(&m);
+    }
+
+    CHECK(seen.unsorted, "no peek ran over an unsorted buffer");
+}
+
+/* A full PQ_LAZY queue must count its deferred elements towards the capacity. */
+static void test_lazy_full(void) {
+    pq_t *pq = pq_create_ex(64, key_cmp, PQ_LAZY);
+    model_t m = model_create();
+
+    while (m.len < 40)
+        insert(pq, &m, rand_key());
+    remove_min(pq, &m);
+    while (m.len < 64)
+        insert(pq, &m, rand_key());
+
+    CHECK(pq->pending, "full queue has no deferred elements");
+    CHECK(pq_try_insert(pq, ELEM(rand_key())) == PQ_EFULL, "insert into a full lazy queue did not fail");
+    CHECK(pq_len(pq) == 64, "len %zu after a failed insert", pq_len(pq));
+
+    remove_min(pq, &m);
+    CHECK(pq_try_insert(pq, ELEM(7)) == PQ_OK, "insert after a removal failed");
+    model_push(&m, 7);
+
+    drain(pq, &m);
+    pq_destroy(pq, NULL);
+    model_destroy(&m);
+}
+
+/* PQ_LAZY with PQ_GROW and a budget, which is dropped and set again over a deferred backlog. */
+static void test_lazy_grow(void) {
+    static const size_t budgets[] = {8, 32};
+    seen_t seen = {0};
+
+    for (size_t b = 0; b < sizeof(budgets) / sizeof(*budgets); b++) {
+        for (int run = 0; run < 4; run++) {
+            pq_t *pq = pq_create_ex(4, key_cmp, PQ_LAZY | PQ_GROW);
+            model_t m = model_create();
+
+            pq_set_budget(pq, run & 1 ? budgets[b] : 0);
+            fuzz(pq, &m, 20000, budgets[b], &seen);
+
+            drain(pq, &m);
+            pq_destroy(pq, NULL);
+            model_destroy(&m);
+        }
+    }
+
+    CHECK(seen.migrating && seen.merging && seen.unsorted,
+          "no operation ran mid-growth (%zu), mid-merge (%zu) or over an unsorted buffer (%zu)", seen.migrating,
+          seen.merging, seen.unsorted);
+}
+
+/* PQ_LARGE sift-downs, on their own and over the deferred inserts of PQ_LAZY. */
+static void test_large(void) {
+    static const unsigned flags[] = {PQ_LARGE, PQ_LARGE | PQ_LAZY};
+    static const size_t sizes[] = {1, 2, 100, 5000};
+    seen_t seen = {0};
+
+    for (size_t f = 0; f < sizeof(flags) / sizeof(*flags); f++) {
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(*sizes); s++) {
+            for (size_t budget = 0; budget <= 16; budget += 16) {
+                pq_t *pq = pq_create_ex(sizes[s], key_cmp, flags[f]);
+                model_t m = model_create();
+
+                pq_set_budget(pq, budget);
+                fuzz(pq, &m, 20000, budget, &seen);
+
+                drain(pq, &m);
+                pq_destroy(pq, NULL);
+                model_destroy(&m);
+            }
+        }
+    }
+
+    CHECK(seen.merging && seen.unsorted, "no operation ran mid-merge (%zu) or over an unsorted buffer (%zu)",
+          seen.merging, seen.unsorted);
+}
+
+/*
+ * PQ_BHEAP queues at sizes just below, at and above the depths where the heap moves
+ * on to a new level of pages, fuzzed and then filled exactly by batches that cross
+ * those depths.
+ */
+static void test_bheap(void) {
+    static const size_t sizes[] = {1, 2, 511, 512, 513, 1023, 1025, 5000, 262143, 262144, 262145};
+    seen_t seen = {0};
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(*sizes); s++) {
+        for (size_t budget = 0; budget <= 16; budget += 16) {
+            pq_t *pq = pq_create_ex(sizes[s], key_cmp, PQ_BHEAP);
+            model_t m = model_create();
+
+            pq_set_budget(pq, budget);
+            fuzz(pq, &m, 20000, budget, &seen);
+
+            /* Batches of a random part of what is left, the last one exactly filling the queue. */
+            while (m.len < sizes[s]) {
+                size_t left = sizes[s] - m.len;
+                insert_n(pq, &m, rng() & 1 ? left : 1 + rng() % left);
+            }
+            CHECK(pq_len(pq) == pq_size(pq), "len %zu of a full queue, size %zu", pq_len(pq), pq_size(pq));
+            peek(pq, &m);
+            check_copy(pq, &m);
+
+            drain(pq, &m);
+            pq_destroy(pq, NULL);
+            model_destroy(&m);
+        }
+    }
+
+    CHECK(seen.merging, "no operation ran mid-merge");
+}
+
+static size_t freed;
+
+static void count_free(void *p) {
+    (void)p;
+    freed++;
+}
+
+/*
+ * A queue and its copy share their nodes. Removes `a` elements from the queue and
+ * `b` from the copy, in either order, then destroys both in either order: each must
+ * return every element in order, and the destroys must together free every element
+ * still held exactly once, each one by the last queue holding it.
+ */
+static void test_copy(void) {
+    static const unsigned flags[] = {0, PQ_LAZY, PQ_BHEAP, PQ_ADAPTIVE, PQ_GROW};
+    static const size_t n = 300, counts[] = {0, 1, 100, 299, 300};
+
+    for (size_t f = 0; f < sizeof(flags) / sizeof(*flags); f++) {
+        for (int order = 0; order < 4 * 25; order++) {
+            size_t a = counts[order / 4 % 5], b = counts[order / 20];
+            pq_t *pq = pq_create_ex(n, key_cmp, flags[f]);
+
+            /* Distinct keys, inserted shuffled. */
+            for (size_t i = 0; i < n; i++)
+                pq_insert(pq, ELEM(1 + (i * 7919) % n));
+
+            pq_t *cp = pq_copy(pq), *by[2] = {order & 1 ? cp : pq, order & 1 ? pq : cp};
+
+            for (int q = 0; q < 2; q++) {
+                for (size_t k = 0; k < (by[q] == pq ? a : b); k++) {
+                    uint64_t got = KEY(pq_remove(by[q]));
+                    CHECK(got == k + 1, "removal %zu from the %s returned %llu", k, by[q] == pq ? "queue" : "copy",
+                          (unsigned long long)got);
+                }
+            }
+
+            /* A node goes to free_func with the last queue that holds it. */
+            pq_t *dead = order & 2 ? cp : pq, *last = dead == pq ? cp : pq;
+            size_t mine = dead == pq ? a : b, other = dead == pq ? b : a;
+
+            freed = 0;
+            pq_destroy(dead, count_free);
+            CHECK(freed == (other > mine ? other - mine : 0), "first destroy freed %zu with %zu and %zu removed", freed,
+                  mine, other);
+
+            freed = 0;
+            pq_destroy(last, count_free);
+            CHECK(freed == n - other, "second destroy freed %zu of %zu", freed, n - other);
+        }
+    }
+}
+
+/*
+ * Runs `steps` operations, inserting with probability pct / 100. At every change of
+ * representation the queue must still be in order, and so must a copy of it, which
+ * keeps the representation. The queue then hands over to a second copy: destroying
+ * it must not free the elements the copy still holds.
+ */
+static pq_t *adapt_run(pq_t *pq, model_t *m, int steps, unsigned pct, unsigned char switched[9][9]) {
+    for (int step = 0; step < steps; step++) {
+        unsigned arity = TAIL(pq)->arity;
+
+        if (rng() % 100 < pct || !m->len)
+            insert(pq, m, 1 + rng() % KEYS);
+        else
+            remove_min(pq, m);
+
+        if (TAIL(pq)->arity == arity)
+            continue;
+
+        switched[arity][TAIL(pq)->arity] = 1;
+        peek(pq, m);
+        check_copy(pq, m);
+
+        pq_t *cp = pq_copy(pq);
+        CHECK(TAIL(cp)->arity == TAIL(pq)->arity, "copy of a %u-ary queue is %u-ary", TAIL(pq)->arity, TAIL(cp)->arity);
+
+        freed = 0;
+        pq_destroy(pq, count_free);
+        CHECK(!freed, "destroying a copied queue freed %zu shared elements", freed);
+        pq = cp;
+    }
+
+    return pq;
+}
+
+/*
+ * PQ_ADAPTIVE: sizes and insert ratios that cross every threshold both ways, from a
+ * sorted array to binary, 4-ary and 8-ary heaps and back. Heap to heap switches wait
+ * for as many operations as the queue holds, hence the long phases at a steady size.
+ */
+static void test_adaptive(void) {
+    static const struct {
+        int             steps;
+        unsigned        pct;
+    } phases[] = {
+        {40, 100},      /* sorted -> binary */
+        {30, 0},        /* binary -> sorted */
+        {70000, 100},   /* sorted -> binary, up to the wide heaps */
+        {5000, 80},     /* binary -> 8-ary, inserts dominate */
+        {200000, 45},   /* 8-ary -> 4-ary, balanced */
+        {100000, 75},   /* 4-ary -> 8-ary */
+        {110000, 0},    /* 8-ary -> 4-ary -> binary -> sorted */
+        {300000, 62},   /* sorted -> binary -> 4-ary, growing without inserts dominating */
+    };
+    static const unsigned want[][2] = {{0, 2}, {2, 0}, {2, 8}, {8, 4}, {4, 8}, {4, 2}, {2, 4}};
+    unsigned char switched[9][9] = {{0}};
+    pq_t *pq = pq_create_ex(1 << 18, key_cmp, PQ_ADAPTIVE);
+    model_t m = model_create();
+
+    for (size_t p = 0; p < sizeof(phases) / sizeof(*phases); p++)
+        pq = adapt_run(pq, &m, phases[p].steps, phases[p].pct, switched);
+
+    for (size_t w = 0; w < sizeof(want) / sizeof(*want); w++)
+        CHECK(switched[want[w][0]][want[w][1]], "no switch from arity %u to %u", want[w][0], want[w][1]);
+
+    /* Destroyed non-empty, every element goes through free_func once. */
+    freed = 0;
+    pq_destroy(pq, count_free);
+    CHECK(freed == m.len, "destroy freed %zu of %zu elements", freed, m.len);
+    model_destroy(&m);
+}
+
+/*
+ * The pq_try_* functions on full, empty and NULL queues, which must fail without
+ * touching the queue or `out`, and pq_peek_unchecked() on queues that take the slow
+ * path: deferred inserts and migrations in progress.
+ */
+static void test_try(void) {
+    static const unsigned flags[] = {0, PQ_LAZY, PQ_BHEAP, PQ_ADAPTIVE, PQ_LAZY | PQ_LARGE};
+    const void *out = ELEM(1);
+    size_t slow = 0;
+
+    CHECK(pq_try_insert(NULL, ELEM(1)) == PQ_ENULL, "insert into NULL did not fail");
+    CHECK(pq_try_peek(NULL, &out) == PQ_ENULL, "peek into NULL did not fail");
+    CHECK(pq_try_remove(NULL, &out) == PQ_ENULL, "remove from NULL did not fail");
+
+    for (size_t f = 0; f < sizeof(flags) / sizeof(*flags); f++) {
+        pq_t *pq = pq_create_ex(600, key_cmp, flags[f]);
+        model_t m = model_create();
+
+        CHECK(pq_try_peek(pq, &out) == PQ_EEMPTY, "peek into a new queue did not fail (flags %u)", flags[f]);
+        CHECK(pq_try_remove(pq, &out) == PQ_EEMPTY, "remove from a new queue did not fail (flags %u)", flags[f]);
+
+        for (int round = 0; round < 3; round++) {
+            while (m.len < 600) {
+                uint64_t key = rand_key();
+
+                CHECK(pq_try_insert(pq, ELEM(key)) == PQ_OK, "insert %zu of 600 failed (flags %u)", m.len + 1,
+                      flags[f]);
+                model_push(&m, key);
+            }
+
+            CHECK(pq_try_insert(pq, ELEM(1)) == PQ_EFULL, "insert into a full queue did not fail (flags %u)",
+                  flags[f]);
+            CHECK(pq_len(pq) == 600, "len %zu after a failed insert (flags %u)", pq_len(pq), flags[f]);
+
+            while (m.len) {
+                uint64_t want = model_min(&m);
+
+                CHECK(pq_try_peek(pq, &out) == PQ_OK && KEY(out) == want, "peek returned %llu, model minimum is %llu",
+                      (unsigned long long)KEY(out), (unsigned long long)want);
+                CHECK(pq_try_remove(pq, &out) == PQ_OK && KEY(out) == want,
+                      "remove returned %llu, model minimum is %llu", (unsigned long long)KEY(out),
+                      (unsigned long long)want);
+                m.counts[want]--;
+                m.len--;
+            }
+
+            out = ELEM(1);
+            CHECK(pq_try_peek(pq, &out) == PQ_EEMPTY && out == ELEM(1), "peek into a drained queue did not fail");
+            CHECK(pq_try_remove(pq, &out) == PQ_EEMPTY && out == ELEM(1), "remove from a drained queue did not fail");
+            CHECK(pq_is_empty(pq), "queue not empty after failed removals");
+        }
+
+        pq_destroy(pq, NULL);
+        model_destroy(&m);
+    }
+
+    /* A lazy queue between inserts and a growing one mid-migration. */
+    for (int run = 0; run < 2; run++) {
+        pq_t *pq = pq_create_ex(4, key_cmp, run ? PQ_GROW : PQ_LAZY | PQ_GROW);
+        model_t m = model_create();
+
+        pq_set_budget(pq, run ? 8 : 0);
+        for (int step = 0; step < 5000; step++) {
+            if (rng() % 3 || !m.len)
+                insert(pq, &m, rand_key());
+            else
+                remove_min(pq, &m);
+
+            if (!m.len)
+                continue;
+
+            uint64_t want = model_min(&m), got = KEY(pq_peek_unchecked(pq));
+
+            CHECK(got == want, "unchecked peek returned %llu, model minimum is %llu (slow %u)",
+                  (unsigned long long)got, (unsigned long long)want, pq->slow);
+            slow += pq->slow != 0;
+        }
+
+        drain(pq, &m);
+        pq_destroy(pq, NULL);
+        model_destroy(&m);
+    }
+
+    CHECK(slow, "no unchecked peek took the slow path");
+}
+
+int main(void) {
+    test_try();
+    test_grow();
+    test_batch();
+    test_lazy();
+    test_lazy_full();
+    test_lazy_grow();
+    test_large();
+    test_bheap();
+    test_copy();
+    test_adaptive();
+
+    printf("pq: ok\n");
+    return 0;
+}
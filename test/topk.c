@@ -0,0 +1,173 @@
+#include "topk.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Randomized tests of topk_t against a scan of every item still in the window.
+ * After every topk_add() and topk_advance() the snapshot must list the k best live
+ * items, best first and the more recent first among equal scores. Streams switch
+ * between random scores, under which many items make the top and are pushed out
+ * again, and falling scores, under which few do, and time jumps expire most of the
+ * window at once. Each kind of stream must have compacted the reserve, and top
+ * items must have expired together with reserve items that would have refilled
+ * them.
+ */
+
+#define CHECK(cond, ...) do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: ", __FILE__, __LINE__); \
+            fprintf(stderr, __VA_ARGS__); \
+            fprintf(stderr, "\n"); \
+            exit(1); \
+        } \
+    } while (0)
+
+#define STEPS 30000
+#define MAX_K 64
+
+enum { SCORES_RANDOM, SCORES_FALLING, SCORE_KINDS };
+
+typedef struct {
+    topk_item_t         *items;
+    size_t              len;
+    size_t              live;
+    uint64_t            now;
+} model_t;
+
+typedef struct {
+    size_t              compactions[SCORE_KINDS];
+    size_t              refill_drops;
+} seen_t;
+
+static uint64_t rng_state = 0x9b05688c2b3e6c1fULL;
+
+static uint64_t rng(void) {
+    uint64_t z = (rng_state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/* Items are added with their index as id, so the later of two items has the larger id. */
+static int better(const topk_item_t *a, const topk_item_t *b) {
+    return a->score > b->score || (a->score == b->score && a->id > b->id);
+}
+
+static void model_advance(model_t *m, uint64_t window, uint64_t now) {
+    m->now = now;
+    while (m->live < m->len && now - m->items[m->live].time >= window)
+        m->live++;
+}
+
+/* The k best live items, best first, by insertion into a sorted array. */
+static size_t model_top(const model_t *m, size_t k, topk_item_t *out) {
+    size_t n = 0;
+
+    for (size_t i = m->live; i < m->len; i++) {
+        const topk_item_t *e = &m->items[i];
+
+        if (n == k && !better(e, &out[k - 1]))
+            continue;
+
+        size_t j = n < k ? n++ : k - 1;
+        for (; j > 0 && better(e, &out[j - 1]); j--)
+            out[j] = out[j - 1];
+        out[j] = *e;
+    }
+
+    return n;
+}
+
+static void check(topk_t *tk, const model_t *m, size_t k) {
+    topk_item_t want[MAX_K], got[MAX_K + 1];
+    size_t n = model_top(m, k, want), cap = rng() % 8 ? k + 1 : rng() % (k + 1);
+    size_t len = topk_snapshot(tk, got, cap), wlen = n < cap ? n : cap;
+
+    CHECK(topk_len(tk) == n, "len %zu, %zu live items give %zu (k %zu)", topk_len(tk), m->len - m->live, n, k);
+    CHECK(len == wlen, "snapshot of %zu items into %zu slots wrote %zu", n, cap, len);
+
+    for (size_t i = 0; i < len; i++)
+        CHECK(got[i].id == want[i].id && got[i].score == want[i].score && got[i].time == want[i].time,
+              "item %zu of the top %zu is #%llu (score %g, time %llu), scan gives #%llu (score %g, time %llu)", i, k,
+              (unsigned long long)got[i].id, got[i].score, (unsigned long long)got[i].time,
+              (unsigned long long)want[i].id, want[i].score, (unsigned long long)want[i].time);
+
+    CHECK(topk_held(tk) >= n, "holds %zu items, fewer than the top %zu", topk_held(tk), n);
+}
+
+/* Top items among `prev` that are gone from the window at the model's time. */
+static size_t expired(const model_t *m, uint64_t window, const topk_item_t *prev, size_t n) {
+    size_t count = 0;
+
+    for (size_t i = 0; i < n; i++)
+        count += m->now - prev[i].time >= window;
+
+    return count;
+}
+
+static void run(size_t k, uint64_t window, seen_t *seen) {
+    topk_t *tk = topk_create(k, window);
+    model_t m = {malloc(STEPS * sizeof(topk_item_t)), 0, 0, 0};
+    topk_item_t prev[MAX_K];
+    int kind = SCORES_RANDOM;
+
+    for (size_t step = 0; step < STEPS; step++) {
+        uint64_t r = rng() % 1000, now = m.now;
+
+        if (step % 2000 == 0)
+            kind = (int)(rng() % SCORE_KINDS);
+
+        /* Mostly small steps, now and then a jump over much of the window. */
+        if (r < 5)
+            now += window / 2 + rng() % window;
+        else if (r < 400)
+            now += rng() % 3;
+
+        if (now != m.now) {
+            size_t held = topk_held(tk), n = topk_snapshot(tk, prev, k);
+
+            topk_advance(tk, now);
+            model_advance(&m, window, now);
+            check(tk, &m, k);
+
+            /* More dropped than the top lost: refilling met expired reserve items. */
+            seen->refill_drops += held - topk_held(tk) > expired(&m, window, prev, n);
+        }
+
+        double score = kind == SCORES_RANDOM ? (double)(rng() % 100) : (double)(rng() % 8) - (double)now / 4;
+        size_t held = topk_held(tk);
+
+        topk_add(tk, now, score, m.len);
+        m.items[m.len] = (topk_item_t){score, now, m.len};
+        m.len++;
+        check(tk, &m, k);
+
+        seen->compactions[kind] += topk_held(tk) < held + 1;
+    }
+
+    topk_destroy(tk);
+    free(m.items);
+}
+
+static void test_model(void) {
+    static const size_t ks[] = {1, 2, 5, 16, MAX_K};
+    static const uint64_t windows[] = {1, 3, 50, 1000, 100000};
+    seen_t seen = {{0}, 0};
+
+    for (size_t k = 0; k < sizeof(ks) / sizeof(*ks); k++)
+        for (size_t w = 0; w < sizeof(windows) / sizeof(*windows); w++)
+            run(ks[k], windows[w], &seen);
+
+    CHECK(seen.compactions[SCORES_RANDOM] && seen.compactions[SCORES_FALLING] && seen.refill_drops,
+          "no compaction under random (%zu) or falling scores (%zu), or expiry during a refill (%zu)",
+          seen.compactions[SCORES_RANDOM], seen.compactions[SCORES_FALLING], seen.refill_drops);
+}
+
+int main(void) {
+    test_model();
+
+    printf("topk: ok\n");
+    return 0;
+}
@@ -0,0 +1,210 @@
+#include "veb.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Randomized tests of veb_t against a sorted array of the keys held. Inserts and
+ * erases must report whether they changed the set, and every contains, peek,
+ * remove and successor query must agree with the array. Keys favor the ends of the
+ * universe and the edges of bitmap words at every level, and successor queries
+ * start from every key around them, past the last key of the universe included.
+ */
+
+#define CHECK(cond, ...) do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: ", __FILE__, __LINE__); \
+            fprintf(stderr, __VA_ARGS__); \
+            fprintf(stderr, "\n"); \
+            exit(1); \
+        } \
+    } while (0)
+
+#define MAX_KEYS 4096
+
+typedef struct {
+    uint32_t            *arr;
+    size_t              len;
+} model_t;
+
+static uint64_t rng_state = 0x3c6ef372fe94f82bULL;
+
+static uint64_t rng(void) {
+    uint64_t z = (rng_state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/* The ends of the universe, either side of a word at some level, or anything. */
+static uint32_t rand_key(uint64_t universe) {
+    uint64_t span = (uint64_t)1 << (6 * (1 + rng() % 5)), k;
+
+    switch (rng() % 4) {
+        case 0:
+            k = rng() & 1 ? 0 : universe - 1 - rng() % 2;
+            break;
+        case 1:
+            k = span * (rng() % (universe / span + 1)) + rng() % 3 - 1;
+            break;
+        default:
+            k = rng() % universe;
+    }
+
+    return k < universe ? (uint32_t)k : (uint32_t)(universe - 1);
+}
+
+/* Index of the first key greater than or equal to `key`. */
+static size_t model_find(const model_t *m, uint64_t key) {
+    size_t lo = 0, hi = m->len;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if (m->arr[mid] < key)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo;
+}
+
+static int model_contains(const model_t *m, uint64_t key) {
+    size_t i = model_find(m, key);
+    return i < m->len && m->arr[i] == key;
+}
+
+static void insert(veb_t *veb, model_t *m, uint32_t key) {
+    size_t i = model_find(m, key);
+    int fresh = i == m->len || m->arr[i] != key;
+
+    CHECK(veb_insert(veb, key) == fresh, "insert of %u returned %d, model %s it", key, !fresh,
+          fresh ? "lacks" : "has");
+
+    if (fresh) {
+        memmove(&m->arr[i + 1], &m->arr[i], (m->len - i) * sizeof(uint32_t));
+        m->arr[i] = key;
+        m->len++;
+    }
+}
+
+static void erase(veb_t *veb, model_t *m, uint32_t key) {
+    size_t i = model_find(m, key);
+    int held = i < m->len && m->arr[i] == key;
+
+    CHECK(veb_erase(veb, key) == held, "erase of %u returned %d, model %s it", key, !held, held ? "has" : "lacks");
+
+    if (held)
+        memmove(&m->arr[i], &m->arr[i + 1], (--m->len - i) * sizeof(uint32_t));
+}
+
+static void succ(veb_t *veb, const model_t *m, uint32_t key) {
+    size_t i = model_find(m, (uint64_t)key + 1);
+    uint32_t out = 0;
+    char found = veb_succ(veb, key, &out);
+
+    CHECK(found == (i < m->len), "successor of %u %s, model has %s", key, found ? "found" : "not found",
+          i < m->len ? "one" : "none");
+    CHECK(!found || out == m->arr[i], "successor of %u is %u, model has %u", key, out, m->arr[i]);
+}
+
+/* Every key and successor query of the copy must match, and it must drain in order. */
+static void check_copy(veb_t *veb, const model_t *m) {
+    veb_t *cp = veb_copy(veb);
+    uint32_t key = 0;
+    size_t i = 0;
+
+    CHECK(veb_len(cp) == m->len, "copy has %zu keys, model has %zu", veb_len(cp), m->len);
+    if (m->len) {
+        key = veb_peek(cp);
+        CHECK(key == m->arr[0], "copy minimum is %u, model has %u", key, m->arr[0]);
+        for (i = 1; veb_succ(cp, key, &key); i++)
+            CHECK(i < m->len && key == m->arr[i], "successor %zu of the copy is %u", i, key);
+    }
+    CHECK(i == m->len, "walked %zu keys of the copy, model has %zu", i, m->len);
+
+    for (i = 0; i < m->len; i++)
+        CHECK(veb_remove(cp) == m->arr[i], "copy removed a key out of order");
+    CHECK(veb_is_empty(cp), "copy not empty after draining the model");
+
+    veb_destroy(cp);
+}
+
+static void test_model(void) {
+    static const uint64_t universes[] = {1, 2, 63, 64, 65, 4095, 4096, 4097, 262145, (uint64_t)1 << 32};
+    size_t edges = 0, misses = 0;
+
+    for (size_t u = 0; u < sizeof(universes) / sizeof(*universes); u++) {
+        uint64_t universe = universes[u];
+        veb_t *veb = veb_create(universe);
+        model_t m = {malloc(MAX_KEYS * sizeof(uint32_t)), 0};
+
+        CHECK(veb_universe(veb) == universe, "universe %llu, created with %llu",
+              (unsigned long long)veb_universe(veb), (unsigned long long)universe);
+
+        for (int step = 0; step < 40000; step++) {
+            uint64_t r = rng() % 100;
+            uint32_t key = rand_key(universe);
+
+            if (r < 40 && m.len < MAX_KEYS) {
+                insert(veb, &m, key);
+            } else if (r < 65) {
+                /* Half of the time a key that is held. */
+                erase(veb, &m, m.len && rng() & 1 ? m.arr[rng() % m.len] : key);
+            } else if (r < 75 && m.len) {
+                uint32_t got = veb_remove(veb);
+
+                CHECK(got == m.arr[0], "remove returned %u, model minimum is %u", got, m.arr[0]);
+                memmove(&m.arr[0], &m.arr[1], --m.len * sizeof(uint32_t));
+            } else if (r < 95) {
+                uint32_t from = m.len && rng() & 1 ? m.arr[rng() % m.len] + (uint32_t)(rng() % 3) - 1 : key;
+
+                succ(veb, &m, from);
+                edges += from >= universe - 1;
+                misses += model_find(&m, (uint64_t)from + 1) == m.len;
+            } else if (r < 99) {
+                CHECK(veb_contains(veb, key) == model_contains(&m, key), "contains %u disagrees with the model",
+                      key);
+            } else if (universe <= (uint64_t)1 << 20) {
+                /* A copy of the largest universe allocates and copies 512 MiB; it gets one at the end. */
+                check_copy(veb, &m);
+            }
+
+            CHECK(veb_len(veb) == m.len, "len %zu, model has %zu", veb_len(veb), m.len);
+            CHECK(veb_is_empty(veb) == !m.len, "veb_is_empty() is %d with %zu keys", veb_is_empty(veb), m.len);
+            CHECK(!m.len || veb_peek(veb) == m.arr[0], "peek returned %u, model minimum is %u", veb_peek(veb),
+                  m.arr[0]);
+        }
+
+        /* Keys outside the universe are never held, and nothing follows the last key. */
+        if (universe < (uint64_t)1 << 32) {
+            CHECK(!veb_contains(veb, (uint32_t)universe), "key %llu outside the universe is held",
+                  (unsigned long long)universe);
+            CHECK(!veb_erase(veb, UINT32_MAX), "erased a key outside the universe");
+            succ(veb, &m, (uint32_t)universe);
+            succ(veb, &m, UINT32_MAX);
+        }
+        succ(veb, &m, (uint32_t)(universe - 1));
+        check_copy(veb, &m);
+
+        while (m.len)
+            erase(veb, &m, m.arr[rng() % m.len]);
+        CHECK(veb_is_empty(veb), "not empty after erasing every key of the model");
+        succ(veb, &m, 0);
+
+        veb_destroy(veb);
+        free(m.arr);
+    }
+
+    CHECK(edges && misses, "no successor query from the last key (%zu) or past the largest one (%zu)", edges,
+          misses);
+}
+
+int main(void) {
+    test_model();
+
+    printf("veb: ok\n");
+    return 0;
+}
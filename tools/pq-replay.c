@@ -0,0 +1,334 @@
+#include "pq.h"
+#include "kpq.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Replays an operation trace captured with pq_trace_start() against several
+ * queue backends and configurations and reports their throughput.
+ *
+ * Traces captured without a key function only identify elements. Their keys
+ * are rebuilt from the removal order: the n-th removed element gets key n, so
+ * every backend has to reproduce the recorded pop sequence exactly.
+ *
+ * Removals of elements queued before the capture started cannot be replayed.
+ * They are dropped for derived keys and show up as mismatches for user keys.
+ *
+ * Allocators can be compared by running the tool under LD_PRELOAD.
+ */
+
+#define REC_SIZE 12
+
+typedef struct {
+    uint64_t            key;
+    uint8_t             op;
+} op_t;
+
+typedef struct {
+    op_t                *ops;
+    size_t              len;
+    size_t              inserts;
+    size_t              removes;
+    size_t              peeks;
+    size_t              dropped;
+    size_t              peak;
+    uint64_t            duration_ns;
+    uint32_t            flags;
+} trace_t;
+
+typedef struct {
+    const char          *name;
+    size_t              (*replay)(const trace_t *t, unsigned param);
+    /* Arity of the heap, or pq_create_ex() flags for the pq backends. */
+    unsigned            param;
+} backend_t;
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int u64_cmp(const void *a, const void *b) {
+    uint64_t ka = *(const uint64_t *)a, kb = *(const uint64_t *)b;
+    return (ka > kb) - (ka < kb);
+}
+
+/* Element ids become the rank at which the element was removed. */
+static void derive_keys(trace_t *t) {
+    size_t cap = 16;
+    while (cap < 2 * t->len)
+        cap <<= 1;
+
+    uint64_t *ids = calloc(cap, sizeof(uint64_t));
+    size_t *head = malloc(cap * sizeof(size_t)), *tail = malloc(cap * sizeof(size_t));
+    size_t *next = malloc(t->len * sizeof(size_t));
+    char *used = calloc(cap, 1);
+    uint64_t rank = 0;
+
+    for (size_t i = 0; i < t->len; i++) {
+        op_t *op = &t->ops[i];
+        if (op->op == PQ_TRACE_PEEK) {
+            op->key = UINT64_MAX;
+            continue;
+        }
+
+        size_t slot = (op->key * 0x9e3779b97f4a7c15ULL) >> 7 & (cap - 1);
+        while (used[slot] && ids[slot] != op->key)
+            slot = (slot + 1) & (cap - 1);
+
+        if (op->op == PQ_TRACE_INSERT) {
+            next[i] = SIZE_MAX;
+            if (!used[slot] || head[slot] == SIZE_MAX) {
+                used[slot] = 1;
+                ids[slot] = op->key;
+                head[slot] = i;
+            } else {
+                next[tail[slot]] = i;
+            }
+            tail[slot] = i;
+            op->key = UINT64_MAX;
+        } else if (used[slot] && head[slot] != SIZE_MAX) {
+            size_t ins = head[slot];
+            head[slot] = next[ins];
+            t->ops[ins].key = op->key = rank++;
+        } else {
+            op->key = UINT64_MAX;
+        }
+    }
+
+    /* Never removed: order them after everything that was, by insertion. */
+    for (size_t i = 0; i < t->len; i++)
+        if (t->ops[i].op == PQ_TRACE_INSERT && t->ops[i].key == UINT64_MAX)
+            t->ops[i].key = rank++;
+
+    free(ids);
+    free(head);
+    free(tail);
+    free(next);
+    free(used);
+}
+
+static int load(const char *path, trace_t *t) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+
+    uint32_t header[4];
+    if (fread(header, sizeof(header), 1, f) != 1 || header[0] != PQ_TRACE_MAGIC || header[1] != PQ_TRACE_VERSION) {
+        fprintf(stderr, "replay_error: %s is not a version %d pq trace\n", path, PQ_TRACE_VERSION);
+        fclose(f);
+        return -1;
+    }
+
+    fseek(f, 0, SEEK_END);
+    size_t n = (ftell(f) - sizeof(header)) / REC_SIZE;
+    fseek(f, sizeof(header), SEEK_SET);
+
+    memset(t, 0, sizeof(*t));
+    t->flags = header[2];
+    t->ops = malloc((n ? n : 1) * sizeof(op_t));
+
+    unsigned char rec[REC_SIZE];
+    size_t len = 0;
+    for (size_t i = 0; i < n && fread(rec, REC_SIZE, 1, f) == 1; i++) {
+        uint32_t meta;
+        memcpy(&t->ops[i].key, rec, sizeof(uint64_t));
+        memcpy(&meta, rec + sizeof(uint64_t), sizeof(meta));
+        t->ops[i].op = meta & 3;
+        t->duration_ns += meta >> 2;
+        t->len++;
+    }
+    fclose(f);
+
+    if (!(t->flags & PQ_TRACE_KEYED))
+        derive_keys(t);
+
+    /* Drop operations on elements that were queued before capture started. */
+    for (size_t i = 0; i < t->len; i++) {
+        op_t op = t->ops[i];
+        if ((op.op != PQ_TRACE_INSERT && !len) || (op.op == PQ_TRACE_REMOVE && op.key == UINT64_MAX)) {
+            t->dropped++;
+            continue;
+        }
+
+        if (op.op == PQ_TRACE_INSERT) {
+            t->inserts++;
+            if (++len > t->peak)
+                t->peak = len;
+        } else if (op.op == PQ_TRACE_REMOVE) {
+            t->removes++;
+            len--;
+        } else {
+            t->peeks++;
+        }
+        t->ops[t->inserts + t->removes + t->peeks - 1] = op;
+    }
+    t->len = t->inserts + t->removes + t->peeks;
+
+    return 0;
+}
+
+static size_t replay_pq(const trace_t *t, unsigned flags) {
+    pq_t *pq = pq_create_ex(t->peak ? t->peak : 1, u64_cmp, flags);
+    size_t mismatches = 0;
+
+    for (size_t i = 0; i < t->len; i++) {
+        const op_t *op = &t->ops[i];
+        switch (op->op) {
+            case PQ_TRACE_INSERT:
+                pq_insert(pq, (void *)&op->key);
+                break;
+            case PQ_TRACE_REMOVE:
+                mismatches += *(const uint64_t *)pq_remove(pq) != op->key;
+                break;
+            default:
+                mismatches += *(const uint64_t *)pq_peek(pq) > op->key;
+                break;
+        }
+    }
+
+    pq_destroy(pq, NULL);
+    return mismatches;
+}
+
+static size_t replay_kpq(const trace_t *t, unsigned arity) {
+    kpq_t *kpq = kpq_create(t->peak ? t->peak : 1, arity);
+    size_t mismatches = 0;
+    uint64_t key;
+
+    for (size_t i = 0; i < t->len; i++) {
+        const op_t *op = &t->ops[i];
+        switch (op->op) {
+            case PQ_TRACE_INSERT:
+                kpq_insert(kpq, op->key, NULL);
+                break;
+            case PQ_TRACE_REMOVE:
+                kpq_remove(kpq, &key);
+                mismatches += key != op->key;
+                break;
+            default:
+                kpq_peek(kpq, &key);
+                mismatches += key > op->key;
+                break;
+        }
+    }
+
+    kpq_destroy(kpq, NULL);
+    return mismatches;
+}
+
+/* Inline-key d-ary heap: the baseline a keyed backend is measured against. */
+static size_t replay_heap(const trace_t *t, unsigned d) {
+    uint64_t *h = malloc((t->peak ? t->peak : 1) * sizeof(uint64_t));
+    size_t len = 0, mismatches = 0;
+
+    for (size_t i = 0; i < t->len; i++) {
+        uint64_t key = t->ops[i].key;
+        if (t->ops[i].op == PQ_TRACE_INSERT) {
+            size_t j = len++;
+            while (j && key < h[(j - 1) / d]) {
+                h[j] = h[(j - 1) / d];
+                j = (j - 1) / d;
+            }
+            h[j] = key;
+        } else if (t->ops[i].op == PQ_TRACE_REMOVE) {
+            mismatches += h[0] != key;
+
+            uint64_t x = h[--len];
+            size_t j = 0, c;
+            while ((c = d * j + 1) < len) {
+                size_t end = c + d < len ? c + d : len, m = c;
+                for (size_t k = c + 1; k < end; k++)
+                    m = h[k] < h[m] ? k : m;
+                if (h[m] >= x)
+                    break;
+                h[j] = h[m];
+                j = m;
+            }
+            h[j] = x;
+        } else {
+            mismatches += h[0] > key;
+        }
+    }
+
+    free(h);
+    return mismatches;
+}
+
+static const backend_t BACKENDS[] = {
+    {"pq", replay_pq, 0},
+    {"pq-large", replay_pq, PQ_LARGE},
+    {"pq-bheap", replay_pq, PQ_BHEAP},
+    {"pq-lazy", replay_pq, PQ_LAZY},
+    {"pq-adaptive", replay_pq, PQ_ADAPTIVE},
+    {"heap2", replay_heap, 2},
+    {"heap4", replay_heap, 4},
+    {"heap8", replay_heap, 8},
+    {"kpq2", replay_kpq, 2},
+    {"kpq4", replay_kpq, 4},
+    {"kpq8", replay_kpq, 8},
+};
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [-b backend] [-r repeats] TRACE\n"
+            "Backends: pq pq-large pq-bheap pq-lazy pq-adaptive heap2 heap4 heap8 kpq2 kpq4 kpq8 (default: all)\n"
+            "kpq kernels follow GUILIB_ISA (scalar, avx2, avx512)\n", prog);
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    const char *path = NULL, *only = NULL;
+    int repeats = 3;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-b") && i + 1 < argc)
+            only = argv[++i];
+        else if (!strcmp(argv[i], "-r") && i + 1 < argc)
+            repeats = atoi(argv[++i]);
+        else if (argv[i][0] == '-' || path)
+            usage(argv[0]);
+        else
+            path = argv[i];
+    }
+    if (!path || repeats < 1)
+        usage(argv[0]);
+
+    trace_t t;
+    if (load(path, &t))
+        return 1;
+
+    printf("%s: %zu ops (%zu insert, %zu remove, %zu peek, %zu dropped), peak len %zu, %s keys\n",
+           path, t.len, t.inserts, t.removes, t.peeks, t.dropped, t.peak,
+           t.flags & PQ_TRACE_KEYED ? "user" : "derived");
+    if (t.duration_ns)
+        printf("captured over %.3f ms (%.2f Mops/s)\n", t.duration_ns / 1e6, t.len * 1e3 / t.duration_ns);
+    printf("kpq kernels: %s\n", kpq_isa());
+    printf("%-8s %10s %10s %12s\n", "backend", "ns/op", "Mops/s", "mismatches");
+
+    for (size_t b = 0; b < sizeof(BACKENDS) / sizeof(*BACKENDS); b++) {
+        if (only && strcmp(only, BACKENDS[b].name))
+            continue;
+
+        double best = 0;
+        size_t mismatches = 0;
+        for (int r = 0; r < repeats; r++) {
+            double t0 = now_ns();
+            mismatches = BACKENDS[b].replay(&t, BACKENDS[b].param);
+            double ns = now_ns() - t0;
+            best = !r || ns < best ? ns : best;
+        }
+
+        double ns_op = t.len ? best / t.len : 0;
+        printf("%-8s %10.2f %10.2f %12zu\n", BACKENDS[b].name, ns_op, ns_op ? 1e3 / ns_op : 0, mismatches);
+    }
+
+    free(t.ops);
+    return 0;
+}